@@ -28,7 +28,8 @@ namespace dwarf
 
 		inline basic_die *factory::make_payload(abstract_die&& h, root_die& r)
 		{
-			Die d(std::move(dynamic_cast<Die&&>(h)));
+			assert(h.as_libdwarf_die());
+			Die d(std::move(*h.as_libdwarf_die()));
 			if (d.tag_here() == DW_TAG_compile_unit) return make_cu_payload(std::move(d), r);
 			else return make_non_cu_payload(std::move(d), r);
 		}
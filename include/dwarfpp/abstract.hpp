@@ -9,6 +9,7 @@
 #ifndef DWARFPP_ABSTRACT_HPP_
 #define DWARFPP_ABSTRACT_HPP_
 
+#include <vector>
 #include "util.hpp"
 #include "spec.hpp"
 #include "opt.hpp"
@@ -35,6 +36,8 @@ namespace dwarf
 		struct dwarf_current_factory_t;
 		struct basic_die;
 		struct compile_unit_die;
+		struct Die;
+		struct in_memory_abstract_die;
 		using dwarf::spec::opt;
 		using dwarf::spec::spec;
 		using dwarf::spec::DEFAULT_DWARF_SPEC; // FIXME: ... or get rid of spec:: namespace?
@@ -51,6 +54,10 @@ namespace dwarf
 			virtual Dwarf_Off get_offset() const = 0;
 			virtual Dwarf_Half get_tag() const = 0;
 			virtual opt<string> get_name() const = 0;
+			/* Zero-copy versions of get_name() and of a block-valued
+			 * attribute (see util.hpp for how long they last). */
+			virtual string_view get_name_view() const = 0;
+			virtual block_view get_block_view(Dwarf_Half attr) const = 0;
 			// we can't do this because 
 			// - it fixes string deletion behaviour to libdwarf-style, 
 			// - it creates a circular dependency with the contents of libdwarf-handles.hpp
@@ -63,11 +70,16 @@ namespace dwarf
 			 * Just move the code from Die (and get rid of that method)? */
 			virtual spec& get_spec(root_die& r) const = 0;
 			string summary() const;
+			/* Downcasts to our two implementations, without needing RTTI. */
+			virtual Die *as_libdwarf_die() const { return nullptr; }
+			virtual in_memory_abstract_die *as_in_memory() const { return nullptr; }
 		};
 		
 		/* the in-memory version, for synthetic (non-library-backed) DIEs. */
 		struct in_memory_abstract_die: public virtual abstract_die
 		{
+			in_memory_abstract_die *as_in_memory() const
+			{ return const_cast<in_memory_abstract_die *>(this); }
 			root_die *p_root;
 			Dwarf_Off m_offset;
 			Dwarf_Off m_cu_offset;
@@ -84,6 +96,31 @@ namespace dwarf
 			private:
 				void update_cache_on_insert(iterator inserted);
 			public:
+				/* Anything that changes us must call this, since our
+				 * root's effective attributes may have come from us. */
+				void note_edited();
+				iterator erase(const_iterator pos)
+				{ auto ret = this->super::erase(pos); note_edited(); return ret; }
+				size_type erase(Dwarf_Half k)
+				{
+					size_type n = this->super::erase(k);
+					if (n) note_edited();
+					return n;
+				}
+				iterator erase(const_iterator first, const_iterator last)
+				{
+					bool erasing = first != last;
+					auto ret = this->super::erase(first, last);
+					if (erasing) note_edited();
+					return ret;
+				}
+				/* We can't see writes through the reference, so assume one. */
+				mapped_type& operator[](Dwarf_Half k)
+				{
+					mapped_type& ret = this->super::operator[](k);
+					note_edited();
+					return ret;
+				}
 				std::pair<iterator, bool> insert(const value_type& val)
 				{
 					auto ret = this->super::insert(val);
@@ -93,7 +130,7 @@ namespace dwarf
 				}
 				std::pair<iterator,bool> insert(value_type&& val) // was template <typename P>
 				{
-					auto ret = this->super::insert(val);
+					auto ret = this->super::insert(std::move(val));
 					auto inserted = ret.second;
 					if (inserted) update_cache_on_insert(ret.first);
 					return ret;
@@ -120,12 +157,29 @@ namespace dwarf
 			Dwarf_Half get_tag() const { return m_tag; }
 			opt<string> get_name() const 
 			{ return has_attr(DW_AT_name) ? m_attrs.find(DW_AT_name)->second.get_string() : opt<string>(); }
+			/* These point into our attribute values, so last as long as we do. */
+			string_view get_name_view() const
+			{
+				auto found = m_attrs.find(DW_AT_name);
+				return (found != m_attrs.end() && found->second.is_string())
+					? string_view(found->second.get_string()) : string_view();
+			}
+			block_view get_block_view(Dwarf_Half attr) const
+			{
+				auto found = m_attrs.find(attr);
+				if (found == m_attrs.end() || !found->second.is_block()) return block_view();
+				const std::vector<unsigned char> *p_block = found->second.get_block();
+				return block_view(p_block->data(), p_block->data() + p_block->size());
+			}
 			Dwarf_Off get_enclosing_cu_offset() const 
 			{ return m_cu_offset; }
 			bool has_attr(Dwarf_Half attr) const 
 			{ return m_attrs.find(attr) != m_attrs.end(); }
 			encap::attribute_map copy_attrs() const
 			{ return m_attrs; }
+			/* Edit us with insert() and erase(), which tell the root. An
+			 * attribute's value changed in place isn't seen, so erase and
+			 * re-insert it instead. */
 			encap::attribute_map& attrs() 
 			{ return m_attrs; }
 			inline spec& get_spec(root_die& r) const;
@@ -154,11 +208,15 @@ namespace dwarf
 			
 			static inline factory& for_spec(dwarf::spec::spec& def);
 			virtual basic_die *dummy_for_tag(Dwarf_Half tag) = 0;
+			/* The tags we have a payload class for, in order. Any other
+			 * tag gets a plain basic_die. */
+			virtual const std::vector<Dwarf_Half>& known_tags() = 0;
 		};
 		struct dwarf_current_factory_t : public factory
 		{
 			basic_die *make_non_cu_payload(abstract_die&& h, root_die& r);
 			basic_die *dummy_for_tag(Dwarf_Half tag);
+			const std::vector<Dwarf_Half>& known_tags();
 		};
 		extern dwarf_current_factory_t dwarf_current_factory;
 		inline factory& factory::for_spec(dwarf::spec::abstract_def& def)
@@ -12,11 +12,15 @@
 
 #include <memory>
 #include <vector>
+#include <utility>
+#include <algorithm>
+#include <stdexcept>
 
 #include "spec.hpp"
 #include "libdwarf.hpp" /* includes libdwarf.h, Error, No_entry, some fwddecls */
 
 #include <boost/optional.hpp>
+#include <boost/container/small_vector.hpp>
 #include <srk31/util.hpp> /* for forward_constructors */
 
 namespace dwarf
@@ -40,12 +44,14 @@ namespace dwarf
 		using namespace dwarf::lib;
 		class rangelist;
 		class loclist;
+		struct attribute_map;
 		using core::root_die;
 		using core::debug;
 		
 		class attribute_value {
 				friend class core::basic_die; // for use of the NO_ATTR constructor in find_attr
 				friend class core::iterator_base; // the same in iterator_base::attr()
+				friend struct attribute_map; // the same in attribute_map::operator[]
 		public: 
 			struct weak_ref { 
 				friend class attribute_value;
@@ -127,6 +133,8 @@ namespace dwarf
 				encap::rangelist *v_rangelist;
 			};
 			static form dwarf_form_to_form(const Dwarf_Half form); // helper hack
+			void steal(attribute_value& av); // take av's value, leaving it NO_ATTR
+			void release(); // free our value, leaving us NO_ATTR
 			// -- the operator<< is a friend (WHY?)
 			friend std::ostream& ::dwarf::lib::operator<<(std::ostream& s, const dwarf::lib::Dwarf_Loc& l);
 
@@ -194,17 +202,39 @@ namespace dwarf
 			//friend std::ostream& operator<<(std::ostream& o, const dwarf::encap::die& d);
 			// copy constructor
 			attribute_value(const attribute_value& av);
+			// move constructor -- takes the pointee, so allocates nothing
+			attribute_value(attribute_value&& av) noexcept : orig_form(av.orig_form), f(NO_ATTR)
+			{ steal(av); }
+			attribute_value& operator=(const attribute_value& av)
+			{ attribute_value tmp(av); return *this = std::move(tmp); }
+			attribute_value& operator=(attribute_value&& av) noexcept
+			{ if (this != &av) { release(); orig_form = av.orig_form; steal(av); } return *this; }
 			
 			virtual ~attribute_value();
 		}; // end class attribute_value
 		
-		struct attribute_map : public std::map<Dwarf_Half, attribute_value> 
+		/* A DIE has few attributes -- typically three to eight -- so instead
+		 * of a std::map we keep them in a vector sorted by attribute number,
+		 * with room for that many inline. Lookup is as for a map, but note
+		 * that inserting or erasing invalidates iterators, as for a vector. */
+		struct attribute_map
 		{
-			typedef std::map<Dwarf_Half, attribute_value> base;
-			// forward constructors
-			//forward_constructors(base, attribute_map)
-			// hmm -- this messes with overload resolution; just forward default for now
-			attribute_map() : base() {}
+			typedef Dwarf_Half key_type;
+			typedef attribute_value mapped_type;
+			typedef std::pair<Dwarf_Half, attribute_value> value_type;
+			typedef boost::container::small_vector<value_type, 8> base;
+			typedef base::iterator iterator;
+			typedef base::const_iterator const_iterator;
+			typedef base::size_type size_type;
+		protected:
+			base v;
+			static bool key_less(const value_type& val, Dwarf_Half k) { return val.first < k; }
+		public:
+			attribute_map() {}
+			// from a range of attributes, in any order; the first of each number wins
+			template <typename InputIt>
+			attribute_map(InputIt first, InputIt last)
+			{ for (; first != last; ++first) insert_impl(value_type(*first)); }
 			
 			// also construct from AttributeList
 			attribute_map(const core::AttributeList& a, const core::Die& d, root_die& r, 
@@ -216,27 +246,101 @@ namespace dwarf
 			
 			void print(std::ostream& s, unsigned indent_level) const;
 			
+			iterator begin() { return v.begin(); }
+			iterator end() { return v.end(); }
+			const_iterator begin() const { return v.begin(); }
+			const_iterator end() const { return v.end(); }
+			const_iterator cbegin() const { return v.cbegin(); }
+			const_iterator cend() const { return v.cend(); }
+			size_type size() const { return v.size(); }
+			bool empty() const { return v.empty(); }
+			void clear() { v.clear(); }
+			void reserve(size_type n) { v.reserve(n); }
+			bool operator==(const attribute_map& arg) const { return v == arg.v; }
+			bool operator!=(const attribute_map& arg) const { return !(*this == arg); }
+			
+			iterator lower_bound(Dwarf_Half k)
+			{ return std::lower_bound(v.begin(), v.end(), k, key_less); }
+			const_iterator lower_bound(Dwarf_Half k) const
+			{ return std::lower_bound(v.begin(), v.end(), k, key_less); }
+			iterator find(Dwarf_Half k)
+			{ auto i = lower_bound(k); return (i != end() && i->first == k) ? i : end(); }
+			const_iterator find(Dwarf_Half k) const
+			{ auto i = lower_bound(k); return (i != end() && i->first == k) ? i : end(); }
+			size_type count(Dwarf_Half k) const { return find(k) != end(); }
+			mapped_type& at(Dwarf_Half k)
+			{
+				auto i = find(k);
+				if (i == end()) throw std::out_of_range("attribute_map::at");
+				return i->second;
+			}
+			const mapped_type& at(Dwarf_Half k) const
+			{ return const_cast<attribute_map *>(this)->at(k); }
+			
 			/* In order of insert() to preserve the invariant in root_die,
 			 * we restrict the insertion interface a bit and make it polymorphic.
 			 * The invariant we're talking about here concerns root_die's
 			 * visible_named_grandchildren_is_complete: if we add a global name to a 
 			 * depth-2 DIE, we need to update the cache or invalidate it. We do
 			 * this by overriding some stuff in a derived class (in in_memory_abstract_die).  */
+		protected:
+			/* The overloads share this, rather than calling each other, so
+			 * that an overriding insert() sees each insertion only once. */
+			std::pair<iterator, bool> insert_impl(value_type&& val)
+			{
+				auto i = lower_bound(val.first);
+				if (i != end() && i->first == val.first) return std::make_pair(i, false);
+				return std::make_pair(v.insert(i, std::move(val)), true);
+			}
+		public:
+			/* These insert through the virtual insert(), so an overriding
+			 * class sees them. */
+			mapped_type& operator[](Dwarf_Half k)
+			{
+				auto i = find(k);
+				if (i != end()) return i->second;
+				return insert(value_type(k, mapped_type())).first->second;
+			}
+			template <typename... Args>
+			std::pair<iterator, bool> emplace(Args&&... args)
+			{
+				return insert(value_type(std::forward<Args>(args)...));
+			}
 			virtual 
 			std::pair<iterator, bool> insert(const value_type& val)
 			{
-				return this->base::insert(val);
+				return insert_impl(value_type(val));
 			}
 			virtual
 			std::pair<iterator,bool> insert(value_type&& val) // was template <class P> ... (P&& val)
 			{
-				return this->base::insert(val);
+				return insert_impl(std::move(val));
 			}
 			virtual
 			iterator insert(const_iterator position, const value_type& val)
 			{
-				return this->base::insert(position, val);
+				/* Use the hint only if it's right. */
+				if ((position == cend() || val.first < position->first)
+					&& (position == cbegin() || (position - 1)->first < val.first))
+				{ return v.insert(position, val); }
+				return insert_impl(value_type(val)).first;
 			}
+			
+			virtual
+			iterator erase(const_iterator pos) { return v.erase(pos); }
+			virtual
+			size_type erase(Dwarf_Half k)
+			{ auto i = find(k); if (i == end()) return 0; v.erase(i); return 1; }
+			virtual
+			iterator erase(const_iterator first, const_iterator last) { return v.erase(first, last); }
+			
+			/* Add those of arg's attributes that we don't have, moving them
+			 * rather than copying. This is for merging in the attributes of
+			 * an abstract_origin or specification. It works directly on our
+			 * representation, so doesn't go through insert(). */
+			void left_merge(attribute_map&& arg);
+			void left_merge(const attribute_map& arg)
+			{ left_merge(attribute_map(arg)); }
 		};
 		std::ostream& operator<<(std::ostream& s, const attribute_map& arg);
 		bool operator==(Dwarf_Addr arg, attribute_value::address a);
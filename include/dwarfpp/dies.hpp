@@ -59,6 +59,9 @@ namespace dwarf
 		constructor(fragment, base_inits /* NOTE: base_inits is expanded via ',' into varargs list */) \
 	protected: /* protected constructor that doesn't touch basic_die */ \
 		fragment ## _die() {} \
+	public: \
+		virtual size_t payload_size() const { return sizeof (fragment ## _die); } \
+		virtual void *cast_to(payload_class c) { return cast_self_to(this, c); } \
 	public: /* extra decls should be public */
 #define base_initializations(...) __VA_ARGS__
 #define end_class(fragment) \
@@ -90,9 +93,17 @@ namespace dwarf
  * virtual inheritance to wire its getters up to those versions. 
  * ARGH: no, we need another round of these macros to enumerate all the getters. 
  */
+/* An opt<> of an iterator is the iterator itself, so it has no "*". */
+template <typename T> inline const T& opt_value(const opt<T>& o, std::false_type) { return *o; }
+template <typename T> inline const T& opt_value(const opt<T>& o, std::true_type) { return o; }
+template <typename T> inline const T& opt_value(const opt<T>& o)
+{ return opt_value(o, std::is_base_of<iterator_base, T>()); }
+
 #define attr_optional(name, stored_t) \
 	opt<stored_type_ ## stored_t> get_ ## name() const \
-	{ if (has_attr(DW_AT_ ## name)) \
+	{ opt<stored_type_ ## stored_t> raw; \
+	  if (raw_get_ ## stored_t(DW_AT_ ## name, raw)) return raw; \
+	  if (has_attr(DW_AT_ ## name)) \
 	  {  /* we have to check the form matches our expectations */ \
 		 encap::attribute_value a = attr(DW_AT_ ## name); \
 		 if (!a.is_ ## stored_t ()) { \
@@ -102,7 +113,9 @@ namespace dwarf
 	  } \
 	  else return opt<stored_type_ ## stored_t>(); } \
 	opt<stored_type_ ## stored_t> find_ ## name() const \
-	{ encap::attribute_value found = find_attr(DW_AT_ ## name); \
+	{ opt<stored_type_ ## stored_t> raw; \
+	  if (raw_get_ ## stored_t(DW_AT_ ## name, raw) && raw) return raw; \
+	  encap::attribute_value found = find_attr(DW_AT_ ## name); \
 	  if (found.get_form() != encap::attribute_value::NO_ATTR) { \
 		 if (!found.is_ ## stored_t ()) { \
 			debug() << "Warning: attribute " #name " of DIE at 0x" << std::hex << get_offset() << std::dec << " not a " #stored_t << endl; \
@@ -114,10 +127,14 @@ namespace dwarf
 
 #define attr_mandatory(name, stored_t) \
 	stored_type_ ## stored_t get_ ## name() const \
-	{ assert(has_attr(DW_AT_ ## name)); \
+	{ opt<stored_type_ ## stored_t> raw; \
+	  if (raw_get_ ## stored_t(DW_AT_ ## name, raw) && raw) return opt_value(raw); \
+	  assert(has_attr(DW_AT_ ## name)); \
 	  return attr(DW_AT_ ## name).get_ ## stored_t (); } \
 	stored_type_ ## stored_t find_ ## name() const \
-	{ encap::attribute_value found = find_attr(DW_AT_ ## name); \
+	{ opt<stored_type_ ## stored_t> raw; \
+	  if (raw_get_ ## stored_t(DW_AT_ ## name, raw) && raw) return opt_value(raw); \
+	  encap::attribute_value found = find_attr(DW_AT_ ## name); \
 	  assert(found.get_form() != encap::attribute_value::NO_ATTR); \
 	  return found.get_ ## stored_t (); }
 
@@ -487,7 +504,7 @@ public:
 	
 	/* Primitive operations that our subclasses will use. */
 	type_die& dereference() const
-	{ return dynamic_cast<type_die&>(this->iterator_base::dereference()); }
+	{ return payload_cast<type_die>(this->iterator_base::dereference()); }
 	
 	/* Nobody implements this. */
 	void decrement();
@@ -1024,6 +1041,55 @@ friend class factory;
 /****************************************************************/
 /* end generated ADT includes								   */
 /****************************************************************/
+
+		/* Visiting a DIE by its payload type, without RTTI. We switch on
+		 * the tag (which is cheap to get) and hand the visitor the most
+		 * derived payload type; overload resolution then picks whichever
+		 * of the visitor's handlers is most specific. Any visitor must
+		 * accept basic_die&, for tags we don't know about. E.g.
+		 *
+		 *    visit(i, overload(
+		 *        [](subprogram_die& d) { ... },
+		 *        [](type_die& d) { ... },
+		 *        [](basic_die& d) { ... }
+		 *    ));
+		 */
+		template <typename... Fs> struct overloaded;
+		template <typename F> struct overloaded<F> : F
+		{
+			overloaded(F f) : F(std::move(f)) {}
+			using F::operator();
+		};
+		template <typename F, typename... Fs>
+		struct overloaded<F, Fs...> : F, overloaded<Fs...>
+		{
+			overloaded(F f, Fs... fs) : F(std::move(f)), overloaded<Fs...>(std::move(fs)...) {}
+			using F::operator();
+			using overloaded<Fs...>::operator();
+		};
+		template <typename... Fs>
+		inline overloaded<Fs...> overload(Fs... fs)
+		{ return overloaded<Fs...>(std::move(fs)...); }
+
+		template <typename Visitor>
+		inline auto visit(const iterator_base& it, Visitor&& v)
+		 -> decltype(v(std::declval<basic_die&>()))
+		{
+			basic_die& d = it.dereference();
+			switch (it.tag_here())
+			{
+#define factory_case(name, ...) \
+				case DW_TAG_ ## name: \
+					if (void *p = d.cast_to(payload_class_ ## name)) \
+					{ return v(*static_cast<name ## _die *>(p)); } \
+					break;
+#include "dwarf-current-factory.h"
+#undef factory_case
+				default: break;
+			}
+			// unknown tag, or a payload not of the tag's usual class
+			return v(d);
+		}
 	}
 }
 #endif
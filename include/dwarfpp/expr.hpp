@@ -11,6 +11,7 @@
 
 #include <vector>
 #include <stack>
+#include <algorithm>
 #include <boost/icl/interval_map.hpp>
 #include <strings.h> // for bzero
 #include "spec.hpp"
@@ -324,6 +325,37 @@ namespace dwarf
 		};
 		std::ostream& operator<<(std::ostream& s, const loclist& ll);
 		
+		/* A loclist made ready for lookups by PC. Each entry's range is made
+		 * absolute, applying the CU base and any base address selection
+		 * entries, and the ranges are split where they overlap, so that they
+		 * are disjoint and sorted. Each maps to the first expression in the
+		 * list that covers it, as evaluator's loclist constructor would pick. */
+		struct compiled_loclist
+		{
+			struct range
+			{
+				Dwarf_Addr lo;
+				Dwarf_Addr hi; // exclusive
+				unsigned expr_idx;
+			};
+			vector<range> ranges;
+			vector<loc_expr> exprs; // in list order, without base selections
+			
+			compiled_loclist() {}
+			compiled_loclist(const loclist& l, Dwarf_Addr cu_base);
+			/* The expression in effect at pc (as absolute as the CU base),
+			 * or null if none is. */
+			const loc_expr *expr_for_pc(Dwarf_Addr pc) const
+			{
+				auto found = std::upper_bound(ranges.begin(), ranges.end(), pc,
+					[](Dwarf_Addr pc, const range& r) { return pc < r.lo; });
+				if (found == ranges.begin()) return nullptr;
+				--found;
+				return pc < found->hi ? &exprs[found->expr_idx] : nullptr;
+			}
+			bool empty() const { return ranges.empty(); }
+		};
+		
 		/* Instruction sequences in a CIE/FDE. */
 		struct frame_instrlist;
 		/* We need this extension so that we can define operator<<, since to construct a 
@@ -431,6 +463,15 @@ namespace dwarf
 				opt<Dwarf_Signed> frame_base = opt<Dwarf_Signed>(),
 				const eval_stack& initial_stack = eval_stack());
 			
+			/* The same, but the lookup is a binary search, and pc is absolute
+			 * (i.e. not relative to the CU base). */
+			evaluator(const encap::compiled_loclist& loclist,
+				Dwarf_Addr pc,
+				const ::dwarf::spec::abstract_def& spec = spec::DEFAULT_DWARF_SPEC,
+				regs *p_regs = 0,
+				opt<Dwarf_Signed> frame_base = opt<Dwarf_Signed>(),
+				const eval_stack& initial_stack = eval_stack());
+			
 			evaluator(const vector<Dwarf_Loc>& loc_desc,
 				const ::dwarf::spec::abstract_def& spec,
 				const eval_stack& initial_stack /* = eval_stack() */)
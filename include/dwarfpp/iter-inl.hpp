@@ -28,7 +28,7 @@ namespace dwarf
 			{
 				// we only ask CUs for their spec after payload construction
 				assert(state == WITH_PAYLOAD);
-				auto p_cu = dynamic_pointer_cast<compile_unit_die>(cur_payload);
+				compile_unit_die *p_cu = payload_cast<compile_unit_die>(cur_payload.get());
 				assert(p_cu);
 				switch(p_cu->version_stamp)
 				{
@@ -62,6 +62,27 @@ namespace dwarf
 		iterator_base::children() { return children_here(); }
 		inline sequence< iterator_sibs<> >
 		iterator_base::children() const { return children_here(); }
+		template <typename Payload>
+		inline sequence<iterator_tagged<Payload> >
+		iterator_base::children_subseq_of() const
+		{
+			root_die& r = get_root();
+			const topology_index& idx = r.tag_postings();
+			if (is_root_position())
+			{
+				return make_pair(iterator_tagged<Payload>(r, idx, true),
+					iterator_tagged<Payload>(iterator_base::END));
+			}
+			topology_index::ordinal o = idx.ordinal_of(offset_here());
+			if (o == topology_index::NONE)
+			{
+				// created in memory, so not indexed; filter its children
+				return make_pair(iterator_tagged<Payload>::siblings_from(r.first_child(*this)),
+					iterator_tagged<Payload>(iterator_base::END));
+			}
+			return make_pair(iterator_tagged<Payload>(r, idx, true, o),
+				iterator_tagged<Payload>(iterator_base::END));
+		}
 	}
 }
 
@@ -14,7 +14,7 @@
 #include <functional>
 #include <memory>
 #include <cassert>
-#include <deque>
+#include <vector>
 #include <srk31/selective_iterator.hpp>
 #include <srk31/concatenating_iterator.hpp>
 #include <srk31/transform_iterator.hpp>
@@ -62,7 +62,7 @@ namespace dwarf
 					case HANDLE_ONLY: return cur_handle;
 					case WITH_PAYLOAD: {
 						if (cur_payload->d.handle) return cur_payload->d;
-						else return dynamic_cast<in_memory_abstract_die&>(*cur_payload);
+						else return *cur_payload->as_in_memory();
 					}
 					default: assert(false);
 				}
@@ -107,6 +107,7 @@ namespace dwarf
 			iterator_base(abstract_die&& d, opt<unsigned short> opt_depth, root_die& r)
 			 : cur_handle(Die(nullptr, nullptr)), cur_payload(nullptr) // will be replaced in function body...
 			{
+				root_die::guard g(r);
 				// get the offset of the handle we've been passed
 				Dwarf_Off off = d.get_offset(); 
 				// is it an existing live DIE?
@@ -133,7 +134,8 @@ namespace dwarf
 				else
 				{
 					// does not exist, and not sticky, so need not exist; stick with handle
-					cur_handle = std::move(dynamic_cast<Die&&>(d).handle);
+					assert(d.as_libdwarf_die());
+					cur_handle = std::move(d.as_libdwarf_die()->handle);
 					state = HANDLE_ONLY;
 				}
 				m_opt_depth = opt_depth; // now shared by both cases
@@ -153,10 +155,11 @@ namespace dwarf
 			// copy constructor
 			iterator_base(const iterator_base& arg)
 				/* We used to always make payload on copying.
-				 * We no longer do that; instead, if we're a handle, just ask libdwarf
-				 * for a fresh handle. This still does an allocation (in libdwarf, not
-				 * in our code) and will cause our code to do *another* allocation if
-				 * we dereference the iterator -- UNLESS the DIE at that offset has
+				 * We no longer do that; instead, if we're a handle, just duplicate
+				 * it. A handle is only an offset until something needs libdwarf's
+				 * Dwarf_Die (see Die::handle_type), so this costs no libdwarf call
+				 * and no allocation. Dereferencing the copy will still cause an
+				 * allocation in our code -- UNLESS the DIE at that offset has
 				 * already been materialised via another iterator, in which case we'll
 				 * find it via live_dies.
 				 * 
@@ -190,9 +193,8 @@ namespace dwarf
 						this->cur_payload = arg.cur_payload;
 						break;
 					case HANDLE_ONLY: {
-						Die tmp(*p_root, arg.offset_here());
 						this->state = HANDLE_ONLY;
-						this->cur_handle = std::move(tmp);
+						this->cur_handle = Die(arg.cur_handle.handle.duplicate());
 						this->cur_payload = nullptr;
 					} break;
 					default: assert(false);
@@ -219,7 +221,7 @@ namespace dwarf
 				// FIXME: do copy-and-swap here
 				this->m_opt_depth = arg.m_opt_depth;
 				this->p_root = arg.p_root;
-				// as with the copy constructor, get the duplicate from libdwarf
+				// as with the copy constructor, just duplicate the handle
 				if (arg.is_end_position())
 				{
 					// NOTE: must put us in the same state as the default constructor
@@ -244,8 +246,7 @@ namespace dwarf
 						break;
 					case HANDLE_ONLY: {
 						this->state = HANDLE_ONLY;
-						Die tmp(*p_root, arg.offset_here());
-						this->cur_handle = std::move(tmp);
+						this->cur_handle = Die(arg.cur_handle.handle.duplicate());
 						this->cur_payload = nullptr;
 					} break;
 					default: assert(false);
@@ -283,6 +284,11 @@ namespace dwarf
 			name_here() const;
 			opt<string> 
 			global_name_here() const;
+			/* The same as name_here(), but without copying (see util.hpp).
+			 * Valid until the root's evict_caches() (see intern_string()). */
+			string_view name_view_here() const;
+			/* A block-valued attribute's bytes, without copying. */
+			block_view block_view_here(Dwarf_Half attr) const;
 			
 			inline spec& spec_here() const;
 			
@@ -297,10 +303,12 @@ namespace dwarf
 			// helper for raw names -> std::string names
 		private:
 			inline unique_ptr<const char, string_deleter> get_raw_name() const 
-			{ return dynamic_cast<Die&>(get_handle()).name_here(); } 
+			{ return get_handle().as_libdwarf_die()->name_here(); } 
 			inline opt<string> get_name() const 
 			{ return /*opt<string>(string(get_raw_name().get())); */ get_handle().get_name(); }
 		public:
+			inline string_view get_name_view() const { return name_view_here(); }
+			inline block_view get_block_view(Dwarf_Half attr) const { return block_view_here(attr); }
 			inline Dwarf_Off get_enclosing_cu_offset() const 
 			{ return enclosing_cu_offset_here(); }
 			inline bool has_attr(Dwarf_Half attr) const { return has_attr_here(attr); }
@@ -309,11 +317,7 @@ namespace dwarf
 				if (is_root_position()) return encap::attribute_map();
 				if (state == HANDLE_ONLY)
 				{
-					return encap::attribute_map(
-						AttributeList(dynamic_cast<Die&>(get_handle())),
-						dynamic_cast<Die&>(get_handle()), 
-						dynamic_cast<Die&>(get_handle()).get_constructing_root()
-					);
+					return get_handle().as_libdwarf_die()->copy_attrs();
 				}
 				else
 				{
@@ -326,12 +330,12 @@ namespace dwarf
 				if (is_root_position()) return encap::attribute_value();
 				if (state == HANDLE_ONLY)
 				{
-					AttributeList l(dynamic_cast<Die&>(get_handle()));
+					AttributeList l(*get_handle().as_libdwarf_die());
 					for (auto i = l.copied_list.begin(); i != l.copied_list.end(); ++i)
 					{
 						if (i->attr_here() == attr)
 						{
-							return encap::attribute_value(*i, dynamic_cast<Die&>(get_handle()), get_root());
+							return encap::attribute_value(*i, *get_handle().as_libdwarf_die(), get_root());
 						}
 					}
 					return encap::attribute_value();
@@ -349,10 +353,10 @@ namespace dwarf
 			bool has_attribute_here(Dwarf_Half attr) const { return has_attr_here(attr); }
 			
 			AttributeList::handle_type attributes_here()
-			{ return AttributeList::try_construct(dynamic_cast<Die&>(get_handle())); }
+			{ return AttributeList::try_construct(*get_handle().as_libdwarf_die()); }
 			AttributeList::handle_type attrs_here() { return attributes_here(); }
 			AttributeList::handle_type attributes_here() const 
-			{ return AttributeList::try_construct(dynamic_cast<Die&>(get_handle())); }
+			{ return AttributeList::try_construct(*get_handle().as_libdwarf_die()); }
 			AttributeList::handle_type attrs_here() const { return attributes_here(); }
 			
 			// want an iterators-style interface?
@@ -401,6 +405,11 @@ namespace dwarf
 			// synonyms
 			inline sequence<iterator_sibs<> > children();
 			inline sequence<iterator_sibs<> > children() const;
+			/* Like children().subseq_of<Payload>(), but going straight
+			 * from one match to the next using the tag posting lists (so
+			 * building the topology index if we haven't already). */
+			template <typename Payload>
+			inline sequence<iterator_tagged<Payload> > children_subseq_of() const;
 			
 			// we're just the base, not the iterator proper, 
 			// so we don't have increment(), decrement()
@@ -409,8 +418,8 @@ namespace dwarf
 			{
 				if (!p_root && !arg.p_root) return true; // END
 				// now we're either root or "real". Handle the case where we're root. 
-				if (state == HANDLE_ONLY && !cur_handle.handle.get() 
-					&& arg.state == HANDLE_ONLY && !arg.cur_handle.handle.get()) return p_root == arg.p_root;
+				if (state == HANDLE_ONLY && !cur_handle.handle 
+					&& arg.state == HANDLE_ONLY && !arg.cur_handle.handle) return p_root == arg.p_root;
 				if (state == WITH_PAYLOAD && arg.state == WITH_PAYLOAD &&
 					cur_payload == arg.cur_payload) return true;
 				if (m_opt_depth && arg.m_opt_depth 
@@ -460,19 +469,51 @@ namespace dwarf
 		}; 
 		/* END class iterator_base */
 		
-		/* Now we can define that pesky template operator function. 
-		 * The factory exposes a dummy method (NOT type-level though! it's 
-		 * polymorphic!) that returns us a fake singleton of any instantiable  
-		 * DIE type. */
+		/* Does the tag make a Payload? For classes in the spec, the tables
+		 * say. Otherwise, the factory exposes a dummy method (NOT type-level
+		 * though! it's polymorphic!) that returns us a fake singleton of
+		 * any instantiable DIE type, and we ask RTTI. */
+		template <typename Payload>
+		inline bool tag_is_a(Dwarf_Half tag, spec& s, std::true_type)
+		{ return payload_class_traits<Payload>::has_tag(tag); }
+#if DWARFPP_HAVE_RTTI
+		template <typename Payload>
+		inline bool tag_is_a(Dwarf_Half tag, spec& s, std::false_type)
+		{ return dynamic_cast<Payload *>(factory::for_spec(s).dummy_for_tag(tag)) ? true : false; }
+#endif
+		template <typename Payload>
+		inline bool tag_is_a(Dwarf_Half tag, spec& s = dwarf::spec::dwarf_current)
+		{
+			return tag_is_a<Payload>(tag, s,
+				std::integral_constant<bool, payload_class_traits<Payload>::known>());
+		}
+
+		/* The tags for which the factory makes a Payload, in order. Note
+		 * that every DIE is a basic_die, whatever its tag, and tags not in
+		 * this list for basic_die are basic_dies too. */
+		template <typename Payload>
+		inline const std::vector<Dwarf_Half>& payload_tags()
+		{
+			static const std::vector<Dwarf_Half> tags = []() {
+				std::vector<Dwarf_Half> v;
+				const std::vector<Dwarf_Half>& known
+				 = factory::for_spec(dwarf::spec::dwarf_current).known_tags();
+				for (auto i_t = known.begin(); i_t != known.end(); ++i_t)
+				{
+					if (tag_is_a<Payload>(*i_t)) v.push_back(*i_t);
+				}
+				return v;
+			}();
+			return tags;
+		}
+
+		/* Now we can define that pesky template operator function. */
 		template <typename Payload>
 		inline bool is_a_t<Payload>::operator()(const iterator_base& it) const
 		{
-			return dynamic_cast<Payload *>(
-				factory::for_spec(it.spec_here()).dummy_for_tag(it.tag_here())
-			) ? true : false;
+			return tag_is_a<Payload>(it.tag_here(), it.spec_here());
 		}
 		
-
 		template <typename Iter, typename Pred>
 		inline 
 		pair<
@@ -602,6 +643,17 @@ namespace dwarf
 				base_reference() = base_reference().get_root().end/*<self>*/();
 				assert(*this == iterator_base::END);
 			}
+			void increment_skipping_subtree()
+			{
+				/* As increment(), but don't descend into our children. With a
+				 * topology index, the sibling and parent moves are array reads. */
+				do
+				{
+					if (get_root().move_to_next_sibling(base_reference())) return;
+				} while (get_root().move_to_parent(base_reference()));
+				base_reference() = base_reference().get_root().end/*<self>*/();
+				assert(*this == iterator_base::END);
+			}
 			void decrement()
 			{
 				assert(false); // FIXME
@@ -609,13 +661,49 @@ namespace dwarf
 			bool equal(const self& arg) const { return this->base() == arg.base(); }
 			
 			DerefAs& dereference() const
-			{ return dynamic_cast<DerefAs&>(this->iterator_base::dereference()); }
+			{ return payload_cast<DerefAs>(this->iterator_base::dereference()); }
 		};
 		/* assert that our opt<> specialization for subclasses of iterator_base 
 		 * has had its effect. */
 		static_assert(std::is_base_of<core::iterator_base, opt<iterator_base> >::value, "opt<iterator_base> specialization error");
 		static_assert(std::is_base_of<core::iterator_base, opt<core::iterator_df<> > >::value, "opt<iterator_base> specialization error");
 	
+		/* A FIFO in a power-of-two ring buffer. Unlike std::deque, it only
+		 * ever allocates when it outgrows its high-water mark, and copying
+		 * it is one allocation. */
+		template <typename T>
+		class ring_queue
+		{
+			std::vector<T> buf; // size is zero or a power of two
+			size_t head;
+			size_t count;
+			void grow()
+			{
+				std::vector<T> bigger(buf.empty() ? 16 : 2 * buf.size());
+				for (size_t i = 0; i < count; ++i) bigger[i] = buf[(head + i) & (buf.size() - 1)];
+				buf.swap(bigger);
+				head = 0;
+			}
+		public:
+			ring_queue() : head(0), count(0) {}
+			bool empty() const { return count == 0; }
+			size_t size() const { return count; }
+			void clear() { head = 0; count = 0; }
+			void push_back(const T& t)
+			{
+				if (count == buf.size()) grow();
+				buf[(head + count) & (buf.size() - 1)] = t;
+				++count;
+			}
+			const T& front() const { assert(count > 0); return buf[head]; }
+			void pop_front()
+			{
+				assert(count > 0);
+				head = (head + 1) & (buf.size() - 1);
+				--count;
+			}
+		};
+
 		template <typename DerefAs /* = basic_die */>
 		struct iterator_bf : public iterator_base,
 							 public boost::iterator_facade<
@@ -629,8 +717,17 @@ namespace dwarf
 			typedef iterator_bf<DerefAs> self;
 			friend class boost::iterator_core_access;
 
-			// extra state needed!
-			std::deque< iterator_base > m_queue;
+			/* Extra state needed! We only ever enqueue the first child of
+			 * a sibling run, and we do so as a bare offset and depth, not
+			 * as an iterator (which might hold a libdwarf handle or a
+			 * payload). So the queue is sixteen bytes per DIE that has
+			 * children on the current frontier, however wide the CU. */
+			struct queued
+			{
+				Dwarf_Off off;
+				unsigned short depth;
+			};
+			ring_queue<queued> m_queue;
 			
 			iterator_base& base_reference()
 			{ return static_cast<iterator_base&>(*this); }
@@ -656,6 +753,29 @@ namespace dwarf
 			iterator_bf& operator=(iterator_bf<DerefAs>&& arg) 
 			{ this->base_reference() = std::move(arg); this->m_queue =std::move(arg.m_queue); return *this; }
 
+		private:
+			void enqueue_first_child()
+			{
+				// we ALWAYS enqueue the first child if there is one
+				Dwarf_Off child_off = get_root().first_child_offset(this->base_reference());
+				if (child_off == 0UL) return;
+				queued q = { child_off, (unsigned short)(depth() + 1) };
+				m_queue.push_back(q);
+			}
+			void dequeue()
+			{
+				if (!m_queue.empty())
+				{
+					queued next = m_queue.front(); m_queue.pop_front();
+					this->base_reference() = get_root().pos(next.off, next.depth);
+					assert(!is_real_die_position() || offset_here() > 0);
+				}
+				else
+				{
+					this->base_reference() = iterator_base::END;
+				}
+			}
+		public:
 			void increment()
 			{
 				/* Breadth-first traversal:
@@ -670,52 +790,26 @@ namespace dwarf
 				 * we'll go straight towards its siblings.
 				 * We define increment_skipping_siblings() for this.
 				 */
-				auto first_child = get_root().first_child(this->base_reference()); 
-				//   ^-- might be END
-				
-				// we ALWAYS enqueue the first child if there is one
-				if (first_child != iterator_base::END) m_queue.push_back(first_child);
-				
+				enqueue_first_child();
 				if (get_root().move_to_next_sibling(this->base_reference()))
 				{
 					// success
 					return;
 				}
-				else
-				{
-					// no more siblings; use the queue
-					if (m_queue.size() > 0)
-					{
-						this->base_reference() = m_queue.front(); m_queue.pop_front();
-					}
-					else
-					{
-						this->base_reference() = iterator_base::END;
-					}
-				}
+				// no more siblings; use the queue
+				dequeue();
 			}
 			void increment_skipping_siblings()
 			{
-				auto first_child = get_root().first_child(this->base_reference()); 
-				//   ^-- might be END
-				// we ALWAYS enqueue the first child if there is one
-				if (first_child != iterator_base::END) m_queue.push_back(first_child);
-				// no more siblings; use the queue
-				if (m_queue.size() > 0)
-				{
-					this->base_reference() = m_queue.front();
-					m_queue.pop_front();
-				}
-				else
-				{
-					this->base_reference() = iterator_base::END;
-				}
+				enqueue_first_child();
+				dequeue();
 			}
 			
 			void increment_skipping_subtree()
 			{
 				/* This is the same as increment, except we are not interested in children 
-				 * of the current node. */
+				 * of the current node. With the topology index, moving to the
+				 * next sibling is O(1) however big the subtree. */
 				if (get_root().move_to_next_sibling(this->base_reference()))
 				{
 					// TEMP debugging hack: make sure we have a valid DIE
@@ -724,16 +818,7 @@ namespace dwarf
 					// success -- don't enqueue children
 					return;
 				}
-				else if (m_queue.size() > 0)
-				{
-					this->base_reference() = m_queue.front(); m_queue.pop_front();
-					assert(!is_real_die_position() || offset_here() > 0);
-				}
-				else
-				{
-					this->base_reference() = iterator_base::END;
-					assert(!is_real_die_position() || offset_here() > 0);
-				}
+				dequeue();
 			}
 			
 			void decrement()
@@ -741,7 +826,7 @@ namespace dwarf
 				assert(false); // FIXME
 			}
 			DerefAs& dereference() const
-			{ return dynamic_cast<DerefAs&>(this->iterator_base::dereference()); }
+			{ return payload_cast<DerefAs>(this->iterator_base::dereference()); }
 		};
 		
 		template <typename DerefAs /* = basic_die*/>
@@ -797,7 +882,158 @@ namespace dwarf
 			
 			bool equal(const self& arg) const { return this->base() == arg.base(); }
 			DerefAs& dereference() const
-			{ return dynamic_cast<DerefAs&>(this->iterator_base::dereference()); }
+			{ return payload_cast<DerefAs>(this->iterator_base::dereference()); }
+		};
+		
+		/* Iterates over the DIEs that are Payloads, either throughout the
+		 * file or among one DIE's children, in offset order. Rather than
+		 * visiting and testing every DIE, we walk the topology index's
+		 * posting list for each tag that makes a Payload, merging them.
+		 * So the work is proportional to the number of matches -- plus,
+		 * for children, any matching DIEs further down, which we skip.
+		 * The index only knows DIEs from the file. So for children, once
+		 * those run out, we carry on along any in-memory siblings that
+		 * follow; the whole-file version doesn't see in-memory DIEs.
+		 * Get these from iterator_base::children_subseq_of<>() or
+		 * root_die::all_of<>(). */
+		template <typename DerefAs /* = basic_die*/>
+		struct iterator_tagged : public iterator_base,
+							   public boost::iterator_facade<
+							   iterator_tagged<DerefAs> /* I (CRTP) */
+							 , DerefAs /* V */
+							 , boost::forward_traversal_tag
+							 , DerefAs& //boost::use_default /* Reference */
+							 , Dwarf_Signed /* difference */
+							 >
+		{
+			typedef iterator_tagged<DerefAs> self;
+			typedef topology_index::ordinal ordinal;
+			friend class boost::iterator_core_access;
+		private:
+			// one per tag: what's left of its posting list
+			struct cursor { const ordinal *pos; const ordinal *end; };
+			std::vector<cursor> cursors;
+			root_die *p_r;
+			const topology_index *p_idx;
+			bool children_only;
+			ordinal parent_ord; // if children_only; NONE means the root
+			bool in_memory_tail; // past the indexed DIEs, so going by siblings
+			
+			void settle()
+			{
+				while (true)
+				{
+					cursor *p_best = nullptr;
+					for (auto i_c = cursors.begin(); i_c != cursors.end(); ++i_c)
+					{
+						if (i_c->pos != i_c->end && (!p_best || *i_c->pos < *p_best->pos)) p_best = &*i_c;
+					}
+					if (!p_best) break;
+					ordinal o = *p_best->pos++;
+					if (children_only && p_idx->parent(o) != parent_ord) continue; // deeper down
+					this->base_reference() = p_r->pos(p_idx->offset(o), p_idx->depth(o));
+					return;
+				}
+				cursors.clear();
+				if (!children_only) { this->base_reference() = iterator_base::END; return; }
+				
+				/* Any in-memory children follow the last one from the file, or
+				 * are all there is. Find the last from the file by climbing
+				 * from the last DIE in the parent's subtree. */
+				iterator_base p = (parent_ord == topology_index::NONE) ? p_r->begin()
+					: p_r->pos(p_idx->offset(parent_ord), p_idx->depth(parent_ord));
+				ordinal last = (parent_ord == topology_index::NONE) ? p_idx->size() - 1
+					: parent_ord + p_idx->subtree_size(parent_ord) - 1;
+				if (p_idx->size() == 0 || last == parent_ord)
+				{
+					this->base_reference() = p_r->first_child(p);
+				}
+				else
+				{
+					unsigned short child_depth = p.depth() + 1;
+					while (p_idx->depth(last) > child_depth) last = p_idx->parent(last);
+					this->base_reference() = p_r->next_sibling(
+						p_r->pos(p_idx->offset(last), p_idx->depth(last)));
+				}
+				in_memory_tail = true;
+				skip_non_matching();
+			}
+			void skip_non_matching()
+			{
+				while (*this != iterator_base::END && !this->is_a<DerefAs>())
+				{
+					if (!this->get_root().move_to_next_sibling(this->base_reference()))
+					{
+						this->base_reference() = iterator_base::END;
+					}
+				}
+			}
+		public:
+			iterator_base& base_reference()
+			{ return static_cast<iterator_base&>(*this); }
+			const iterator_base& base() const
+			{ return static_cast<const iterator_base&>(*this); }
+			
+			iterator_tagged() : iterator_base(), p_r(nullptr), p_idx(nullptr),
+				children_only(false), parent_ord(topology_index::NONE), in_memory_tail(true) {}
+			/* From an arbitrary position, we just filter its later siblings. */
+			iterator_tagged(const iterator_base& arg)
+			 : iterator_base(arg), p_r(nullptr), p_idx(nullptr),
+				children_only(false), parent_ord(topology_index::NONE), in_memory_tail(true) {}
+			iterator_tagged(iterator_base&& arg)
+			 : iterator_base(std::move(arg)), p_r(nullptr), p_idx(nullptr),
+				children_only(false), parent_ord(topology_index::NONE), in_memory_tail(true) {}
+			
+			/* The first match in the given part of the index: the whole
+			 * file, or the children of parent_ord (NONE for the root). The
+			 * index must have its posting lists built. */
+			iterator_tagged(root_die& r, const topology_index& idx, bool children_only,
+				ordinal parent_ord = topology_index::NONE)
+			 : iterator_base(), p_r(&r), p_idx(&idx), children_only(children_only),
+			   parent_ord(parent_ord), in_memory_tail(false)
+			{
+				assert(idx.has_postings());
+				ordinal begin = 0;
+				ordinal end = idx.size();
+				if (children_only && parent_ord != topology_index::NONE)
+				{
+					begin = parent_ord + 1;
+					end = parent_ord + idx.subtree_size(parent_ord);
+				}
+				/* Every tag makes a basic_die. */
+				const std::vector<Dwarf_Half>& tags = std::is_same<DerefAs, basic_die>::value
+					? idx.tags_present() : payload_tags<DerefAs>();
+				for (auto i_t = tags.begin(); i_t != tags.end(); ++i_t)
+				{
+					auto list = idx.with_tag(*i_t);
+					cursor c = { std::lower_bound(list.first, list.second, begin),
+						std::lower_bound(list.first, list.second, end) };
+					if (c.pos != c.end) cursors.push_back(c);
+				}
+				settle();
+			}
+			/* The first match among "first" and its later siblings. */
+			static self siblings_from(iterator_base first)
+			{
+				self ret(std::move(first));
+				ret.skip_non_matching();
+				return ret;
+			}
+			
+			void increment()
+			{
+				if (!in_memory_tail) { settle(); return; }
+				if (!this->get_root().move_to_next_sibling(this->base_reference()))
+				{
+					this->base_reference() = iterator_base::END;
+					return;
+				}
+				skip_non_matching();
+			}
+			
+			bool equal(const self& arg) const { return this->base() == arg.base(); }
+			DerefAs& dereference() const
+			{ return payload_cast<DerefAs>(this->iterator_base::dereference()); }
 		};
 		
 		inline unsigned short iterator_base::depth() const
@@ -834,20 +1070,24 @@ namespace dwarf
 		{
 			typedef std::function<bool(root_die::grandchildren_iterator)> fun;
 			is_visible_and_named() : fun([](root_die::grandchildren_iterator i_g) -> bool {
-				bool ret = i_g.global_name_here();
+				/* As global_name_here(), but only copying the name if we cache it. */
+				string_view name = i_g.name_view_here();
+				bool ret = name.data() && (!i_g.has_attr_here(DW_AT_visibility)
+					|| i_g.attr(DW_AT_visibility).get_unsigned() != DW_VIS_local);
 				root_die& r = i_g.get_root();
 				if (ret)
 				{
 					/* install in cache */
-					string name = *i_g.name_here();
+					root_die::guard g(r);
 					r.visible_named_grandchildren_cache.insert(
-						make_pair(name, i_g.offset_here())
+						make_pair(string(name.data(), name.size()), i_g.offset_here())
 					);
 				}
 				/* Have we now swept the entire sequence of grandchildren? 
 				 * If so, we can mark the cache as exhaustive. */
 				if ((++i_g).done_complete_pass())
 				{
+					root_die::guard g(r);
 					r.visible_named_grandchildren_is_complete = true;
 				}
 				return ret;
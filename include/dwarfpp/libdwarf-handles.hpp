@@ -28,6 +28,7 @@ namespace dwarf
 		struct root_die;
 		struct iterator_base;
 		struct abstract_die;
+		namespace native { class image; }
 		
 		/* FIXME: clean up Errors properly. It's complicated. A Dwarf_Error is a handle
 		 * that needs to be dwarf_dealloc'd, but there are two exceptions:
@@ -66,21 +67,20 @@ namespace dwarf
 		struct string_deleter
 		{
 			Debug::raw_handle_type dbg; 
-			string_deleter(Debug::raw_handle_type dbg) : dbg(dbg) {}
+			// as in Die::deleter, so that we can lock the root, if concurrent
+			root_die *p_root;
+			// strings borrowed from a mapped section (see native.hpp) are never freed
+			bool borrowed;
+			string_deleter(Debug::raw_handle_type dbg, root_die *p_root)
+			 : dbg(dbg), p_root(p_root), borrowed(false) {}
 
 			// we supply a default constructor, creating a deleter
 			// that can only "deallocate" null pointers (noop)
-			string_deleter() : dbg(nullptr) {}
+			string_deleter() : dbg(nullptr), p_root(nullptr), borrowed(false) {}
+			static string_deleter borrowing()
+			{ string_deleter d; d.borrowed = true; return d; }
 			
-			void operator()(const char *arg)
-			{ 
-				if (dbg)
-				{
-					dwarf_dealloc(dbg, 
-						const_cast<void*>(static_cast<const void *>(arg)), 
-						DW_DLA_STRING);
-				} else assert(!arg); 
-			}
+			void operator()(const char *arg) const; // locks the root, if concurrent
 		};
 		typedef struct Dwarf_Die_s*        Dwarf_Die;
 		struct Die : /*private*/ virtual abstract_die // remind me: why is this private?
@@ -98,10 +98,43 @@ namespace dwarf
 				// also provide a lame default deleter that can only delete nullptr
 				//deleter() : dbg(nullptr) {}
 				// temporarily DISABLED while we check we only use it where necessary
-				void operator ()(raw_handle_type arg) const 
-				{ if (!dbg) assert(!arg); else if (arg) dwarf_dealloc(dbg, arg, DW_DLA_DIE); }
+				void operator ()(raw_handle_type arg) const; // locks the root, if concurrent
+			};
+			/* A Die is really just an offset (plus our root). We only get a
+			 * Dwarf_Die when someone needs the raw handle: to build an
+			 * AttributeList, or to navigate if we don't have the native decoder
+			 * (see native.hpp). We then keep it until we're destroyed. So
+			 * duplicating a Die costs nothing until the copy is used.
+			 * No DIE lives at offset 0, so 0 means null. We mimic as much of
+			 * unique_ptr as the rest of the code uses. */
+			struct handle_type
+			{
+				Dwarf_Off off;
+				mutable raw_handle_type materialised;
+				deleter del;
+				handle_type(std::nullptr_t, deleter d) : off(0UL), materialised(nullptr), del(d) {}
+				handle_type(Dwarf_Off off, deleter d) : off(off), materialised(nullptr), del(d) {}
+				handle_type(raw_handle_type h, deleter d); /* takes ownership, as unique_ptr */
+				handle_type(handle_type&& h) : off(h.off), materialised(h.materialised), del(h.del)
+				{ h.off = 0UL; h.materialised = nullptr; }
+				handle_type& operator=(handle_type&& h)
+				{
+					if (&h == this) return *this;
+					reset();
+					off = h.off; materialised = h.materialised; del = h.del;
+					h.off = 0UL; h.materialised = nullptr;
+					return *this;
+				}
+				~handle_type() { reset(); }
+				void reset()
+				{ if (materialised) del(materialised); materialised = nullptr; off = 0UL; }
+				explicit operator bool() const { return off != 0UL; }
+				raw_handle_type get() const; // may call dwarf_offdie
+				deleter& get_deleter() { return del; }
+				const deleter& get_deleter() const { return del; }
+				/* Another handle on the same DIE; no libdwarf call. */
+				handle_type duplicate() const { return handle_type(off, del); }
 			};
-			typedef unique_ptr<opaque_type, deleter> handle_type;
 			handle_type handle;
 			Debug::raw_handle_type get_dbg() const { return handle.get_deleter().dbg; }
 			root_die& get_constructing_root() const 
@@ -137,6 +170,9 @@ namespace dwarf
 
 			raw_handle_type raw_handle()       { return handle.get(); }
 			raw_handle_type raw_handle() const { return handle.get(); }
+#if DWARFPP_NATIVE_DECODER
+			const native::image *native_image() const; // null if we're libdwarf-only
+#endif
 			
 			// libdwarf methods
 			Dwarf_Off offset_here() const;
@@ -149,7 +185,7 @@ namespace dwarf
 			
 			// for convenience, this one is public -- basic_die's subclasses call it
 			// (whereas the rest of our abstract_die implementation is private)
-			inline encap::attribute_map copy_attrs() const;
+			encap::attribute_map copy_attrs() const;
 
 			friend class iterator_base;
 		//private: 
@@ -158,6 +194,8 @@ namespace dwarf
 			inline Dwarf_Half get_tag() const { return tag_here(); }
 			inline opt<string> get_name() const 
 			{ return name_here() ? opt<string>(string(name_here().get())) : opt<string>(); }
+			string_view get_name_view() const;
+			block_view get_block_view(Dwarf_Half attr) const;
 			inline unique_ptr<const char, string_deleter> get_raw_name() const
 			{ return name_here(); }
 			inline Dwarf_Off get_enclosing_cu_offset() const 
@@ -165,6 +203,7 @@ namespace dwarf
 			inline bool has_attr(Dwarf_Half attr) const { return has_attr_here(attr); }
 			// inline encap::attribute_map copy_attrs(root_die& r) const; // -- declared above
 			inline spec& get_spec(root_die& r) const { return spec_here(); }
+			Die *as_libdwarf_die() const { return const_cast<Die *>(this); }
 		};
 		
 		/* Note: there are two ways of getting attributes out of libdwarf:
@@ -572,14 +611,14 @@ namespace dwarf
 
 			static inline handle_type
 			try_construct(const Die& it);
-			inline void copy_list()
+			inline void copy_list(root_die *p_root)
 			{
 				for (Dwarf_Signed i = 0; i < handle.get_deleter().len; ++i)
 				{
 					copied_list.push_back(
 						unique_ptr<char, string_deleter>(
 							handle.get()[i], 
-							string_deleter(get_dbg())
+							string_deleter(get_dbg(), p_root)
 						)
 					);
 				}
@@ -588,7 +627,7 @@ namespace dwarf
 			inline StringList(handle_type h, const Die& d) : handle(std::move(h)) /* "upgrade" constructor */ 
 			{
 				/* we tolerate null handles -- it just means the empty list. */
-				if (handle) copy_list();
+				if (handle) copy_list(d.handle.get_deleter().p_constructing_root);
 			}
 
 			// FIXME: get raw handle?
@@ -688,7 +727,7 @@ namespace dwarf
 			 * Note: the block contains char pointers. 
 			 * We have to take each block element in turn
 			 * and make it into an unique_ptr<char, string_deleter>. */
-			copy_list();
+			copy_list(d.handle.get_deleter().p_constructing_root);
 		}
 		
 		inline Locdesc::handle_type
@@ -864,9 +903,6 @@ namespace dwarf
 			if (!handle) throw Error(current_dwarf_error, 0);
 		}
 		std::ostream& operator<<(std::ostream& s, const AttributeList& attrs);
-		// inlines we couldn't define earlier -- declared in private/libdwarf-handles.hpp
-		inline encap::attribute_map Die::copy_attrs() const
-		{ return encap::attribute_map(AttributeList(*this), *this, get_constructing_root()); }
 
 	}
 }
@@ -0,0 +1,321 @@
+/* dwarfpp: C++ binding for a useful subset of libdwarf, plus extra goodies.
+ *
+ * name-index.hpp: indexes of the names visible from the root.
+ *
+ * Copyright (c) 2008--17, Stephen Kell. For licensing information, see the
+ * LICENSE file in the root of the libdwarfpp tree.
+ */
+
+#ifndef DWARFPP_NAME_INDEX_HPP_
+#define DWARFPP_NAME_INDEX_HPP_
+
+#include <vector>
+#include <map>
+#include <utility>
+#include <unordered_set>
+#include <memory>
+#include <cstdint>
+#include <string>
+
+#include "util.hpp"
+#include "opt.hpp"
+#include "topology.hpp"
+
+namespace dwarf
+{
+	namespace core
+	{
+		using std::vector;
+		using dwarf::spec::opt;
+		struct root_die;
+		namespace native { class image; }
+
+		/* Searches anchored at the root (resolve_all_visible_from_root() and
+		 * friends) look at every CU's children with a visible name, i.e.
+		 * the root's grandchildren. The multimap that root_die keeps of
+		 * those is filled in as a side-effect of walking them, so until one
+		 * walk has finished, every query walks the whole file again.
+		 *
+		 * This index is instead built in one pass, up front. It's an
+		 * open-addressing table (linear probing, at most half full) from
+		 * name to the DIEs' ordinals in the topology index. Each slot keeps
+		 * the name's hash, so a probe only compares strings whose hashes
+		 * match. The names themselves aren't copied: they point into the
+		 * file's mapping (with the native decoder) or at the root's interned
+		 * strings, so the index mustn't outlive the root that built it.
+		 *
+		 * Only DIEs from the file are indexed; those created in memory stay
+		 * in the root's multimap. */
+		class name_index
+		{
+		public:
+			typedef topology_index::ordinal ordinal;
+			/* Bernstein's hash, h * 33 + c. */
+			static uint32_t hash(string_view s);
+		protected:
+			struct slot
+			{
+				uint32_t hash;
+				uint32_t len;
+				const char *name; // null if the slot is free
+				ordinal o;
+			};
+			vector<slot> slots; // a power of two, or empty
+			size_t n;
+			void insert(const slot& s);
+			/* Each CU's contribution, built separately so that CUs can be
+			 * done in parallel; concatenated in CU order before hashing. */
+			typedef vector<slot> piece;
+			void index_pieces(vector<piece>& pieces);
+		public:
+			name_index() : n(0) {} // empty
+			/* Fast: decodes names and visibility straight from the section
+			 * bytes, doing CUs on nthreads threads (0 means one per core). */
+			name_index(const native::image& img, const topology_index& t, unsigned nthreads = 1);
+			/* Slow: asks libdwarf (via the root's iterators). */
+			name_index(root_die& r, const topology_index& t);
+
+			size_t size() const { return n; }
+			/* Heap bytes used by the table. The names aren't ours. */
+			size_t footprint() const { return slots.capacity() * sizeof (slot); }
+
+			/* Append the ordinals of the DIEs called name, in ordinal
+			 * (hence file) order. */
+			void find(string_view name, vector<ordinal>& out) const;
+		};
+
+		/* The same table, but from the names of the symbols that DIEs
+		 * describe, so that we can go from an ELF symbol (in .symtab, or a
+		 * stack trace) to its DIE. That's what
+		 * with_static_location_die::get_linkage_name() would say: the
+		 * DW_AT_linkage_name (or DW_AT_MIPS_linkage_name) of the DIE or of
+		 * what it completes or instantiates, or else its name if that isn't
+		 * mangled: always in C, and in C++ for main() and for external
+		 * things at global scope, other than functions with parameters. We
+		 * take subprograms with code and variables with static addresses,
+		 * but not declarations. Local symbols are in too, so a name may
+		 * find a definition in each of several CUs, in offset order. */
+		class linkage_name_index : public name_index
+		{
+		public:
+			linkage_name_index() {} // empty
+			linkage_name_index(const native::image& img, const topology_index& t, unsigned nthreads = 1);
+			linkage_name_index(root_die& r, const topology_index& t);
+			/* Without the index: append the ordinals of the DIEs in one CU
+			 * that define the symbol called name, by looking at them all. */
+			static void find_in_cu(const native::image& img, const topology_index& t,
+				ordinal cu, string_view name, vector<ordinal>& out);
+			static void find_in_cu(root_die& r, const topology_index& t,
+				ordinal cu, string_view name, vector<ordinal>& out);
+		};
+
+		/* The indexes above cost a slot per name, which on a big binary is
+		 * more than we may want to build (or keep) just to make a first or
+		 * failing lookup cheap. Mostly what such a lookup needs is to know
+		 * which CUs it can skip. So for each CU we keep a Bloom filter of
+		 * the names it defines: the visible names of its children (as
+		 * name_index has them) and the symbols of its definitions (as
+		 * linkage_name_index has them). They're blocked filters: all of a
+		 * name's bits fall in one 64-bit word, so testing a CU is one load.
+		 * At about ten bits per name, a CU lacking the name is searched
+		 * anyway about one time in fifty. Like the topology index's, the
+		 * arrays can be borrowed from a mapped index cache file. */
+		class cu_name_filters
+		{
+		public:
+			typedef topology_index::ordinal ordinal;
+			struct arrays
+			{
+				uint64_t n_cus;
+				const Dwarf_Off *cu_offsets; // in file order
+				const uint64_t *starts; // n_cus + 1 word positions; each filter is a power of two words
+				const uint64_t *words;
+			};
+		private:
+			vector<Dwarf_Off> cu_offsets;
+			vector<uint64_t> starts;
+			vector<uint64_t> words;
+			arrays a;
+			std::shared_ptr<const void> p_borrowed_from; // keeps a mapping alive
+			void add_cu(Dwarf_Off cu_off, const vector<uint64_t>& mixes);
+			void point_at_vectors();
+		public:
+			/* As for name_index, with CUs done on nthreads threads. */
+			cu_name_filters(const native::image& img, const topology_index& t, unsigned nthreads = 1);
+			cu_name_filters(root_die& r, const topology_index& t);
+			/* Borrowed: use someone else's arrays, holding on to "owner". */
+			cu_name_filters(const arrays& borrowed, std::shared_ptr<const void> owner)
+			 : a(borrowed), p_borrowed_from(owner) {}
+			cu_name_filters(const cu_name_filters&) = delete;
+			cu_name_filters& operator=(const cu_name_filters&) = delete;
+
+			const arrays& get_arrays() const { return a; }
+			size_t cu_count() const { return a.n_cus; }
+			/* Heap bytes used by the arrays. Borrowed arrays don't count. */
+			size_t footprint() const;
+
+			/* Append the offsets of the CUs that may define name, in file
+			 * order. The others certainly don't. */
+			void candidate_cus(string_view name, vector<Dwarf_Off>& out) const;
+			/* Whether the CU at cu_off may define name. CUs we have no
+			 * filter for (e.g. made in memory) may define anything. */
+			bool may_contain(Dwarf_Off cu_off, string_view name) const;
+		};
+
+		/* Hashing is no help with "every name starting with foo_" or
+		 * "every name matching *_impl". For those we keep the visible names
+		 * again, but each distinct name once and in sorted order, with the
+		 * ordinals of the DIEs bearing it. A prefix is then a binary search
+		 * for a range of names; a glob pattern is matched only against the
+		 * distinct names in the range of its literal prefix. Nothing is
+		 * decoded at query time, so no payloads get made. As with
+		 * name_index, the names are views that the root keeps alive. */
+		class sorted_name_table
+		{
+		public:
+			typedef topology_index::ordinal ordinal;
+		private:
+			vector<string_view> names; // distinct, sorted
+			vector<uint32_t> starts; // names[i]'s DIEs are ordinals[starts[i]..starts[i+1])
+			vector<ordinal> ordinals;
+			typedef vector<std::pair<string_view, ordinal> > piece;
+			void index_pieces(vector<piece>& pieces);
+			/* Append the DIEs of names[begin..end), in ordinal order. */
+			void append_dies(size_t begin, size_t end, vector<ordinal>& out) const;
+		public:
+			sorted_name_table() : starts(1, 0) {} // empty
+			/* As for name_index. */
+			sorted_name_table(const native::image& img, const topology_index& t, unsigned nthreads = 1);
+			sorted_name_table(root_die& r, const topology_index& t);
+
+			/* Distinct names, and the DIEs they name. */
+			size_t size() const { return names.size(); }
+			size_t die_count() const { return ordinals.size(); }
+			const vector<string_view>& sorted_names() const { return names; }
+			/* Heap bytes used by the table. The names aren't ours. */
+			size_t footprint() const;
+
+			/* The range of sorted_names() that start with prefix. */
+			std::pair<size_t, size_t> prefix_range(string_view prefix) const;
+			/* Append the ordinals of the DIEs whose names start with prefix,
+			 * or match the glob pattern, in ordinal (hence file) order. */
+			void find_prefix(string_view prefix, vector<ordinal>& out) const;
+			void find_glob(string_view pattern, vector<ordinal>& out) const;
+
+			/* Simple globs: '*' matches any string, '?' any one character,
+			 * and a backslash makes the next character literal. */
+			static bool glob_match(string_view pattern, string_view s);
+			/* The part of the pattern before any of those. */
+			static std::string glob_literal_prefix(string_view pattern);
+		};
+
+		/* Many binaries already carry name tables built by the producer or
+		 * linker: DWARF 5's .debug_names, gdb's .gdb_index, or the older
+		 * .debug_pubnames and .debug_pubtypes. With these, a cold lookup
+		 * can go straight to a few candidate DIEs (or, with .gdb_index, a
+		 * few CUs) without decoding most of .debug_info. We use the best
+		 * one present. None of them is complete by our standards, though:
+		 * producers leave out declarations, and may leave out whole CUs.
+		 * So they can find a visible grandchild, but can't promise that
+		 * there are no others. */
+		class accelerator_tables
+		{
+		public:
+			enum kind { NONE, DEBUG_NAMES, GDB_INDEX, PUBNAMES };
+		private:
+			const native::image& img;
+			kind k;
+			/* .debug_names may hold several name indexes, one per module
+			 * that the linker put together. We decode their headers and
+			 * abbreviations up front; the rest we read in place. */
+			struct names_abbrev
+			{
+				Dwarf_Unsigned tag;
+				vector<std::pair<Dwarf_Unsigned, Dwarf_Unsigned> > idx_forms; // (DW_IDX_*, DW_FORM_*)
+			};
+			struct names_unit
+			{
+				unsigned offset_size;
+				uint32_t comp_unit_count;
+				uint32_t bucket_count;
+				uint32_t name_count;
+				const unsigned char *cu_list;
+				const unsigned char *buckets;
+				const unsigned char *hashes;
+				const unsigned char *str_offsets;
+				const unsigned char *entry_offsets;
+				const unsigned char *entry_pool;
+				const unsigned char *end;
+				std::map<Dwarf_Unsigned, names_abbrev> abbrevs;
+			};
+			vector<names_unit> names_units;
+			/* .gdb_index maps names to CUs, not DIEs. */
+			struct
+			{
+				const unsigned char *cu_list; // pairs of 64-bit offset and length
+				uint32_t n_cus;
+				const unsigned char *symbol_table; // pairs of 32-bit name and CU-vector offsets
+				uint32_t n_slots; // a power of two
+				const unsigned char *constant_pool;
+			} gdb;
+			/* The pubnames sections have no hash table, so we sort their
+			 * entries by name when we're constructed. */
+			vector<std::pair<string_view, Dwarf_Off> > pub_entries;
+			bool read_debug_names();
+			bool read_gdb_index();
+			bool read_pubnames();
+			void names_candidates(const names_unit& u, string_view name, vector<Dwarf_Off>& dies) const;
+			void gdb_index_candidates(string_view name, vector<Dwarf_Off>& cus) const;
+		public:
+			explicit accelerator_tables(const native::image& img);
+			accelerator_tables(const accelerator_tables&) = delete;
+			accelerator_tables& operator=(const accelerator_tables&) = delete;
+			kind get_kind() const { return k; }
+			/* Heap bytes used by what we decoded. The tables aren't ours. */
+			size_t footprint() const;
+
+			/* Append the offsets of the visible grandchildren called name
+			 * that the tables know about, checked against .debug_info, in
+			 * offset order. */
+			void find(string_view name, vector<Dwarf_Off>& out) const;
+		};
+
+		/* Looking up a child by name (root_die::find_named_child()) walks
+		 * the children, comparing names, which is slow for big structs and
+		 * namespaces and happens once per component of a qualified name.
+		 * So the first lookup under a parent hashes all its children's names,
+		 * into a table shared by the whole CU (saving a table per parent).
+		 * Keys are (parent, name); the value is the parent's first child
+		 * with that name. As with name_index, the names are views that the
+		 * root keeps alive. */
+		class child_name_index
+		{
+			struct slot
+			{
+				uint32_t hash;
+				uint32_t len;
+				const char *name; // null if the slot is free
+				Dwarf_Off parent;
+				Dwarf_Off child;
+			};
+			vector<slot> slots; // a power of two, at most half full, or empty
+			size_t n;
+			std::unordered_set<Dwarf_Off> parents;
+			static uint32_t hash(Dwarf_Off parent, string_view name);
+			/* Where the key is, or the free slot where it would go. */
+			size_t probe(uint32_t h, Dwarf_Off parent, string_view name) const;
+			void grow();
+		public:
+			child_name_index() : n(0) {}
+			/* Whether we've had this parent's children yet. */
+			bool has_parent(Dwarf_Off parent) const { return parents.find(parent) != parents.end(); }
+			/* Its named children, in order. */
+			void add_parent(Dwarf_Off parent, const vector<std::pair<string_view, Dwarf_Off> >& named_children);
+			opt<Dwarf_Off> find(Dwarf_Off parent, string_view name) const;
+			size_t size() const { return n; }
+			size_t footprint() const;
+		};
+	}
+}
+
+#endif
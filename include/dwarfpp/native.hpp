@@ -0,0 +1,349 @@
+/* dwarfpp: C++ binding for a useful subset of libdwarf, plus extra goodies.
+ *
+ * native.hpp: a minimal decoder for .debug_info, working directly on
+ * mmapped section bytes rather than going through libdwarf.
+ *
+ * Copyright (c) 2008--17, Stephen Kell. For licensing information, see the
+ * LICENSE file in the root of the libdwarfpp tree.
+ */
+
+#ifndef DWARFPP_NATIVE_HPP_
+#define DWARFPP_NATIVE_HPP_
+
+#include <vector>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <cstring>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cassert>
+
+#include "util.hpp"
+#include "spec.hpp"
+#include "opt.hpp"
+#include "libdwarf.hpp" /* for Dwarf_Off etc., and No_entry */
+
+namespace dwarf
+{
+	namespace core
+	{
+		/* Why do we need this? libdwarf gives us a freshly malloc'd Dwarf_Die
+		 * for every position we visit, and on big binaries the allocation
+		 * dominates a full-tree scan. Everything in here just computes offsets
+		 * from the section bytes, using the abbreviation tables. The only
+		 * allocation is at setup time (unit and abbrev tables).
+		 *
+		 * What we *don't* do: relocations (so no ET_REL files), compressed
+		 * sections, split DWARF, type units (in .debug_types or DWARF 5
+		 * .debug_info), or targets of the opposite byte order. In all those
+		 * cases the image constructor throws No_entry and the caller should
+		 * fall back to libdwarf. */
+		namespace native
+		{
+			using std::vector;
+			using std::map;
+			using namespace dwarf::lib;
+			using dwarf::spec::opt;
+
+			/* Raw reading primitives. These all advance "pos".
+			 * NOTE: we only handle host-endian data (checked in image::image). */
+			inline Dwarf_Unsigned read_uleb128(const unsigned char *& pos)
+			{
+				Dwarf_Unsigned result = 0;
+				unsigned shift = 0;
+				unsigned char byte;
+				do
+				{
+					byte = *pos++;
+					if (shift < 64) result |= ((Dwarf_Unsigned) (byte & 0x7f)) << shift;
+					shift += 7;
+				} while (byte & 0x80);
+				return result;
+			}
+			inline Dwarf_Signed read_sleb128(const unsigned char *& pos)
+			{
+				Dwarf_Signed result = 0;
+				unsigned shift = 0;
+				unsigned char byte;
+				do
+				{
+					byte = *pos++;
+					if (shift < 64) result |= ((Dwarf_Signed) (byte & 0x7f)) << shift;
+					shift += 7;
+				} while (byte & 0x80);
+				if (shift < 64 && (byte & 0x40)) result |= -((Dwarf_Signed) 1 << shift);
+				return result;
+			}
+			/* The same, for bytes we can't trust to be well-formed: we won't
+			 * read at or past end, and return none (with pos at end) if the
+			 * number doesn't finish before it. */
+			inline opt<Dwarf_Unsigned> read_uleb128(const unsigned char *& pos, const unsigned char *end)
+			{
+				const unsigned char *p = pos;
+				while (p < end && (*p & 0x80)) ++p;
+				if (p == end) { pos = end; return opt<Dwarf_Unsigned>(); }
+				return read_uleb128(pos);
+			}
+			inline opt<Dwarf_Signed> read_sleb128(const unsigned char *& pos, const unsigned char *end)
+			{
+				const unsigned char *p = pos;
+				while (p < end && (*p & 0x80)) ++p;
+				if (p == end) { pos = end; return opt<Dwarf_Signed>(); }
+				return read_sleb128(pos);
+			}
+			template <typename T>
+			inline T read_fixed(const unsigned char *& pos)
+			{
+				T val;
+				std::memcpy(&val, pos, sizeof val);
+				pos += sizeof val;
+				return val;
+			}
+			inline Dwarf_Unsigned read_sized(const unsigned char *& pos, unsigned size)
+			{
+				switch (size)
+				{
+					case 1: return read_fixed<uint8_t>(pos);
+					case 2: return read_fixed<uint16_t>(pos);
+					case 3: { /* only for DW_FORM_strx3 / addrx3; assumes little-endian */
+						Dwarf_Unsigned v = pos[0] | (pos[1] << 8) | (pos[2] << 16);
+						pos += 3;
+						return v;
+					}
+					case 4: return read_fixed<uint32_t>(pos);
+					case 8: return read_fixed<uint64_t>(pos);
+					default: assert(false); abort();
+				}
+			}
+
+			struct section
+			{
+				const unsigned char *begin;
+				const unsigned char *end;
+				section() : begin(nullptr), end(nullptr) {}
+				section(const unsigned char *begin, const unsigned char *end)
+				 : begin(begin), end(end) {}
+				size_t size() const { return end - begin; }
+				bool contains(Dwarf_Off off) const { return begin && off < size(); }
+				explicit operator bool() const { return begin != nullptr; }
+			};
+
+			struct attr_spec
+			{
+				Dwarf_Half attr;
+				Dwarf_Half form;
+				Dwarf_Signed implicit_const; // only meaningful for DW_FORM_implicit_const
+				/* Where this attribute's bytes start, relative to the first
+				 * attribute's. Only meaningful for an abbrev's first "nplaced"
+				 * specs, and only if the table is laid out (see below). */
+				unsigned offset;
+			};
+			struct abbrev
+			{
+				Dwarf_Unsigned code; // 0 means "no such abbrev"
+				Dwarf_Half tag;
+				bool has_children;
+				/* Our attribute specs live contiguously in the table's spec vector. */
+				unsigned first_spec;
+				unsigned nspecs;
+				/* If an abbrev has DW_AT_sibling, we can skip children cheaply. */
+				opt<unsigned> sibling_spec; // index relative to first_spec
+				/* Every spec up to and including the first of variable size
+				 * (e.g. a string or a LEB128) sits at a fixed offset, so
+				 * fetching it needs no decoding of the others. If all of them
+				 * are fixed-size, so is the whole DIE. */
+				unsigned nplaced;
+				opt<unsigned> attrs_size;
+				abbrev() : code(0), tag(0), has_children(false), first_spec(0), nspecs(0),
+				  nplaced(0) {}
+			};
+			struct unit;
+			struct abbrev_table
+			{
+				/* Codes are almost always dense and start at 1, so we index
+				 * directly by code. Sparse codes still work, they just waste space. */
+				vector<abbrev> by_code;
+				vector<attr_spec> specs;
+				const abbrev *lookup(Dwarf_Unsigned code) const
+				{
+					if (code == 0 || code >= by_code.size() || by_code[code].code != code) return nullptr;
+					return &by_code[code];
+				}
+				const attr_spec *specs_begin(const abbrev& a) const
+				{ return specs.data() + a.first_spec; }
+				const attr_spec *specs_end(const abbrev& a) const
+				{ return specs.data() + a.first_spec + a.nspecs; }
+				/* Form sizes depend on the unit's address and offset sizes,
+				 * so the offsets above are computed for the first unit to use
+				 * the table. Any other unit must match it to use them. */
+				Dwarf_Half laid_out_address_size;
+				Dwarf_Half laid_out_ref_addr_size;
+				Dwarf_Half laid_out_offset_size; // 0 if not laid out
+				inline bool laid_out_for(const unit& u) const;
+				void lay_out(const unit& u);
+				abbrev_table(const section& s, Dwarf_Unsigned off); // throws No_entry
+				abbrev_table() : laid_out_address_size(0), laid_out_ref_addr_size(0),
+				  laid_out_offset_size(0) {}
+			};
+
+			struct unit
+			{
+				Dwarf_Off offset;         // of the unit header
+				Dwarf_Off end;            // one past the unit's last byte
+				Dwarf_Off first_die;      // the unit's top-level DIE
+				Dwarf_Half version;
+				Dwarf_Half unit_type;     // DW_UT_* for v5; DW_UT_compile otherwise
+				Dwarf_Half address_size;
+				Dwarf_Half offset_size;   // 4 or 8
+				Dwarf_Unsigned abbrev_offset;
+				const abbrev_table *p_abbrevs;
+				opt<Dwarf_Off> str_offsets_base; // for DW_FORM_strx*
+			};
+			inline bool abbrev_table::laid_out_for(const unit& u) const
+			{
+				return laid_out_offset_size == u.offset_size
+					&& laid_out_address_size == u.address_size
+					&& laid_out_ref_addr_size == (u.version <= 2 ? u.address_size : u.offset_size);
+			}
+
+			/* Where we are: a decoded DIE header. This is cheap (no allocation)
+			 * and we build them on the fly. */
+			struct cursor
+			{
+				Dwarf_Off off;
+				const unit *p_unit;
+				const abbrev *p_abbrev;  // null for a null entry
+				const unsigned char *attrs; // the first attribute's bytes
+			};
+
+			/* One attribute of one DIE, found without decoding anything else.
+			 * The image's *_value() calls decode it; those return nothing
+			 * if the form isn't one they understand. */
+			struct raw_attr
+			{
+				Dwarf_Half attr;
+				Dwarf_Half form;            // never DW_FORM_indirect
+				const unsigned char *pos;   // the value's bytes; null if the DIE hasn't the attribute
+				const unit *p_unit;
+				Dwarf_Signed implicit_const;
+				explicit operator bool() const { return pos != nullptr; }
+			};
+
+			/* Where a DIE sits in the tree. */
+			struct location
+			{
+				unsigned short depth;  // 1 for a unit's top-level DIE
+				Dwarf_Off parent;      // 0 (the root) for a unit's top-level DIE
+			};
+
+			/* To find a DIE by offset and learn its depth and parent, we need
+			 * to know the chain of DIEs open at that point. Every so often
+			 * along a unit, we record that chain. To locate a DIE, we binary-
+			 * search for the nearest checkpoint before it and decode forwards
+			 * from there. We build these per unit, the first time we need one. */
+			struct unit_offset_index
+			{
+				static const unsigned interval = 32; // DIEs between checkpoints
+				struct checkpoint
+				{
+					Dwarf_Off off;
+					unsigned first_ancestor; // in "ancestors", outermost first
+					unsigned short depth;    // so there are depth - 1 ancestors
+				};
+				vector<checkpoint> checkpoints; // sorted by offset
+				vector<Dwarf_Off> ancestors;
+			};
+
+			class image
+			{
+				void *mapping;
+				size_t mapping_len;
+				section info;
+				section abbrev_sec;
+				section str;
+				section line_str;
+				section str_offsets;
+				section build_id_bytes; // the descriptor of the NT_GNU_BUILD_ID note, if any
+				/* Name tables the producer or linker may have left us. */
+				section debug_names;
+				section gdb_index;
+				section pubnames;
+				section pubtypes;
+				vector<unit> units; // sorted by offset
+				map<Dwarf_Unsigned, abbrev_table> abbrev_tables;
+				/* Parallel to units; filled in lazily, under the lock. */
+				mutable vector<std::unique_ptr<unit_offset_index> > unit_offset_indexes;
+				mutable std::mutex unit_offset_indexes_lock;
+				const unit_offset_index& offset_index_for(const unit& u) const;
+
+				void find_sections(); // throws No_entry
+				void read_units();    // throws No_entry
+			public:
+				/* We map the whole file ourselves, so that we don't disturb
+				 * the caller's file offset (libdwarf/libelf are using the fd too). */
+				explicit image(int fd);
+				~image();
+				image(const image&) = delete;
+				image& operator=(const image&) = delete;
+
+				const section& info_section() const { return info; }
+				const section& abbrev_section() const { return abbrev_sec; }
+				const section& str_section() const { return str; }
+				const section& build_id() const { return build_id_bytes; }
+				const section& debug_names_section() const { return debug_names; }
+				const section& gdb_index_section() const { return gdb_index; }
+				const section& pubnames_section() const { return pubnames; }
+				const section& pubtypes_section() const { return pubtypes; }
+				const vector<unit>& get_units() const { return units; }
+
+				/* Decoding. */
+				const unit *unit_containing(Dwarf_Off off) const;
+				bool decode(Dwarf_Off off, cursor& out) const;
+				bool decode(Dwarf_Off off, const unit *p_u, cursor& out) const;
+				const unsigned char *skip_form(Dwarf_Half form, const unit& u,
+					const unsigned char *pos) const;
+				const unsigned char *skip_attrs(const cursor& c) const;
+				/* Find an attribute's bytes, without decoding anything else. */
+				const unsigned char *find_attr(const cursor& c, Dwarf_Half attr,
+					Dwarf_Half *out_form = nullptr, const attr_spec **out_spec = nullptr) const;
+				const char *form_string(Dwarf_Half form, const unit& u,
+					const unsigned char *pos) const;
+				/* One attribute of the DIE at "off", straight from the section
+				 * bytes. Returns false if no DIE begins there; otherwise
+				 * "out" is null-valued if the DIE hasn't the attribute. */
+				bool fetch_attr(Dwarf_Off off, Dwarf_Half attr, raw_attr& out) const;
+				/* Decoding what fetch_attr found. Data forms are zero-extended
+				 * by unsigned_value and sign-extended by signed_value. */
+				opt<Dwarf_Unsigned> unsigned_value(const raw_attr& a) const;
+				opt<Dwarf_Signed> signed_value(const raw_attr& a) const;
+				opt<bool> flag_value(const raw_attr& a) const;
+				opt<Dwarf_Addr> address_value(const raw_attr& a) const;
+				opt<Dwarf_Off> ref_value(const raw_attr& a) const; // as a .debug_info offset
+				const char *string_value(const raw_attr& a) const // borrowed from the mapping
+				{ return form_string(a.form, *a.p_unit, a.pos); }
+				block_view block_value(const raw_attr& a) const; // likewise
+				/* Skip the whole subtree rooted at c, returning the offset just past it. */
+				Dwarf_Off skip_subtree(const cursor& c) const;
+
+				/* Navigation and per-DIE queries. These take DIE offsets, and
+				 * return 0 for "none" (no DIE lives at offset 0). */
+				bool is_die_offset(Dwarf_Off off) const;
+				Dwarf_Off first_child(Dwarf_Off off) const;
+				Dwarf_Off next_sibling(Dwarf_Off off) const;
+				Dwarf_Half tag(Dwarf_Off off) const; // throws No_entry if no DIE is there
+				const char *name(Dwarf_Off off) const; // borrowed from the mapping
+				bool has_attr(Dwarf_Off off, Dwarf_Half attr) const;
+				Dwarf_Off enclosing_cu_offset(Dwarf_Off off) const;
+				/* Find any DIE by offset, in O(log n) plus a short decode.
+				 * Returns false if no DIE begins at that offset. */
+				bool locate(Dwarf_Off off, location& out) const;
+				/* For libdwarf's "current CU" style of iteration. */
+				Dwarf_Off cu_offset_for_next_header(Dwarf_Off next_cu_header) const;
+			};
+		}
+	}
+}
+
+#endif
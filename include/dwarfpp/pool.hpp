@@ -0,0 +1,80 @@
+/* dwarfpp: C++ binding for a useful subset of libdwarf, plus extra goodies.
+ *
+ * pool.hpp: per-root pooled allocation for DIE payloads.
+ *
+ * Copyright (c) 2008--17, Stephen Kell. For licensing information, see the
+ * LICENSE file in the root of the libdwarfpp tree.
+ */
+
+#ifndef DWARFPP_POOL_HPP_
+#define DWARFPP_POOL_HPP_
+
+#include <vector>
+#include <memory>
+#include <cstddef>
+#include <cassert>
+
+namespace dwarf
+{
+	namespace core
+	{
+		using std::vector;
+
+		/* Payloads are small (a few hundred bytes at most), come in a few
+		 * dozen sizes (one per DIE class), and are made and dropped in
+		 * great numbers as iterators come and go. So rather than going to
+		 * the heap each time, each root_die carves them out of big chunks,
+		 * keeping a free list per size class. Freed payloads go back on
+		 * their free list; the chunks themselves are only given back when
+		 * the root is destroyed. Anything too big for our size classes
+		 * goes to the heap as normal.
+		 *
+		 * This is not thread-safe by itself. In concurrent mode, payloads
+		 * are only made and destroyed under the root's lock. */
+		class payload_pool
+		{
+		public:
+			static const size_t GRANULE = 16;
+			static const size_t NCLASSES = 64; // so up to 1KB
+			static const size_t CHUNK_SIZE = 64 * 1024;
+		private:
+			struct free_block { free_block *next; };
+			free_block *free_lists[NCLASSES];
+			vector<std::unique_ptr<char[]> > chunks;
+			char *chunk_pos;
+			char *chunk_end;
+			size_t bytes_in_use;
+
+			static size_t size_class(size_t sz) { return (sz + GRANULE - 1) / GRANULE - 1; }
+			void *refill(size_t cls); // carve from the current chunk, or a new one
+		public:
+			payload_pool();
+			payload_pool(const payload_pool&) = delete;
+			payload_pool& operator=(const payload_pool&) = delete;
+
+			void *allocate(size_t sz)
+			{
+				size_t cls = size_class(sz);
+				if (cls >= NCLASSES) return ::operator new(sz);
+				bytes_in_use += (cls + 1) * GRANULE;
+				free_block *b = free_lists[cls];
+				if (!b) return refill(cls);
+				free_lists[cls] = b->next;
+				return b;
+			}
+			void deallocate(void *p, size_t sz)
+			{
+				size_t cls = size_class(sz);
+				if (cls >= NCLASSES) { ::operator delete(p); return; }
+				bytes_in_use -= (cls + 1) * GRANULE;
+				free_block *b = static_cast<free_block *>(p);
+				b->next = free_lists[cls];
+				free_lists[cls] = b;
+			}
+			size_t in_use() const { return bytes_in_use; }
+			size_t footprint() const { return chunks.size() * CHUNK_SIZE; }
+		};
+	}
+}
+
+#endif
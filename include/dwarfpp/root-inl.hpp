@@ -12,6 +12,8 @@
 #include <iostream>
 #include <utility>
 #include <set>
+#include <algorithm>
+#include <iterator>
 
 #include "root.hpp"
 #include "iter.hpp"
@@ -79,25 +81,92 @@ namespace dwarf
 				resolve_all(i, cur_plus_one, path_end, results, max);
 			};
 			
-			auto matching_cached = visible_named_grandchildren_cache.equal_range(*path_pos);
-			for (auto i_cached = matching_cached.first;
-				i_cached != matching_cached.second; 
+			/* Other threads may be filling the cache, so take a copy of
+			 * what we need from it. */
+			std::vector<Dwarf_Off> matching_cached;
+			bool cache_was_complete;
+			const cu_name_filters *filters;
+			std::vector<Dwarf_Off> edited_cus;
+			{
+				guard g(*this);
+				/* With a name index, the file's DIEs come from that, in file
+				 * order, and the cache is only needed for in-memory ones. */
+				if (p_names)
+				{
+					std::vector<name_index::ordinal> matching_indexed;
+					p_names->find(string_view(*path_pos), matching_indexed);
+					for (auto i_o = matching_indexed.begin(); i_o != matching_indexed.end(); ++i_o)
+					{
+						matching_cached.push_back(p_topology->offset(*i_o));
+					}
+				}
+				/* Else the producer's tables may know some. */
+				else if (name_accelerators())
+				{
+					p_accelerators->find(string_view(*path_pos), matching_cached);
+				}
+				auto matching = visible_named_grandchildren_cache.equal_range(*path_pos);
+				for (auto i_cached = matching.first; i_cached != matching.second; ++i_cached)
+				{
+					if (p_names && p_topology->ordinal_of(i_cached->second) != topology_index::NONE)
+					{
+						continue;
+					}
+					matching_cached.push_back(i_cached->second);
+				}
+				/* The producer's tables never make us complete, since they
+				 * leave out declarations. They can only end the search by
+				 * finding enough above. */
+				cache_was_complete = p_names || visible_named_grandchildren_is_complete;
+				filters = p_name_filters.get();
+				if (filters) edited_cus = cus_edited_in_memory;
+			}
+			for (auto i_cached = matching_cached.begin();
+				i_cached != matching_cached.end(); 
 				++i_cached)
 			{
-				hit_in_cache.insert(i_cached->second);
-				recurse(pos(i_cached->second, 2));
+				/* The accelerators and the cache may both have it. */
+				if (!hit_in_cache.insert(*i_cached).second) continue;
+				recurse(pos(*i_cached, 2));
 				if (max != 0 && results.size() >= max) return;
 			}
 
 			/* Now we have to be exhaustive. But don't bother if we know that 
 			 * our cache is exhaustive. */
-			if (!visible_named_grandchildren_is_complete)
+			if (!cache_was_complete && filters)
+			{
+				/* We need only look in the CUs that may define the name.
+				 * This doesn't complete the cache, of course. */
+				std::vector<Dwarf_Off> cus;
+				/* The filters don't know what's been edited in memory. */
+				filters->candidate_cus(string_view(*path_pos), cus);
+				std::vector<Dwarf_Off> unfiltered;
+				std::set_union(cus.begin(), cus.end(), edited_cus.begin(), edited_cus.end(),
+					std::back_inserter(unfiltered));
+				cus.swap(unfiltered);
+				for (auto i_cu = cus.begin(); i_cu != cus.end(); ++i_cu)
+				{
+					auto children = cu_pos(*i_cu).children_here();
+					for (auto i_c = std::move(children.first); i_c != children.second; ++i_c)
+					{
+						string_view name = i_c.name_view_here();
+						if (!name.data() || name != *path_pos) continue;
+						if (i_c.has_attr_here(DW_AT_visibility)
+							&& i_c.attr(DW_AT_visibility).get_unsigned() == DW_VIS_local) continue;
+						if (hit_in_cache.find(i_c.offset_here()) != hit_in_cache.end()) continue;
+						recurse(i_c);
+						if (max != 0 && results.size() >= max) return;
+					}
+				}
+			}
+			else if (!cache_was_complete)
 			{
 				auto vg_seq = visible_named_grandchildren();
 				for (auto i_g = std::move(vg_seq.first); i_g != vg_seq.second; ++i_g)
 				{
 					// skip any with the wrong name.
-					if (!i_g.name_here() || *i_g.name_here() != *path_pos) continue;
+					string_view name = i_g.name_view_here();
+					if (!name.data() || name != *path_pos) continue;
 					
 					/* skip any we saw before.  */
 					if (hit_in_cache.find(i_g.offset_here()) != hit_in_cache.end()) continue;
@@ -126,10 +195,60 @@ namespace dwarf
 			else return iterator_base::END;
 		}
 
+		inline iterator_base 
+		root_die::scoped_resolve(const iterator_base& start, const std::string& name)
+		{
+			std::vector<string> path; path.push_back(name);
+			return scoped_resolve(start, path.begin(), path.end());
+		}
+
 		template <typename Iter>
 		inline void
 		root_die::scoped_resolve_all(const iterator_base& start, Iter path_pos, Iter path_end, 
 			std::vector<iterator_base >& results, unsigned max /*= 0*/) 
+		{
+			if (max != 0 && results.size() >= max) return;
+			{
+				guard g(*this);
+				if (!policy.memoize_scoped_resolve)
+				{
+					scoped_resolve_all_uncached(start, path_pos, path_end, results, max);
+					return;
+				}
+			}
+			unsigned wanted = (max == 0) ? 0 : max - results.size();
+			string path;
+			for (Iter i_p = path_pos; i_p != path_end; ++i_p) { path += *i_p; path.push_back('\0'); }
+			auto k = std::make_tuple(start.offset_here(), wanted, std::move(path));
+			vector<pair<Dwarf_Off, unsigned short> > memo;
+			bool memoized;
+			{
+				guard g(*this);
+				auto found = scoped_resolve_cache.find(k);
+				memoized = (found != scoped_resolve_cache.end());
+				if (memoized) memo = found->second;
+			}
+			if (!memoized)
+			{
+				std::vector<iterator_base> found;
+				scoped_resolve_all_uncached(start, path_pos, path_end, found, wanted);
+				for (auto i_f = found.begin(); i_f != found.end(); ++i_f)
+				{
+					memo.push_back(make_pair(i_f->offset_here(), (unsigned short) i_f->depth()));
+				}
+				guard g(*this);
+				scoped_resolve_cache.insert(make_pair(std::move(k), memo));
+			}
+			for (auto i_m = memo.begin(); i_m != memo.end(); ++i_m)
+			{
+				results.push_back(pos(i_m->first, i_m->second));
+			}
+		}
+
+		template <typename Iter>
+		inline void
+		root_die::scoped_resolve_all_uncached(const iterator_base& start, Iter path_pos, Iter path_end,
+			std::vector<iterator_base >& results, unsigned max)
 		{
 			if (max != 0 && results.size() >= max) return;
 			auto found_from_here = resolve(start, path_pos, path_end);
@@ -153,7 +272,7 @@ namespace dwarf
 			} while (!p_encl.is_a<with_named_children_die>());
 
 			// successfully moved to an encloser; tail-call to continue resolving
-			scoped_resolve_all(p_encl, path_pos, path_end, results, max);
+			scoped_resolve_all_uncached(p_encl, path_pos, path_end, results, max);
 			// by definition, we're finished
 		}
 		template <typename Iter/* = iterator_df<compile_unit_die>*/ >
@@ -238,16 +357,18 @@ namespace dwarf
 		{
 			if (opt_depth && *opt_depth == 0) { assert(off == 0UL); assert(!referencer); return Iter(begin()); }
 			
+			guard g(*this);
 			// always check the live set first
 			auto found = live_dies.find(off);
 			if (found != live_dies.end())
 			{
 				// it's there, so use find_upwards to get the iterator
-				return iterator_base(*found->second);
+				note_used(found->second, false);
+				return iterator_base(*found->second, opt_depth);
 			}
 			
 			Die h(*this, off);
-			assert(h.handle.get());
+			assert(h.handle);
 			iterator_base base(std::move(h), opt_depth, *this);
 			
 			if (opt_depth && *opt_depth == 1) parent_of[off] = 0UL;
@@ -312,6 +433,30 @@ namespace dwarf
 			opt<pair<Dwarf_Off, Dwarf_Half> > referencer /* = opt<pair<Dwarf_Off, Dwarf_Half> >() */,
 			root_die::ptr_type maybe_ptr /* = root_die::ptr_type(nullptr) */)
 		{
+			guard g(*this);
+			/* If an index can tell us the depth, we can go straight there.
+			 * The topology index knows it already; the native decoder can
+			 * work it out (and the parent) from the nearest checkpoint. */
+			opt<unsigned short> known_depth;
+			auto o = p_topology ? p_topology->ordinal_of(off) : topology_index::NONE;
+			native::location loc;
+			if (o != topology_index::NONE) known_depth = p_topology->depth(o);
+			else if (p_native && p_native->locate(off, loc))
+			{
+				known_depth = loc.depth;
+				parent_of[off] = loc.parent;
+			}
+			if (known_depth)
+			{
+				Iter found = maybe_ptr ? Iter(iterator_base(*maybe_ptr, known_depth))
+					: pos<Iter>(off, known_depth);
+				if (referencer)
+				{
+					refers_to[*referencer] = off;
+					referred_from.insert(make_pair(off, *referencer));
+				}
+				return found;
+			}
 			Iter found_up = find_upwards(off, maybe_ptr);
 			if (found_up != iterator_base::END)
 			{
@@ -356,74 +501,41 @@ namespace dwarf
 			// debug(2) << "Beginning search at 0x" << std::hex << pos.offset_here() << std::dec << endl;
 			while (pos != iterator_base::END && pos.offset_here() != off)
 			{
-				/* What's next in the breadth-first order? */
-				assert(((void)pos.offset_here(), true));
-				// debug(2) << "Began loop body; pos is 0x" 
-				// 	<< std::hex << pos.offset_here() << std::dec;
-				iterator_bf<typename Iter::DerefType> next_pos = pos; 
-				assert(((void)pos.offset_here(), true));
-				next_pos.increment();
-				assert(((void)pos.offset_here(), true));
-				// debug(2) << ", next_pos is ";
-				// if (next_pos != iterator_base::END) {
-				// 	debug(2) << std::hex << next_pos.offset_here() << std::dec;
-				//} else debug(2) << "(END)";
-				// debug(2) << endl;
-				 
-				/* Does the move pos->next_pos skip over (enqueue) a subtree? 
-				 * If so, the depth will stay the same. 
-				 * If no, it's because we took a previously enqueued (deeper, but earlier) 
-				 * node out of the queue (i.e. descended instead of skipped-over). */
-				if (next_pos != iterator_base::END && next_pos.depth() == pos.depth())
+				/* Does pos have a next sibling? If so, the offsets between the
+				 * two are exactly pos's subtree. We don't copy pos to find out;
+				 * that would copy its queue too. */
+				iterator_base next_sib = next_sibling(pos);
+				if (next_sib != iterator_base::END)
 				{
-					// debug(2) << "next_pos is at same depth..." << endl;
-					// if I understand correctly....
-					assert(next_pos.offset_here() > pos.offset_here());
+					assert(next_sib.offset_here() > pos.offset_here());
 					
 					/* Might that subtree contain off? */
-					if (off < next_pos.offset_here() && off > pos.offset_here())
+					if (off < next_sib.offset_here() && off > pos.offset_here())
 					{
-						// debug(2) << "We think that target is in subtree ..." << endl;
-						/* Yes. We want that subtree. 
-						 * We don't want to move_to_first_child, 
-						 * because that will put the bfs traversal in a weird state
-						 * (s.t. next_pos might take us *upwards* not just across/down). 
-						 * But we don't want to increment through everything, 
-						 * because that will be slow. 
-						 * Instead, 
-						 * - create a new bf iterator at pos (with empty queue); 
-						 * - increment it once normally, so that the subtree is enqueued; 
-						 * - continue the loop. */
-						iterator_bf<typename Iter::DerefType> new_pos 
-						 = static_cast<iterator_base>(pos); 
-						new_pos.increment();
-						if (new_pos != iterator_base::END) {
-							//  previously I had the following slow code: 
-							// //do { pos.increment(); } while (pos.offset_here() > off); 
-							pos = new_pos;
-							// debug(2) << "Fast-forwarded pos to " 
-							// 	<< std::hex << pos.offset_here() << std::dec << std::endl;
-							continue;
-						} 
-						else 
+						/* Yes. We want that subtree, and nothing else that is
+						 * queued, so start afresh (with an empty queue) at
+						 * pos's first child. */
+						iterator_base first = first_child(pos);
+						if (first == iterator_base::END)
 						{
 							// subtree is empty -- we have failed
 							pos = iterator_base::END;
 							continue;
 						}
-						
+						pos = std::move(first);
+						continue;
 					}
-					else // off >= next_pos.offset_here() || off <= pos.offset_here()
+					else // off >= next_sib.offset_here() || off <= pos.offset_here()
 					{
-						// debug(2) << "Subtree between pos and next_pos cannot possibly contain target..." << endl;
-						/* We can't possibly want that subtree. */
-						pos.increment_skipping_subtree();
+						/* We can't possibly want that subtree. Skipping it is
+						 * just moving to the sibling we already have. */
+						pos.base_reference() = std::move(next_sib);
 						continue;
 					}
 				}
 				else 
 				{ 
-					// next is END, or is at a different (lower) depth than pos
+					// no sibling to bound the subtree, so carry on breadth-first
 					pos.increment(); 
 					continue; 
 				}
@@ -465,6 +577,89 @@ namespace dwarf
 		{
 			return std::make_pair(begin(), end());
 		}
+
+		template <typename Payload>
+		inline dwarf::core::sequence<iterator_tagged<Payload> > root_die::all_of()
+		{
+			return make_pair(iterator_tagged<Payload>(*this, tag_postings(), false),
+				iterator_tagged<Payload>(iterator_base::END));
+		}
+
+		/* Call visit(i) on each DIE of the CU's subtree, in depth-first order. */
+		template <typename Visit>
+		inline void for_each_in_cu(const iterator_base& cu, Visit visit)
+		{
+			unsigned short cu_depth = cu.depth();
+			iterator_df<> i = cu;
+			do
+			{
+				visit(i);
+				i.increment();
+			} while (i != iterator_base::END && i.depth() > cu_depth);
+		}
+
+		template <typename Fn>
+		inline void root_die::parallel_for_each_cu(Fn fn, unsigned nthreads /* = 0 */)
+		{
+			for_each_cu_in_workers([&fn](unsigned, const iterator_base& cu) {
+				fn(iterator_df<compile_unit_die>(cu));
+			}, nthreads);
+		}
+
+		template <typename Payload /* = basic_die */, typename Pred, typename Fn>
+		inline void root_die::parallel_for_each(Pred pred, Fn fn, unsigned nthreads /* = 0 */)
+		{
+			for_each_cu_in_workers([&pred, &fn](unsigned, const iterator_base& cu) {
+				for_each_in_cu(cu, [&pred, &fn](const iterator_df<>& i) {
+					if (!i.is_a<Payload>()) return;
+					iterator_df<Payload> i_p = i;
+					if (pred(i_p)) fn(i_p);
+				});
+			}, nthreads);
+		}
+
+		template <typename T, typename Map, typename Reduce>
+		inline T root_die::parallel_transform_reduce_cu(T init, Map map, Reduce reduce,
+			unsigned nthreads /* = 0 */)
+		{
+			/* Results arrive in any order, once per CU, so a lock is cheap.
+			 * They needn't be Ts, as long as reduce can fold them into one. */
+			typedef decltype(map(std::declval<iterator_df<compile_unit_die> >())) result_type;
+			std::map<unsigned, result_type> per_cu;
+			std::mutex per_cu_lock;
+			for_each_cu_in_workers([&map, &per_cu, &per_cu_lock](unsigned idx, const iterator_base& cu) {
+				result_type result = map(iterator_df<compile_unit_die>(cu));
+				std::lock_guard<std::mutex> l(per_cu_lock);
+				per_cu.insert(std::make_pair(idx, std::move(result)));
+			}, nthreads);
+			for (auto i_r = per_cu.begin(); i_r != per_cu.end(); ++i_r)
+			{
+				init = reduce(std::move(init), std::move(i_r->second));
+			}
+			return init;
+		}
+
+		template <typename Payload /* = basic_die */, typename T, typename Pred, typename Map, typename Reduce>
+		inline T root_die::parallel_transform_reduce(T init, Pred pred, Map map, Reduce reduce,
+			unsigned nthreads /* = 0 */)
+		{
+			/* Reduce within each CU in its worker, then across CUs in order. */
+			return parallel_transform_reduce_cu(std::move(init),
+				[&pred, &map, &reduce](const iterator_df<compile_unit_die>& cu) {
+					opt<T> acc;
+					for_each_in_cu(cu, [&pred, &map, &reduce, &acc](const iterator_df<>& i) {
+						if (!i.is_a<Payload>()) return;
+						iterator_df<Payload> i_p = i;
+						if (!pred(i_p)) return;
+						if (acc) acc = reduce(std::move(*acc), map(i_p));
+						else acc = map(i_p);
+					});
+					return acc;
+				},
+				[&reduce](T so_far, opt<T> cu_result) {
+					return cu_result ? reduce(std::move(so_far), std::move(*cu_result)) : so_far;
+				}, nthreads);
+		}
 	}
 }
 
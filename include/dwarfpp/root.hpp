@@ -14,7 +14,12 @@
 #include <map>
 #include <set>
 #include <list>
+#include <tuple>
 #include <unordered_map>
+#include <unordered_set>
+#include <mutex>
+#include <atomic>
+#include <functional>
 #include <boost/intrusive_ptr.hpp>
 #include <srk31/selective_iterator.hpp>
 #include <srk31/transform_iterator.hpp>
@@ -25,6 +30,10 @@
 #include "abstract.hpp"
 #include "libdwarf.hpp"
 #include "libdwarf-handles.hpp"
+#include "native.hpp"
+#include "topology.hpp"
+#include "name-index.hpp"
+#include "pool.hpp"
 
 namespace dwarf
 {
@@ -39,6 +48,7 @@ namespace dwarf
 	using std::dynamic_pointer_cast;
 	using boost::intrusive_ptr;
 	
+	namespace encap { struct compiled_loclist; } // see expr.hpp
 	namespace core
 	{
 		struct FrameSection;
@@ -48,7 +58,71 @@ namespace dwarf
 		template <typename DerefAs /* = basic_die*/> struct iterator_df; // see attr.hpp
 		template <typename DerefAs = basic_die> struct iterator_bf;
 		template <typename DerefAs = basic_die> struct iterator_sibs;
+		template <typename DerefAs = basic_die> struct iterator_tagged;
 		struct type_iterator_df;
+		
+		/* Which tags make which payload classes. This comes from the spec
+		 * (see spec/gen-tagpreds-cpp.py), so is_a and downcasts needn't
+		 * consult a dummy payload or use dynamic_cast. Each payload class
+		 * gets a number, and payload_class_traits says which tags make
+		 * one. Classes not in the spec (e.g. client-defined) aren't
+		 * "known", and fall back on RTTI if we have it. */
+#if defined(__GXX_RTTI) || defined(_CPPRTTI)
+#define DWARFPP_HAVE_RTTI 1
+#else
+#define DWARFPP_HAVE_RTTI 0
+#endif
+		enum payload_class
+		{
+			payload_class_basic,
+#define begin_pred(name) payload_class_ ## name,
+#define disjunct(tag)
+#define end_pred(name)
+#include "dwarf-current-tagpreds.h"
+#undef begin_pred
+#undef disjunct
+#undef end_pred
+			payload_class_count
+		};
+		template <typename Payload>
+		struct payload_class_traits
+		{
+			static const bool known = false;
+		};
+		template <>
+		struct payload_class_traits<basic_die>
+		{
+			static const bool known = true;
+			static const payload_class id = payload_class_basic;
+			static bool has_tag(Dwarf_Half tag) { return true; }
+		};
+#define begin_pred(name) \
+		struct name ## _die; \
+		template <> \
+		struct payload_class_traits<name ## _die> \
+		{ \
+			static const bool known = true; \
+			static const payload_class id = payload_class_ ## name; \
+			static bool has_tag(Dwarf_Half tag) \
+			{ \
+				switch (tag) \
+				{
+#define disjunct(tag) \
+					case DW_TAG_ ## tag:
+#define end_pred(name) \
+						return true; \
+					default: return false; \
+				} \
+			} \
+		};
+#include "dwarf-current-tagpreds.h"
+#undef begin_pred
+#undef disjunct
+#undef end_pred
+
+		template <typename Payload>
+		inline Payload& payload_cast(basic_die& d); // defined below
+
 		// children
 		// so how do we iterate over "children satisfying predicate, derefAs'd X"? 
 		template <typename Payload>
@@ -125,11 +199,11 @@ namespace dwarf
 		{
 			typedef srk31::selective_iterator< is_a_t<Payload>, Iter> filtered_iterator;
 
-			// transformer is just dynamic_cast, wrapped as a function
+			// transformer is just a downcast, wrapped as a function
 			struct transformer : std::function<Payload&(basic_die&)>
 			{
 				transformer() : std::function<Payload&(basic_die&)>([](basic_die& arg) -> Payload& {
-					return dynamic_cast<Payload&>(arg);
+					return payload_cast<Payload>(arg);
 				}) {}
 			};
 			typedef srk31::transform_iterator<transformer, filtered_iterator >
@@ -209,8 +283,8 @@ namespace dwarf
 			friend class root_die;
 			friend class Die; // FIXME: define handle_with_nav instead
 		protected:
-			// we need to embed a refcount
-			unsigned refcount;
+			// we need to embed a refcount -- atomic, in case our root is concurrent
+			std::atomic<unsigned> refcount;
 			
 			// we need this, if we're libdwarf-backed; if not, it's null
 			Die d;
@@ -228,6 +302,7 @@ namespace dwarf
 			/* We define an overridable *interface* for attribute access. */
 			// helper
 			static void left_merge_attrs(encap::attribute_map& m, const encap::attribute_map& arg);
+			static void left_merge_attrs(encap::attribute_map& m, encap::attribute_map&& arg);
 			virtual bool has_attr(Dwarf_Half attr) const 
 			{ assert(d.handle); return d.has_attr_here(attr); }
 			// get all attrs in one go
@@ -245,6 +320,36 @@ namespace dwarf
 			}
 			inline iterator_base find_self() const;
 			inline bool is_dummy() const;
+			/* The fast path for the generated get_*() and find_*() accessors
+			 * (see dies.hpp): one attribute straight from the section bytes,
+			 * with no Attribute and no attribute_value. These return false
+			 * if they can't help -- no native image, an in-memory DIE, or a
+			 * form they don't understand -- so the caller goes the slow way.
+			 * Otherwise "out" is empty iff we haven't got the attribute. */
+			bool fetch_raw_attr(Dwarf_Half a, native::raw_attr& out) const;
+			bool raw_get_string(Dwarf_Half a, opt<std::string>& out) const;
+			bool raw_get_flag(Dwarf_Half a, opt<bool>& out) const;
+			bool raw_get_unsigned(Dwarf_Half a, opt<Dwarf_Unsigned>& out) const;
+			bool raw_get_signed(Dwarf_Half a, opt<Dwarf_Signed>& out) const;
+			bool raw_get_address(Dwarf_Half a, opt<encap::attribute_value::address>& out) const;
+			bool raw_get_refiter(Dwarf_Half a, opt<iterator_df<basic_die> >& out) const;
+			bool raw_get_refiter_is_type(Dwarf_Half a, opt<iterator_df<type_die> >& out) const;
+			// the rest always go the slow way
+			bool raw_get_offset(Dwarf_Half a, opt<Dwarf_Off>& out) const { return false; }
+			bool raw_get_half(Dwarf_Half a, opt<Dwarf_Half>& out) const { return false; }
+			bool raw_get_ref(Dwarf_Half a, opt<Dwarf_Off>& out) const { return false; }
+			bool raw_get_tag(Dwarf_Half a, opt<Dwarf_Half>& out) const { return false; }
+			bool raw_get_loclist(Dwarf_Half a, opt<encap::loclist>& out) const { return false; }
+			bool raw_get_rangelist(Dwarf_Half a, opt<encap::rangelist>& out) const { return false; }
+		public:
+			/* The same object as a pointer to the given payload class, or
+			 * null if it isn't one. Virtual bases mean we can't static_cast
+			 * down to the class we want, but the most-derived class can
+			 * always cast up to it; the generated classes override this
+			 * (see cast_self_to()). Use payload_cast<>() rather than this. */
+			virtual void *cast_to(payload_class c)
+			{ return (c == payload_class_basic) ? this : nullptr; }
+		protected:
 			
 			// protected constructor constructing dummy instances
 			basic_die(spec& s); 
@@ -276,6 +381,10 @@ namespace dwarf
 			}
 			inline unique_ptr<const char, string_deleter> get_raw_name() const
 			{ assert(d.handle); return d.name_here(); }
+			inline string_view get_name_view() const
+			{ assert(d.handle); return d.get_name_view(); }
+			inline block_view get_block_view(Dwarf_Half attr) const
+			{ assert(d.handle); return d.get_block_view(attr); }
 			inline Dwarf_Off get_enclosing_cu_offset() const 
 			{ assert(d.handle); return d.enclosing_cu_offset_here(); }
 			/* The same as all_attrs, but comes from abstract_die. 
@@ -283,7 +392,7 @@ namespace dwarf
 			 * this function does the work and all_attrs delegates to it. */
 			inline encap::attribute_map copy_attrs() const
 			{
-				return encap::attribute_map(AttributeList(d), d, get_root());
+				return d.copy_attrs();
 			}
 			inline spec& get_spec(root_die& r) const 
 			{ assert(d.handle); return d.spec_here(); }
@@ -305,17 +414,24 @@ namespace dwarf
 			
 			void print(std::ostream& s) const;
 			void print_with_attrs(std::ostream& s) const;
+			
+			/* Payloads made from the file come from their root's pool; see
+			 * pool.hpp. Others (in-memory DIEs) come from the heap. */
+			static void *operator new(size_t sz);
+			static void *operator new(size_t sz, root_die& r);
+			static void operator delete(void *p);
+			static void operator delete(void *p, root_die& r); // if a constructor throws
+			
+			/* Roughly how much memory we take up; for cache accounting.
+			 * Every payload class overrides this (see begin_class()). */
+			virtual size_t payload_size() const { return sizeof (basic_die); }
 		};	
 		std::ostream& operator<<(std::ostream& s, const basic_die& d);
 		inline void intrusive_ptr_add_ref(basic_die *p)
 		{
-			++(p->refcount);
-		}
-		inline void intrusive_ptr_release(basic_die *p)
-		{
-			--(p->refcount);
-			if (p->refcount == 0) delete p;
+			p->refcount.fetch_add(1, std::memory_order_relaxed);
 		}
+		inline void intrusive_ptr_release(basic_die *p);
 		
 		struct is_visible_and_named;
 		struct grandchild_die_at_offset;
@@ -353,8 +469,49 @@ namespace dwarf
 			
 		protected:
 			typedef intrusive_ptr<basic_die> ptr_type;
+			
+			/* In concurrent mode (see set_concurrent()), everything that touches
+			 * our caches or calls into libdwarf holds this lock. It is recursive
+			 * because those things call each other. It comes first so that it
+			 * outlives the sticky set and the handles it holds. */
+			bool concurrent;
+			mutable std::recursive_mutex concurrent_lock;
+		public:
+			/* Holds the lock for a scope, if we're concurrent; else does nothing. */
+			struct guard
+			{
+				std::recursive_mutex *p_m;
+				explicit guard(const root_die& r)
+				 : p_m(r.concurrent ? &r.concurrent_lock : nullptr)
+				{ if (p_m) p_m->lock(); }
+				~guard() { if (p_m) p_m->unlock(); }
+				guard(const guard&) = delete;
+				guard& operator=(const guard&) = delete;
+			};
+		protected:
+			/* Payloads are allocated from here. It must outlive them all, so
+			 * it comes before the sticky set and anything else holding them. */
+			payload_pool pool;
+			int fd; // -1 if we have no file
 			Debug dbg;
 			
+			/* The native decoder's view of the same file. Null unless we were
+			 * built with it and it could handle the file; see native.hpp. */
+			std::unique_ptr<native::image> p_native;
+			
+			/* Null unless the client asked for it; see build_topology_index(). */
+			std::unique_ptr<topology_index> p_topology;
+			/* Likewise; see build_name_index(). */
+			std::unique_ptr<name_index> p_names;
+			/* Likewise; see find_by_linkage_name(). */
+			std::unique_ptr<linkage_name_index> p_linkage_names;
+			/* Likewise; see build_name_filters(). */
+			std::unique_ptr<cu_name_filters> p_name_filters;
+			/* Likewise; see find_visible_grandchildren_with_prefix(). */
+			std::unique_ptr<sorted_name_table> p_sorted_names;
+			/* Made the first time we're asked for a name; see name_accelerators(). */
+			std::unique_ptr<accelerator_tables> p_accelerators;
+			
 			/* live DIEs -- any basic DIE that is instantiated registers itself here,
 			 * and deregisters itself when it is destructed.
 			 * This must be destructed *after* the sticky set, i.e. declared before it,
@@ -367,10 +524,65 @@ namespace dwarf
 			 * will be invalid if we destruct the latter first, and bad results follow. */
 			map<Dwarf_Off, ptr_type > sticky_dies; // compile_unit_die is always sticky
 			
+		public:
+			/* What we keep in memory. By default, CU payloads are sticky
+			 * (kept for our lifetime), other payloads last only as long as
+			 * some iterator points at them, and caches grow without limit.
+			 * Setting max_bytes makes us keep recently used payloads alive
+			 * up to that budget (counting the navigation caches too), and
+			 * evict the least recently used ones beyond it. Sticky payloads
+			 * don't count, so a service touching many binaries might want
+			 * no sticky tags at all. DIEs created in memory are always
+			 * sticky, since we couldn't recreate them. Setting
+			 * memoize_effective_attrs makes us remember find_all_attrs() for
+			 * DIEs with an abstract origin or specification, or that are
+			 * declarations, and answer find_attr() on them from that.
+			 * Setting memoize_scoped_resolve makes us remember what each
+			 * scoped_resolve() found, or that it found nothing, by start
+			 * and path. Both memos are forgotten on any in-memory edit. */
+			struct cache_policy
+			{
+				std::set<Dwarf_Half> sticky_tags;
+				size_t max_bytes; // 0 means no limit (and no keeping)
+				bool memoize_effective_attrs;
+				bool memoize_scoped_resolve;
+				cache_policy() : sticky_tags({ DW_TAG_compile_unit }), max_bytes(0),
+					memoize_effective_attrs(false), memoize_scoped_resolve(false) {}
+			};
+			/* All byte counts are estimates. */
+			struct cache_footprint
+			{
+				size_t live_payloads;
+				size_t sticky_payloads;
+				size_t retained_payloads; // kept alive by the policy
+				size_t payload_bytes;     // for all live payloads
+				size_t cache_entries;     // in the offset-keyed caches
+				size_t cache_bytes;
+				size_t index_bytes;       // topology and name indexes
+				size_t pool_bytes;        // chunks held by the payload pool (holding payload_bytes)
+				size_t total_bytes() const { return payload_bytes + cache_bytes + index_bytes; }
+			};
+		protected:
+			cache_policy policy;
+			vector<bool> sticky_tag_bits; // from policy.sticky_tags
+			/* Recently used non-sticky payloads, most recent first. Only used
+			 * if policy.max_bytes is set. This must come after the sticky set,
+			 * for the same reasons. */
+			typedef list<pair<ptr_type, size_t> > recently_used_list;
+			recently_used_list recently_used;
+			unordered_map<Dwarf_Off, recently_used_list::iterator> recently_used_pos;
+			size_t recently_used_bytes;
+			void note_used(basic_die *p, bool is_new);
+			size_t navigation_cache_bytes() const;
+			void evict_navigation_caches();
+			void enforce_cache_policy();
+			
 			/* Each of these caches also has an in-payload equivalent, in basic_die. */
 			unordered_map<Dwarf_Off, Dwarf_Off> parent_of;
 			unordered_map<Dwarf_Off, Dwarf_Off> first_child_of;
 			unordered_map<Dwarf_Off, Dwarf_Off> next_sibling_of;
+			/* Look up parent_of, asking the native decoder if it's not there. */
+			unordered_map<Dwarf_Off, Dwarf_Off>::iterator cached_parent_of(Dwarf_Off off);
 			
 			map<pair<Dwarf_Off, Dwarf_Half>, Dwarf_Off> refers_to;
 			multimap<Dwarf_Off, pair<Dwarf_Off, Dwarf_Half> > referred_from;
@@ -387,9 +599,31 @@ namespace dwarf
 			{ return equivalence_class_of; }
 		protected:
 			map<Dwarf_Off, opt<uint32_t> > type_summary_code_cache;
+			/* Own attributes left-merged with those of origins, by offset;
+			 * see cache_policy::memoize_effective_attrs. */
+			unordered_map<Dwarf_Off, encap::attribute_map> effective_attrs_cache;
+			/* Compiled loclists, by DIE and attribute; see compiled_loclist_for(). */
+			map<pair<Dwarf_Off, Dwarf_Half>, std::shared_ptr<const encap::compiled_loclist> >
+				compiled_loclists;
+			/* See cache_policy::memoize_scoped_resolve. Keyed by the start's
+			 * offset, the most results wanted (0 for all) and the path, its
+			 * components joined by NULs; we keep each result's offset and
+			 * depth (maybe none). */
+			map<std::tuple<Dwarf_Off, unsigned, string>, vector<pair<Dwarf_Off, unsigned short> > >
+				scoped_resolve_cache;
+			/* For find_named_child(): one child_name_index per CU, by the
+			 * CU's offset, covering the parents we've been asked about. */
+			unordered_map<Dwarf_Off, child_name_index> child_names;
+			/* In-memory DIEs call this when edited, with their CU's offset. */
+			void note_in_memory_edit(Dwarf_Off cu_off);
+			/* The CUs in which that has happened, sorted. Names may be
+			 * defined there that the name filters don't know about, so
+			 * searches they prune must visit these CUs too. */
+			vector<Dwarf_Off> cus_edited_in_memory;
 			opt<Dwarf_Off> synthetic_cu; // new DIEs added by clients get put in this 'fake' CU
 
 			multimap<string, Dwarf_Off> visible_named_grandchildren_cache;
+			std::unordered_set<string> interned_strings; // see intern_string()
 			bool visible_named_grandchildren_is_complete;
 			friend class in_memory_abstract_die::attribute_map;
 
@@ -415,8 +649,9 @@ namespace dwarf
 			virtual Dwarf_Off fresh_offset_under(const iterator_base& pos);
 		
 		public:
-			root_die() : dbg(), visible_named_grandchildren_is_complete(false), p_fs(nullptr),
-				current_cu_offset(0), returned_elf(nullptr) {}
+			root_die() : concurrent(false), fd(-1), dbg(), recently_used_bytes(0),
+				visible_named_grandchildren_is_complete(false), p_fs(nullptr),
+				current_cu_offset(0), returned_elf(nullptr) { set_cache_policy(cache_policy()); }
 			root_die(int fd);
 			virtual ~root_die();
 		
@@ -521,6 +756,143 @@ namespace dwarf
 		public:
 			::Elf *get_elf(); // hmm: lib-only?
 			Debug& get_dbg() { return dbg; }
+			const native::image *get_native_image() const { return p_native.get(); }
+			/* Keep a copy of a string, e.g. a name libdwarf gave us that we
+			 * must free, so that we can give out string_views of it. Each
+			 * distinct string is kept once. The copies last until
+			 * evict_caches(), or for as long as we live if an index built
+			 * through libdwarf (by build_name_index() and the like, without
+			 * the native decoder) refers to them. */
+			string_view intern_string(const char *s);
+			
+			/* Walk the whole tree once and build a topology_index. Afterwards,
+			 * parent/child/sibling moves and depth queries among DIEs from
+			 * the file are answered from its arrays, and the hash-table caches
+			 * (parent_of etc.) are only used for DIEs created in memory.
+			 * With the native decoder, CUs can be indexed by nthreads threads
+			 * at once (0 means one per core). libdwarf can't be used from
+			 * several threads, so without it we always go sequentially. */
+			void build_topology_index(unsigned nthreads = 1);
+			const topology_index *get_topology_index() const { return p_topology.get(); }
+			/* The topology index, with its tag posting lists, building
+			 * either if need be. See iterator_tagged. */
+			const topology_index& tag_postings();
+			/* Build a name_index of the root's visible named grandchildren
+			 * (building the topology index first, if need be). Afterwards,
+			 * find_visible_grandchild_named() and the like are one hash
+			 * probe, even the first time, with no walk of the file. With
+			 * the native decoder, CUs are done on nthreads threads. */
+			void build_name_index(unsigned nthreads = 1);
+			const name_index *get_name_index() const { return p_names.get(); }
+			/* Likewise for a linkage_name_index, from symbol names to the
+			 * subprograms and variables that define them. */
+			void build_linkage_name_index(unsigned nthreads = 1);
+			const linkage_name_index *get_linkage_name_index() const { return p_linkage_names.get(); }
+			/* The DIEs defining the symbol called name, in offset order,
+			 * building the linkage name index first if need be. So going
+			 * from .symtab or a stack trace to DWARF is a hash probe per
+			 * symbol. DIEs created in memory aren't covered. */
+			std::vector<iterator_base> find_by_linkage_name(const string& name);
+			/* Build a Bloom filter per CU of the names it defines (see
+			 * cu_name_filters), building the topology index first if need
+			 * be. They're much smaller than the indexes above, and are
+			 * kept in the index cache. Afterwards, until there are in-memory
+			 * edits, root-anchored lookups that would walk every CU (and
+			 * find_by_linkage_name(), before its index is built) only visit
+			 * the CUs whose filter matches, so a miss is usually free. */
+			void build_name_filters(unsigned nthreads = 1);
+			const cu_name_filters *get_name_filters() const { return p_name_filters.get(); }
+			/* Build a sorted_name_table of the visible named grandchildren,
+			 * for find_visible_grandchildren_with_prefix() and
+			 * find_visible_grandchildren_matching(). */
+			void build_sorted_name_table(unsigned nthreads = 1);
+			const sorted_name_table *get_sorted_name_table() const { return p_sorted_names.get(); }
+			/* The producer's name tables, if the native decoder found any
+			 * (see accelerator_tables); null without the native decoder.
+			 * Until there's a name index, root-anchored lookups try these
+			 * first, so a lookup that wants only one match (as do
+			 * find_visible_grandchild_named() and scoped_resolve()) can
+			 * usually be answered without a walk. Asking for all matches
+			 * still needs the walk, since the tables omit declarations. */
+			const accelerator_tables *name_accelerators();
+			/* Every DIE in the file that is a Payload, in offset order,
+			 * without visiting the others. */
+			template <typename Payload>
+			inline dwarf::core::sequence<iterator_tagged<Payload> > all_of();
+			
+			/* Whole-file scans, split by CU over nthreads threads (0 means
+			 * one per core). libdwarf can't be shared between threads, so
+			 * each worker opens its own root_die on our file, with its own
+			 * libdwarf context, cursor and caches, and takes CUs one at a
+			 * time until there are none left. So the callbacks are given
+			 * iterators into the worker's root, not this one, and they run
+			 * concurrently: pass out offsets, not iterators, and lock any
+			 * shared state. The reducing versions combine per-CU results
+			 * in CU order, so the answer doesn't depend on scheduling as
+			 * long as "reduce" is associative. Only DIEs from the file are
+			 * visited. Without a file, or with one thread, we just scan
+			 * this root in the calling thread. */
+			template <typename Fn>
+			void parallel_for_each_cu(Fn fn, unsigned nthreads = 0);
+			template <typename Payload = basic_die, typename Pred, typename Fn>
+			void parallel_for_each(Pred pred, Fn fn, unsigned nthreads = 0);
+			template <typename T, typename Map, typename Reduce>
+			T parallel_transform_reduce_cu(T init, Map map, Reduce reduce, unsigned nthreads = 0);
+			template <typename Payload = basic_die, typename T, typename Pred, typename Map, typename Reduce>
+			T parallel_transform_reduce(T init, Pred pred, Map map, Reduce reduce, unsigned nthreads = 0);
+		protected:
+			/* The engine for the above: calls work(cu_index, cu) once per CU. */
+			void for_each_cu_in_workers(const std::function<void(unsigned, const iterator_base&)>& work,
+				unsigned nthreads);
+		public:
+			
+			/* A file that saves the topology index, the visible named
+			 * grandchildren and the refers_to cache, so that the next
+			 * root_die on the same binary can start warm. It is keyed by
+			 * build ID and section checksums, so it needs the native decoder.
+			 * The default path is under $DWARFPP_INDEX_CACHE_DIR, else
+			 * $XDG_CACHE_HOME/dwarfpp, else ~/.cache/dwarfpp. Loading should
+			 * happen before any DIEs are created in memory. These return
+			 * false (and leave us unchanged) if the cache can't be used. */
+			string default_index_cache_path() const;
+			bool load_index_cache(const string& path = string());
+			bool save_index_cache(const string& path = string());
+			/* Load, or else build everything and save. */
+			bool load_or_save_index_cache(const string& path = string());
+
+			/* Let many threads share us. Once concurrent, we may be iterated,
+			 * searched and have our types compared from any number of threads,
+			 * but not modified (no make_new()). Entering concurrent mode builds
+			 * the topology index, if we don't have one, so that navigation
+			 * mostly comes from its arrays. Not concurrent by default, since the
+			 * locking costs something even when there's no contention. */
+			void set_concurrent(bool c = true);
+			bool is_concurrent() const { return concurrent; }
+			
+			/* Changing the sticky tags only affects payloads made afterwards. */
+			void set_cache_policy(const cache_policy& p);
+			const cache_policy& get_cache_policy() const { return policy; }
+			cache_footprint get_cache_footprint() const;
+			/* Drop everything that we can recompute: kept payloads, navigation
+			 * caches, names, references and type equivalence classes. Unlike
+			 * the automatic eviction, this empties caches that code might be
+			 * in the middle of using, so only call it between queries. That
+			 * includes interned strings (see intern_string()), so names seen
+			 * through name_view_here() must not be kept past it. */
+			void evict_caches();
+			/* Fill the effective attributes memo in one walk, if the policy
+			 * has it. */
+			void build_effective_attrs_cache();
+			/* Forget all effective attributes. Editing in-memory DIEs (by
+			 * inserting or erasing their attrs()) or creating them does this,
+			 * since it can change what any chain of origins comes to. */
+			void invalidate_effective_attrs_cache();
+			/* The loclist (or single expression) of attribute attr of the DIE
+			 * at it, compiled for PC lookups (see expr.hpp) and kept until
+			 * evict_caches() or an in-memory edit. An empty list if it has no
+			 * such attribute. Keep the pointer if you'll want it again. */
+			std::shared_ptr<const encap::compiled_loclist>
+			compiled_loclist_for(const iterator_base& it, Dwarf_Half attr = DW_AT_location);
 
 			// iterator navigation primitives
 			// note: want to avoid virtual dispatch on these
@@ -530,6 +902,10 @@ namespace dwarf
 			iterator_base parent(const iterator_base& it);
 			iterator_base first_child(const iterator_base& it);
 			iterator_base next_sibling(const iterator_base& it);
+			/* Just the offset of the first child, or 0 if none. This is
+			 * cheaper than first_child() when the topology index or the
+			 * native decoder can answer, since we make no iterator. */
+			Dwarf_Off first_child_offset(const iterator_base& it);
 			/* 
 			 * NOTE: we *don't* put named_child and move_to_named_child here, because
 			 * we want to allow exploitation of in-payload data, which might support
@@ -539,11 +915,28 @@ namespace dwarf
 			 * into the iterator method.
 			 * BUT we do put a special find_named_child method, emphasising the linear
 			 * search (slow). This is the fallback implementation used by the iterator.
+			 * Under DIEs with named children (structs, namespaces, CUs...) the
+			 * first search hashes every child's name (see child_name_index),
+			 * so later ones under the same parent are a single probe.
 			 */
 			iterator_base find_named_child(const iterator_base& start, const string& name);
 			/* This one is only for searches anchored at the root, so no need for "start". */
 			iterator_base find_visible_grandchild_named(const string& name);
 			std::vector<iterator_base> find_all_visible_grandchildren_named(const string& name);
+			/* Those whose names start with prefix, or match a glob pattern
+			 * (see sorted_name_table::glob_match()), building the sorted
+			 * name table first if need be. DIEs from the file come first,
+			 * in offset order, then any made in memory that the cache knows.
+			 * The iterators are just positions, with no payloads made. */
+			std::vector<iterator_base> find_visible_grandchildren_with_prefix(const string& prefix);
+			std::vector<iterator_base> find_visible_grandchildren_matching(const string& pattern);
+		private:
+			/* For those two: positions for what the table found, then for
+			 * the cache's in-memory DIEs with the prefix (matching pattern,
+			 * if there is one). */
+			std::vector<iterator_base> sorted_name_results(const vector<topology_index::ordinal>& found,
+				const string& prefix, const string *pattern);
+		public:
 			
 			bool is_under(const iterator_base& i1, const iterator_base& i2);
 			
@@ -595,14 +988,82 @@ namespace dwarf
 			inline void
 			scoped_resolve_all(const iterator_base& start, Iter path_pos, Iter path_end, 
 				std::vector<iterator_base >& results, unsigned max = 0);
+			/* Many single names from one scope, each as if by scoped_resolve()
+			 * (END if not found), in one pass outwards: each enclosing scope
+			 * is visited once, and the root's grandchildren are walked at
+			 * most once for all the names left over. */
+			std::vector<iterator_base>
+			scoped_resolve_each(const iterator_base& start, const std::vector<string>& names);
+		protected:
+			/* scoped_resolve_all() without the memo. */
+			template <typename Iter>
+			inline void
+			scoped_resolve_all_uncached(const iterator_base& start, Iter path_pos, Iter path_end,
+				std::vector<iterator_base >& results, unsigned max);
+		public:
 			
 			void print_tree(iterator_base&& begin, std::ostream& s) const;
 		};	
 		std::ostream& operator<<(std::ostream& s, const root_die& d);
 
-		inline bool basic_die::is_dummy() const // dynamic_cast doesn't work til we're fully constructed
+		inline bool basic_die::is_dummy() const // as_in_memory() doesn't work til we're fully constructed
+		{
+			return !d.handle && !refcount && !as_in_memory();
+		}
+		
+		/* Downcasting payloads. For classes in the spec this is a virtual
+		 * call and no RTTI; otherwise it's dynamic_cast, if we have RTTI. */
+		template <typename Payload>
+		inline Payload *payload_cast_known(basic_die *p, std::true_type)
+		{ return static_cast<Payload *>(p->cast_to(payload_class_traits<Payload>::id)); }
+#if DWARFPP_HAVE_RTTI
+		template <typename Payload>
+		inline Payload *payload_cast_known(basic_die *p, std::false_type)
+		{ return dynamic_cast<Payload *>(p); }
+#endif
+		template <typename Payload>
+		inline Payload *payload_cast(basic_die *p)
 		{
-			return !d.handle && !refcount && !dynamic_cast<const in_memory_abstract_die *>(this);
+			if (!p) return nullptr;
+			return payload_cast_known<Payload>(p,
+				std::integral_constant<bool, payload_class_traits<Payload>::known>());
+		}
+		template <typename Payload>
+		inline const Payload *payload_cast(const basic_die *p)
+		{ return payload_cast<Payload>(const_cast<basic_die *>(p)); }
+		template <typename Payload>
+		inline Payload& payload_cast(basic_die& d)
+		{
+			Payload *p = payload_cast<Payload>(&d);
+			assert(p);
+			return *p;
+		}
+		/* The most-derived class can cast itself up to any payload class
+		 * that it is, by plain static_cast. The generated classes use this
+		 * to implement cast_to(). */
+		template <typename Target, typename Self>
+		inline void *upcast_if_base(Self *self, std::true_type)
+		{ return static_cast<Target *>(self); }
+		template <typename Target, typename Self>
+		inline void *upcast_if_base(Self *self, std::false_type)
+		{ return nullptr; }
+		template <typename Self>
+		inline void *cast_self_to(Self *self, payload_class c)
+		{
+			switch (c)
+			{
+				case payload_class_basic: return static_cast<basic_die *>(self);
+#define begin_pred(name) \
+				case payload_class_ ## name: \
+					return upcast_if_base<name ## _die>(self, std::is_base_of<name ## _die, Self>());
+#define disjunct(tag)
+#define end_pred(name)
+#include "dwarf-current-tagpreds.h"
+#undef begin_pred
+#undef disjunct
+#undef end_pred
+				default: return nullptr;
+			}
 		}		
 		inline basic_die::basic_die(spec& s, Die&& h)
 		 : refcount(0), d(std::move(h))
@@ -616,6 +1077,20 @@ namespace dwarf
 			if (!is_dummy()) get_root().live_dies.erase(get_offset());
 			debug(6) << "Destructed basic DIE object at " << this << std::endl;
 		}
+		inline void intrusive_ptr_release(basic_die *p)
+		{
+			/* Dropping a reference that isn't the last needs no lock. The last
+			 * one must be dropped under the root's lock: otherwise another
+			 * thread could find us in live_dies and take a reference while
+			 * we're being deleted. */
+			unsigned r = p->refcount.load(std::memory_order_relaxed);
+			while (r > 1)
+			{
+				if (p->refcount.compare_exchange_weak(r, r - 1, std::memory_order_acq_rel)) return;
+			}
+			root_die::guard g(p->get_root());
+			if (p->refcount.fetch_sub(1, std::memory_order_acq_rel) == 1) delete p;
+		}
 		
 		struct in_memory_root_die : public root_die
 		{
@@ -0,0 +1,160 @@
+/* dwarfpp: C++ binding for a useful subset of libdwarf, plus extra goodies.
+ *
+ * topology.hpp: a dense, array-based index of the DIE tree's shape.
+ *
+ * Copyright (c) 2008--17, Stephen Kell. For licensing information, see the
+ * LICENSE file in the root of the libdwarfpp tree.
+ */
+
+#ifndef DWARFPP_TOPOLOGY_HPP_
+#define DWARFPP_TOPOLOGY_HPP_
+
+#include <vector>
+#include <memory>
+#include <cstdint>
+#include <cassert>
+#include <utility>
+
+#include "libdwarf.hpp" /* for Dwarf_Off etc. */
+
+namespace dwarf
+{
+	namespace core
+	{
+		using std::vector;
+		using namespace dwarf::lib;
+		struct root_die;
+		namespace native { class image; struct unit; }
+
+		/* The parent_of, first_child_of and next_sibling_of caches in root_die
+		 * are filled in lazily, one hash-table entry per edge, so asking for
+		 * a DIE's depth or its parent means chasing entries (or, if they
+		 * are missing, a search from the root). If the client is willing to
+		 * pay for one pass over the whole tree up front, we can do better.
+		 *
+		 * We number the DIEs 0..n-1 in depth-first (pre-)order and store
+		 * everything we know about each one in parallel arrays, indexed by
+		 * that "ordinal". Since DWARF lays out DIEs in pre-order, ordinals
+		 * increase with offsets, so the offset array is sorted and we can
+		 * get from an offset to its ordinal by binary search. Pre-order also
+		 * means a DIE's first child (if any) is the next ordinal, and its
+		 * subtree is a contiguous run of ordinals.
+		 *
+		 * The root (offset 0) is not in the index; top-level DIEs (CUs) have
+		 * depth 1 and parent NONE. */
+		class topology_index
+		{
+		public:
+			typedef uint32_t ordinal;
+			static const ordinal NONE = (ordinal) -1;
+			/* Where the arrays actually live. Normally that's in our own
+			 * vectors, but they can also be borrowed from a mapped index
+			 * cache file (see index-cache.cpp). */
+			struct arrays
+			{
+				ordinal n;
+				const Dwarf_Off *offsets;
+				const Dwarf_Half *tags;
+				const unsigned short *depths;
+				const ordinal *parents;
+				const ordinal *next_siblings;
+				const ordinal *subtree_sizes; // counting the DIE itself
+			};
+		private:
+			vector<Dwarf_Off> offsets;
+			vector<Dwarf_Half> tags;
+			vector<unsigned short> depths;
+			vector<ordinal> parents;
+			vector<ordinal> next_siblings;
+			vector<ordinal> subtree_sizes;
+			arrays a;
+			std::shared_ptr<const void> p_borrowed_from; // keeps a mapping alive
+			void point_at_vectors();
+
+			/* Tag posting lists, in one compressed array: the ordinals
+			 * carrying posting_tags[i] are posting_ordinals[posting_starts[i]]
+			 * up to posting_ordinals[posting_starts[i+1]], in order. */
+			vector<Dwarf_Half> posting_tags; // sorted
+			vector<ordinal> posting_starts;
+			vector<ordinal> posting_ordinals;
+
+			/* Used by both constructors. The walk is in pre-order and we keep
+			 * a stack of the open ancestors, plus the most recent DIE seen at
+			 * each depth (so we can fill in its next sibling). Walkers only
+			 * need to tell us each DIE's depth; we close subtrees as the
+			 * depth comes back up. */
+			vector<ordinal> open;
+			vector<ordinal> last_at_depth;
+			void begin_die(Dwarf_Off off, Dwarf_Half tag, unsigned short depth);
+			void close_to(unsigned short depth);
+			void finish();
+			
+			/* Per-unit pieces, for building in parallel. Units are independent,
+			 * so each piece is just a unit's DIEs with ordinals counted from 0;
+			 * we rebase and concatenate them afterwards. */
+			void index_unit(const native::image& img, const native::unit& u);
+			void merge_pieces(vector<topology_index>& pieces, unsigned nthreads);
+		public:
+			topology_index() : a() {} // empty
+			/* Fast: decodes the section bytes directly. If nthreads is
+			 * not 1, units are decoded concurrently by that many threads
+			 * (0 means one per hardware thread). */
+			explicit topology_index(const native::image& img, unsigned nthreads = 1);
+			/* Slow: walks the tree with libdwarf (via the root's iterators). */
+			explicit topology_index(root_die& r);
+			/* Borrowed: use someone else's arrays, holding on to "owner". */
+			topology_index(const arrays& borrowed, std::shared_ptr<const void> owner)
+			 : a(borrowed), p_borrowed_from(owner) {}
+			/* Our arrays may point into our vectors, so no copying. Moving
+			 * is fine, because moving a vector doesn't move its buffer. */
+			topology_index(const topology_index&) = delete;
+			topology_index& operator=(const topology_index&) = delete;
+			topology_index(topology_index&&) = default;
+			topology_index& operator=(topology_index&&) = default;
+
+			const arrays& get_arrays() const { return a; }
+			ordinal size() const { return a.n; }
+			/* Heap bytes used by the arrays, for comparison with the
+			 * hash-table caches. Borrowed arrays don't count. */
+			size_t footprint() const;
+
+			/* NONE if there is no DIE at that offset (or it was not in the file). */
+			ordinal ordinal_of(Dwarf_Off off) const;
+
+			Dwarf_Off offset(ordinal o) const { assert(o < size()); return a.offsets[o]; }
+			Dwarf_Half tag(ordinal o) const { assert(o < size()); return a.tags[o]; }
+			unsigned short depth(ordinal o) const { assert(o < size()); return a.depths[o]; }
+			ordinal parent(ordinal o) const { assert(o < size()); return a.parents[o]; }
+			ordinal next_sibling(ordinal o) const { assert(o < size()); return a.next_siblings[o]; }
+			ordinal subtree_size(ordinal o) const { assert(o < size()); return a.subtree_sizes[o]; }
+			ordinal first_child(ordinal o) const
+			{ assert(o < size()); return (a.subtree_sizes[o] > 1) ? o + 1 : NONE; }
+			/* The first ordinal after o's subtree, in depth-first order. */
+			ordinal skip_subtree(ordinal o) const
+			{
+				assert(o < size());
+				ordinal next = o + a.subtree_sizes[o];
+				return (next < size()) ? next : NONE;
+			}
+			/* The first CU, i.e. the root's first child. */
+			ordinal first_top_level() const { return size() > 0 ? 0 : NONE; }
+			/* Parent as an offset, where 0 means the root. */
+			Dwarf_Off parent_offset(ordinal o) const
+			{ ordinal p = parent(o); return (p == NONE) ? 0UL : a.offsets[p]; }
+
+			/* Posting lists, so that "every DIE with tag t", or "every
+			 * child of o with tag t", can go straight from one match to the
+			 * next. They're not built until asked for, and then in one
+			 * pass. Building isn't thread-safe, so the root does it under
+			 * its lock. */
+			void build_postings();
+			bool has_postings() const { return !posting_starts.empty(); }
+			/* The ordinals carrying the tag, in order (maybe empty). */
+			std::pair<const ordinal *, const ordinal *> with_tag(Dwarf_Half tag) const;
+			/* The tags that occur at all, in order. */
+			const vector<Dwarf_Half>& tags_present() const { return posting_tags; }
+		};
+	}
+}
+
+#endif
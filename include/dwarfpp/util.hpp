@@ -11,6 +11,11 @@
 
 #include <fstream>
 #include <iostream>
+#include <cstddef>
+#include <vector>
+#include <atomic>
+#include <thread>
+#include <boost/utility/string_view.hpp>
 
 namespace dwarf
 {
@@ -25,6 +30,41 @@ namespace dwarf
 		}
 		#define debug_expensive(lvl, args...) \
 			((debug_level >= (lvl)) ? (debug(lvl) args) : (debug(lvl)))
+
+		/* Run "work" on items 0..n-1, spread over nthreads threads
+		 * (including this one). Units vary a lot in size, so rather than
+		 * partitioning up front, threads just grab the next item. */
+		template <typename Work>
+		inline void parallel_for_each_index(size_t n, unsigned nthreads, Work work)
+		{
+			std::atomic<size_t> next(0);
+			auto worker = [&next, n, &work]() {
+				for (size_t i = next++; i < n; i = next++) work(i);
+			};
+			std::vector<std::thread> threads;
+			for (unsigned t = 1; t < nthreads && t < n; ++t) threads.emplace_back(worker);
+			worker();
+			for (auto i_t = threads.begin(); i_t != threads.end(); ++i_t) i_t->join();
+		}
+
+		/* Views of strings and blocks that somebody else owns -- usually the
+		 * root_die, whose mapping of the file they point into. They're good
+		 * for as long as the root_die is. A null data() means "nothing there",
+		 * as distinct from an empty string or block. */
+		using boost::string_view;
+		struct block_view
+		{
+			const unsigned char *b;
+			const unsigned char *e;
+			block_view() : b(nullptr), e(nullptr) {}
+			block_view(const unsigned char *b, const unsigned char *e) : b(b), e(e) {}
+			const unsigned char *data() const { return b; }
+			const unsigned char *begin() const { return b; }
+			const unsigned char *end() const { return e; }
+			size_t size() const { return e - b; }
+			bool empty() const { return b == e; }
+			const unsigned char& operator[](size_t i) const { return b[i]; }
+		};
 	}
 }
 
@@ -242,3 +242,8 @@ tags = [ \
 ("shared_type", ( [], [], ["qualified_type"]  ) ) \
 ]
 tag_map = dict(tags)
+
+def all_bases(name):
+    # the bases of a tag or artificial class, transitively
+    immediate = tag_map.get(name, ([], [], []))[2] + artificial_tag_map.get(name, ([], [], []))[2]
+    return set(immediate).union(*[all_bases(base) for base in immediate])
@@ -7,8 +7,11 @@ sys.path.append('./spec')
 from dwarf_current import *
 
 def main(argv):
-    for (tag, (attr_list, children, bases) ) in tags:
-        print("factory_case(%s, %s)" % (tag, ', '.join(bases)))
+    # Each tag with every payload class its payload is an instance of,
+    # from the same tables as the tag predicates (gen-tagpreds-cpp.py),
+    # so that what the factory makes agrees with is_a and payload_cast.
+    for (tag, _) in tags:
+        print("factory_case(%s, %s)" % (tag, ', '.join(sorted(all_bases(tag)))))
 
 # main script
 if __name__ == "__main__":
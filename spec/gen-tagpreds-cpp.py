@@ -7,12 +7,16 @@ sys.path.append('./spec')
 from dwarf_current import *
 
 def main(argv):
-    for base in set(sum([bases for (tag, (attr, children, bases)) in tags], [])):
-        print("begin_pred(%s)" % base)
-        for tag_in_pred in [tag for (tag, ( attr, children, this_tag_bases) ) in tags \
-                if base in this_tag_bases]:
-            print("\tdisjunct(%s)" % tag_in_pred)
-        print("end_pred(%s)" % base)
+    # For each payload class, the tags whose payloads are instances of it.
+    # Every tag makes a basic, so we leave that one out.
+    classes = [tag for (tag, _) in tags] + \
+        [name for (name, _) in artificial_tags if name != "basic"]
+    for cls in classes:
+        print("begin_pred(%s)" % cls)
+        for (tag, _) in tags:
+            if tag == cls or cls in all_bases(tag):
+                print("\tdisjunct(%s)" % tag)
+        print("end_pred(%s)" % cls)
 
 # main script
 if __name__ == "__main__":
@@ -17,6 +17,7 @@
 #include "dwarfpp/dies-inl.hpp"
 
 #include <sstream>
+#include <algorithm>
 
 namespace dwarf
 {
@@ -35,15 +36,16 @@ namespace dwarf
 		basic_die *dwarf_current_factory_t::make_non_cu_payload(abstract_die&& h, root_die& r)
 		{
 			basic_die *p;
-			Die d(std::move(dynamic_cast<Die&&>(h)));
+			assert(h.as_libdwarf_die());
+			Die d(std::move(*h.as_libdwarf_die()));
 			assert(d.tag_here() != DW_TAG_compile_unit);
 			switch (d.tag_here())
 			{
 #define factory_case(name, ...) \
-case DW_TAG_ ## name: p = new name ## _die(d.spec_here(), std::move(d.handle)); break; // FIXME: not "basic_die"...
+case DW_TAG_ ## name: p = new (r) name ## _die(d.spec_here(), std::move(d.handle)); break; // FIXME: not "basic_die"...
 #include "dwarf-current-factory.h"
 #undef factory_case
-				default: p = new basic_die(d.spec_here(), std::move(d.handle)); break;
+				default: p = new (r) basic_die(d.spec_here(), std::move(d.handle)); break;
 			}
 			return p;
 		}
@@ -53,9 +55,10 @@ case DW_TAG_ ## name: p = new name ## _die(d.spec_here(), std::move(d.handle));
 			// Key point: we're not allowed to call Die::spec_here() for this handle. 
 			// We could write libdwarf-level code to grab the version stamp and 
 			// so on... for now, just construct the thing.
-			Die d(std::move(dynamic_cast<Die&&>(h)));
+			assert(h.as_libdwarf_die());
+			Die d(std::move(*h.as_libdwarf_die()));
 			Dwarf_Off off = d.offset_here();
-			auto p = new compile_unit_die(dwarf::spec::dwarf_current, std::move(d.handle));
+			auto p = new (r) compile_unit_die(dwarf::spec::dwarf_current, std::move(d.handle));
 			/* fill in the CU fields -- this code would be shared by all 
 			 * factories, so we put it here (but HMM, if our factories were
 			 * a delegation chain, we could just put it in the root). */
@@ -132,6 +135,10 @@ case DW_TAG_ ## name: p = new name ## _die(d.spec_here(), std::move(d.handle));
 				{ return this->in_memory_abstract_die::get_tag(); } \
 				opt<string> get_name() const \
 				{ return this->in_memory_abstract_die::get_name(); } \
+				string_view get_name_view() const \
+				{ return this->in_memory_abstract_die::get_name_view(); } \
+				block_view get_block_view(Dwarf_Half attr) const \
+				{ return this->in_memory_abstract_die::get_block_view(attr); } \
 				Dwarf_Off get_enclosing_cu_offset() const \
 				{ return this->in_memory_abstract_die::get_enclosing_cu_offset(); } \
 				bool has_attr(Dwarf_Half attr) const \
@@ -203,10 +210,30 @@ case DW_TAG_ ## name: return &dummy_ ## name;
 			}
 		}
 		
+		const std::vector<Dwarf_Half>& dwarf_current_factory_t::known_tags()
+		{
+			static const std::vector<Dwarf_Half> tags = []() {
+				std::vector<Dwarf_Half> v = {
+#define factory_case(name, ...) \
+DW_TAG_ ## name,
+#include "dwarf-current-factory.h"
+#undef factory_case
+				};
+				std::sort(v.begin(), v.end());
+				return v;
+			}();
+			return tags;
+		}
+		
+		void in_memory_abstract_die::attribute_map::note_edited()
+		{
+			p_owner->p_root->note_in_memory_edit(p_owner->m_cu_offset);
+		}
 		void in_memory_abstract_die::attribute_map::update_cache_on_insert(
 			attribute_map::iterator inserted
 		)
 		{
+			note_edited();
 			if (inserted->first == DW_AT_name)
 			{
 				auto found = p_owner->p_root->pos(p_owner->m_offset);
@@ -483,10 +483,43 @@ namespace dwarf
 		attribute_map::attribute_map(const core::AttributeList& l, const core::Die& d, 
 			root_die& r, spec::abstract_def& spec /* = 0 */)
 		{
+			v.reserve(l.copied_list.size());
 			for (auto i = l.copied_list.begin(); i != l.copied_list.end(); ++i)
 			{
-				this->insert(make_pair(i->attr_here(), attribute_value(*i, d, r)));
+				v.emplace_back(i->attr_here(), attribute_value(*i, d, r));
 			}
+			/* They come in abbrev order. Sort them by insertion, which is
+			 * stable, so that as with a map, the first of any duplicates
+			 * wins, and allocates nothing. */
+			for (auto i = v.begin(); i != v.end(); ++i)
+			{
+				std::rotate(std::upper_bound(v.begin(), i, *i,
+						[](const value_type& l, const value_type& r) { return l.first < r.first; }),
+					i, i + 1);
+			}
+			v.erase(std::unique(v.begin(), v.end(),
+					[](const value_type& l, const value_type& r) { return l.first == r.first; }),
+				v.end());
+		}
+		
+		void attribute_map::left_merge(attribute_map&& arg)
+		{
+			if (arg.empty()) return;
+			/* Both are sorted, so merge them, ours winning on equal keys. */
+			base merged;
+			merged.reserve(v.size() + arg.v.size());
+			auto i = v.begin();
+			auto j = arg.v.begin();
+			while (i != v.end() || j != arg.v.end())
+			{
+				if (j == arg.v.end() || (i != v.end() && i->first <= j->first))
+				{
+					if (j != arg.v.end() && i->first == j->first) ++j;
+					merged.push_back(std::move(*i++));
+				}
+				else merged.push_back(std::move(*j++));
+			}
+			v = std::move(merged);
 		}
 		
 		void attribute_map::print(std::ostream& s, unsigned indent_level) const
@@ -566,11 +599,11 @@ namespace dwarf
 				case SIGNED:
 					return this->v_s == v.v_s;
 				case BLOCK:
-					return this->v_block == v.v_block;
+					return *(this->v_block) == *(v.v_block);
 				case STRING:
 					return *(this->v_string) == *(v.v_string);
 				case REF:
-					return this->v_ref == v.v_ref;
+					return *(this->v_ref) == *(v.v_ref);
 				case ADDR:
 					return this->v_addr == v.v_addr;
 				case LOCLIST:
@@ -582,7 +615,8 @@ namespace dwarf
 					return false;
 			} // end switch
 		}
-		attribute_value::~attribute_value() {
+		void attribute_value::release()
+		{
 			switch (f)
 			{
 				case FLAG:
@@ -609,7 +643,28 @@ namespace dwarf
 				break;
 				default: break;
 			} // end switch
-			} // end ~attribute_value
+			f = NO_ATTR;
+		}
+		attribute_value::~attribute_value() { release(); }
+		void attribute_value::steal(attribute_value& av)
+		{
+			/* Our caller has already release()d anything we had. */
+			f = av.f;
+			switch (f)
+			{
+				case FLAG: v_flag = av.v_flag; break;
+				case UNSIGNED: v_u = av.v_u; break;
+				case SIGNED: v_s = av.v_s; break;
+				case ADDR: v_addr = av.v_addr; break;
+				case BLOCK: v_block = av.v_block; break;
+				case STRING: v_string = av.v_string; break;
+				case REF: v_ref = av.v_ref; break;
+				case LOCLIST: v_loclist = av.v_loclist; break;
+				case RANGELIST: v_rangelist = av.v_rangelist; break;
+				default: v_u = av.v_u; break;
+			} // end switch
+			av.f = NO_ATTR;
+		}
 
 		attribute_value::weak_ref& 
 		attribute_value::weak_ref::operator=(const attribute_value::weak_ref& r)
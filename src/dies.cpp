@@ -104,6 +104,7 @@ namespace dwarf
 		opt<string> program_element_die::find_associated_name() const
 		{
 			root_die& r = get_root();
+			root_die::guard g(r); // we walk the reference caches
 			r.ensure_refers_to_cache_is_complete();
 			/* We have an associated name iff
 			 * - we have no name, and
@@ -227,6 +228,9 @@ namespace dwarf
 		}
 		std::ostream& with_data_members_die::print_abstract_name(std::ostream& s) const
 		{
+			/* Usually we have a name, and can print it without copying. */
+			string_view name = get_name_view();
+			if (name.data()) { s << name; return s; }
 			vector<string> name_path(1, arbitrary_name()); /* FIXME: handle namespaces */
 			for (auto i = name_path.begin(); i != name_path.end(); ++i)
 			{
@@ -244,6 +248,9 @@ namespace dwarf
 		}
 		std::ostream& enumeration_type_die::print_abstract_name(std::ostream& s) const
 		{
+			/* Usually we have a name, and can print it without copying. */
+			string_view name = get_name_view();
+			if (name.data()) { s << name; return s; }
 			vector<string> name_path(1, arbitrary_name()); /* FIXME: handle namespaces */
 			for (auto i = name_path.begin(); i != name_path.end(); ++i)
 			{
@@ -1468,7 +1475,10 @@ namespace dwarf
 		template <typename BaseType>
 		opt<BaseType> type_die::combined_summary_code_using_iterators() const
 		{
-			if (this->cached_summary_code) return this->cached_summary_code;
+			{
+				root_die::guard g(get_root());
+				if (this->cached_summary_code) return this->cached_summary_code;
+			}
 			//auto found_in_root_cache = get_root().type_summary_code_cache.find(get_offset());
 			//if (found_in_root_cache != get_root().type_summary_code_cache.end())
 			//{
@@ -1698,7 +1708,10 @@ namespace dwarf
 				output_word << abstract_name_for_type(self);
 			}
 
-			this->cached_summary_code = output_word.val;
+			{
+				root_die::guard g(get_root());
+				this->cached_summary_code = output_word.val;
+			}
 			//get_root().type_summary_code_cache.insert(
 			//	make_pair(get_offset(), output_word.val)
 			//);
@@ -1741,7 +1754,10 @@ namespace dwarf
 			 * - encode byte- and bit-offsets of every field
 			 */
 			/* if we have it cached, return that */
-			if (this->cached_summary_code) return this->cached_summary_code;
+			{
+				root_die::guard g(get_root());
+				if (this->cached_summary_code) return this->cached_summary_code;
+			}
 // 			auto found_cached = get_root().type_summary_code_cache.find(get_offset());
 // 			if (found_cached != get_root().type_summary_code_cache.end())
 // 			{
@@ -2006,12 +2022,18 @@ namespace dwarf
 			if (code_to_return) debug(2) << std::hex << *code_to_return << std::dec;
 			else debug(2) << "(no code)";
 			debug(2) << endl;
-			this->cached_summary_code = code_to_return;
+			{
+				root_die::guard g(get_root());
+				this->cached_summary_code = code_to_return;
+			}
 			return code_to_return;
 		}
 		opt<uint32_t> type_die::summary_code() const
 		{
-			if (this->cached_summary_code) return this->cached_summary_code;
+			{
+				root_die::guard g(get_root());
+				if (this->cached_summary_code) return this->cached_summary_code;
+			}
 			//return this->summary_code_using_walk_type();
 			// return this->combined_summary_code_using_iterators<uint32_t>();
 			
@@ -2150,7 +2172,10 @@ namespace dwarf
 					return summary_code_for_type(arg);
 				}
 			);
-			this->cached_summary_code = computed;
+			{
+				root_die::guard g(get_root());
+				this->cached_summary_code = computed;
+			}
 			return computed;
 		}
 		
@@ -2256,9 +2281,10 @@ namespace dwarf
 
 		opt<type_scc_t> type_die::get_scc() const
 		{
+			root_die::guard g(get_root());
 			assert(get_root().live_dies.find(get_offset()) != get_root().live_dies.end());
 			assert(get_root().live_dies.find(get_offset())->second
-				== dynamic_cast<const basic_die *>(this));
+				== static_cast<const basic_die *>(this));
 			
 			/* This is a generic implementation. If subclasses know that they can 
 			 * never be part of a cycle, they're allowed to override to just the following.
@@ -2808,13 +2834,17 @@ namespace dwarf
 				}
 				return opt<bool>();
 			}; // end check_cached_result lambda
-			opt<bool> cached = check_cached_result(self, t);
-			if (cached)
 			{
-				opt<bool> reversed = check_cached_result(t, self);
-				assert(reversed.is_initialized());
-				assert(*reversed == *cached);
-				return *cached ? EQUAL : UNEQUAL; // we never cache 'by assumption' results
+				/* Other threads may be merging equivalence classes. */
+				root_die::guard g(self.root());
+				opt<bool> cached = check_cached_result(self, t);
+				if (cached)
+				{
+					opt<bool> reversed = check_cached_result(t, self);
+					assert(reversed.is_initialized());
+					assert(*reversed == *cached);
+					return *cached ? EQUAL : UNEQUAL; // we never cache 'by assumption' results
+				}
 			}
 			if (t && &t.root() == &self.root())
 			{
@@ -2927,6 +2957,8 @@ namespace dwarf
 			 * test and do nothing if it returns something (anything).
 			 */
 			// there wasn't a result in the cache earlier; is there one now?
+			{ /* We hold the lock until the end of the caching code. */
+			root_die::guard g(self.root());
 			/* opt<bool> */ re_checked = check_cached_result(self, t);
 			if (re_checked) { assert(*re_checked == ret); goto return_after_cache; }
 			print_equivalence_class = [](list<set<Dwarf_Off>>::iterator i_cl) -> string {
@@ -3118,6 +3150,7 @@ namespace dwarf
 					<< " with " << t.summary()
 					<< " returned " << std::boolalpha << ret << endl);
 			}
+			} /* end locked caching code */
 #endif /* DISABLE_TYPE_EQUALITY_CACHE */
 		return_after_cache:
 			if (reason != "" && reason_for_caller) *reason_for_caller = reason;
@@ -3830,6 +3863,7 @@ namespace dwarf
 		}
 		iterator_base with_data_members_die::find_definition() const
 		{
+			root_die::guard g(get_root());
 			root_die& r = get_root();
 			if (!get_declaration() || !*get_declaration()) 
 			{
@@ -4131,7 +4165,7 @@ namespace dwarf
 			// by the fact that only certain tags are with_static_location_dies,
 			// but both locals and globals show up with DW_TAG_variable.
 			if (this->get_tag() == DW_TAG_variable &&
-				!dynamic_cast<const variable_die *>(this)->has_static_storage())
+				!payload_cast<variable_die>(static_cast<const basic_die *>(this))->has_static_storage())
 				goto out;
 			else
 			{
@@ -4439,7 +4473,7 @@ namespace dwarf
 				 * we increment *with* enqueueing children.
 				 * Otherwise we increment without enqueueing children.
 				 */
-				if (dynamic_cast<with_dynamic_location_die*>(&dereference())) { 
+				if (this->is_a<with_dynamic_location_die>()) { 
 					super::increment();
 				} else {
 					switch (tag_here())
@@ -4473,18 +4507,11 @@ namespace dwarf
 			auto i = find_self();
 			assert(i != iterator_base::END);
 			
-			// Calculate the vaddr which selects a loclist element
-			auto frame_base_loclist = *get_frame_base();
-			iterator_df<compile_unit_die> enclosing_cu
-			 = r.cu_pos(i.enclosing_cu_offset_here());
-			debug(2) << "Enclosing CU is " << enclosing_cu->summary() << endl;
-			Dwarf_Addr low_pc = enclosing_cu->get_low_pc()->addr;
-			assert(low_pc <= dieset_relative_ip);
-			Dwarf_Addr vaddr = dieset_relative_ip - low_pc;
-			/* Now calculate our frame base address. */
+			/* Now calculate our frame base address. The compiled loclist has
+			 * the CU base applied already, so takes the IP as it is. */
 			auto frame_base_addr = expr::evaluator(
-				frame_base_loclist,
-				vaddr,
+				*r.compiled_loclist_for(i, DW_AT_frame_base),
+				dieset_relative_ip,
 				get_spec(r),
 				p_regs).tos();
 			if (out_frame_base) *out_frame_base = frame_base_addr;
@@ -4506,7 +4533,7 @@ namespace dwarf
 			{
 				debug(2) << "Considering whether DIE has stack location: " 
 					<< i_bfs->summary() << std::endl;
-				auto with_stack_loc = dynamic_cast<with_dynamic_location_die*>(&i_bfs.dereference());
+				auto with_stack_loc = payload_cast<with_dynamic_location_die>(&i_bfs.dereference());
 				if (!with_stack_loc) continue;
 				
 				opt<Dwarf_Off> result = with_stack_loc->spans_addr(absolute_addr,
@@ -4612,7 +4639,7 @@ namespace dwarf
 			{
 				auto candidate = i.parent();
 				while (candidate != iterator_base::END
-					&& !dynamic_cast<type_die *>(&candidate.dereference()))
+					&& !candidate.is_a<type_die>())
 				{
 					candidate = candidate.parent();
 				}
@@ -4797,8 +4824,7 @@ namespace dwarf
 					// where to create -- new CU? yes, I guess so
 					auto cu = get_root().get_or_create_synthetic_cu();
 					auto created = get_root().make_new(cu, DW_TAG_base_type);
-					auto& attrs = dynamic_cast<core::in_memory_abstract_die&>(created.dereference())
-						.attrs();
+					auto& attrs = created.dereference().as_in_memory()->attrs();
 					encap::attribute_value v_name(*bt->get_name()); // must have a name
 					attrs.insert(make_pair(DW_AT_name, v_name));
 					encap::attribute_value v_bit_size(effective_bit_size);
@@ -5024,8 +5050,30 @@ namespace dwarf
 					}
 			}
 		}
-		static string default_cxx_mangle(const string& s)
-		{ assert(false); exit(-1); }
+		/* We only get here if there's no DW_AT_linkage_name. We don't do the
+		 * C++ ABI's mangling, but producers emit one whenever the symbol
+		 * isn't just the name. So we give the name for main() and for
+		 * external things at global scope, except functions with parameters,
+		 * which might be overloads. Otherwise we can't say. The linkage name
+		 * index uses the same rule. */
+		static opt<string> default_cxx_mangle(const iterator_base& i)
+		{
+			opt<string> name = i.name_here();
+			if (!name || *name == "main") return name;
+			if (i.depth() != 2) return opt<string>();
+			encap::attribute_map attrs = i.dereference().find_all_attrs();
+			auto found_external = attrs.find(DW_AT_external);
+			if (found_external == attrs.end() || !found_external->second.get_flag())
+			{
+				return opt<string>();
+			}
+			if (i.tag_here() == DW_TAG_subprogram)
+			{
+				auto fps = i.children_here().subseq_of<formal_parameter_die>();
+				if (fps.first != fps.second) return opt<string>();
+			}
+			return name;
+		}
 		opt<string> compile_unit_die::mangled_name_for(iterator_base i) const
 		{
 			switch(get_language())
@@ -5061,7 +5109,7 @@ namespace dwarf
 #define maybe_Cplusplus_17_and_later_cases
 #endif
 				Cplusplus_cases
-					return default_cxx_mangle(*i.name_here());
+					return default_cxx_mangle(i);
 
 #define C_cases \
 				case DW_LANG_C: \
@@ -5107,6 +5155,7 @@ namespace dwarf
 		}
 		iterator_df<type_die> compile_unit_die::implicit_enum_base_type() const
 		{
+			root_die::guard g(get_root());
 			if (cached_implicit_enum_base_type) return cached_implicit_enum_base_type; // FIXME: cache "not found" result too
 			/* Language-specific knowledge. */
 			switch(get_language())
@@ -5136,6 +5185,7 @@ namespace dwarf
 		}
 		iterator_df<type_die> compile_unit_die::implicit_subrange_base_type() const
 		{
+			root_die::guard g(get_root());
 			if (cached_implicit_subrange_base_type) return cached_implicit_subrange_base_type; // FIXME: cache "not found" result too
 
 			/* Subranges might have no type, at least in that I've seen gcc generate them.
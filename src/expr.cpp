@@ -92,13 +92,32 @@ namespace dwarf
 				<< " is not covered by any loc expr in " << loclist << endl;
 			throw No_entry();
 		}
+		evaluator::evaluator(const encap::compiled_loclist& loclist,
+			Dwarf_Addr pc,
+			const ::dwarf::spec::abstract_def& spec,
+			regs *p_regs,
+			opt<Dwarf_Signed> frame_base,
+			const evaluator::eval_stack& initial_stack)
+		: m_stack(initial_stack), spec(spec), p_regs(p_regs), m_tos_state(ADDRESS), frame_base(frame_base)
+		{
+			const encap::loc_expr *found = loclist.expr_for_pc(pc);
+			if (!found)
+			{
+				debug(2) << "PC 0x" << std::hex << pc << std::dec
+					<< " is not covered by any loc expr in a compiled loclist" << endl;
+				throw No_entry();
+			}
+			expr = *found;
+			i = expr.begin();
+			eval();
+		}
 		
 		
 		void evaluator::eval()
 		{
+#if 0
 			std::ostringstream s;
 			s << expr << std::endl;
-#if 0
 			std::cerr << "Evaluating '" << s.str() << "' with initial stack size " << m_stack.size()
 				<< std::endl;
 #endif
@@ -388,6 +407,67 @@ dwarf_expr_computed_ops(computed_op_case)
 				push_back(rl.handle.get()[i]);
 			}
 		}
+		compiled_loclist::compiled_loclist(const loclist& l, Dwarf_Addr cu_base)
+		{
+			/* First make each entry's range absolute. */
+			const unsigned NONE = (unsigned) -1;
+			vector<range> entries;
+			Dwarf_Addr base = cu_base;
+			for (auto i_l = l.begin(); i_l != l.end(); ++i_l)
+			{
+				if (i_l->lopc == 0xffffffffU
+				||  i_l->lopc == 0xffffffffffffffffULL)
+				{
+					/* This is a "base address selection entry". */
+					base = i_l->hipc;
+					continue;
+				}
+				exprs.push_back(*i_l);
+				unsigned idx = exprs.size() - 1;
+				/* As in evaluator, either of these means "all vaddrs". */
+				if (i_l->lopc == 0 && (i_l->hipc == 0
+					|| i_l->hipc == std::numeric_limits<Dwarf_Addr>::max()))
+				{
+					entries.push_back(range { 0, std::numeric_limits<Dwarf_Addr>::max(), idx });
+				}
+				else if (i_l->lopc < i_l->hipc)
+				{
+					entries.push_back(range { base + i_l->lopc, base + i_l->hipc, idx });
+				}
+			}
+			/* Split at every boundary, so that each piece has the same entries
+			 * throughout. Earlier entries win, so paint the later ones first. */
+			vector<Dwarf_Addr> bounds;
+			bounds.reserve(2 * entries.size());
+			for (auto i_e = entries.begin(); i_e != entries.end(); ++i_e)
+			{
+				bounds.push_back(i_e->lo);
+				bounds.push_back(i_e->hi);
+			}
+			std::sort(bounds.begin(), bounds.end());
+			bounds.erase(std::unique(bounds.begin(), bounds.end()), bounds.end());
+			vector<unsigned> owner(bounds.size(), NONE); // for [bounds[k], bounds[k+1])
+			for (auto i_e = entries.rbegin(); i_e != entries.rend(); ++i_e)
+			{
+				for (auto k = std::lower_bound(bounds.begin(), bounds.end(), i_e->lo) - bounds.begin();
+					bounds[k] < i_e->hi; ++k)
+				{
+					owner[k] = i_e->expr_idx;
+				}
+			}
+			/* Neighbouring pieces with the same expression go back together. */
+			for (unsigned k = 0; k + 1 < bounds.size(); ++k)
+			{
+				if (owner[k] == NONE) continue;
+				if (!ranges.empty() && ranges.back().hi == bounds[k]
+					&& ranges.back().expr_idx == owner[k])
+				{
+					ranges.back().hi = bounds[k+1];
+				}
+				else ranges.push_back(range { bounds[k], bounds[k+1], owner[k] });
+			}
+		}
+		
 		loc_expr loclist::loc_for_vaddr(Dwarf_Addr vaddr) const
 		{
 			for (auto i = this->begin(); i != this->end(); i++)
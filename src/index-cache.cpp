@@ -0,0 +1,458 @@
+/* dwarfpp: C++ binding for a useful subset of libdwarf, plus extra goodies.
+ *
+ * index-cache.cpp: saving root_die's indexes to disk, and mapping them back
+ *
+ * Copyright (c) 2008--17, Stephen Kell. For licensing information, see the
+ * LICENSE file in the root of the libdwarfpp tree.
+ */
+
+#include "dwarfpp/root.hpp"
+#include "dwarfpp/root-inl.hpp"
+#include "dwarfpp/iter.hpp"
+#include "dwarfpp/iter-inl.hpp"
+
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <set>
+#include <cstring>
+#include <cstdlib>
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+namespace dwarf
+{
+	using std::endl;
+	namespace core
+	{
+		/* The file is just a header followed by some arrays, all host-endian
+		 * and 8-byte aligned, so that the topology arrays can be used in
+		 * place once mapped. We don't try to be portable between hosts;
+		 * a cache file from a different kind of host will just look stale. */
+		static const char index_cache_magic[8] = { 'D', 'W', 'P', 'P', 'I', 'D', 'X', '\0' };
+		static const uint32_t index_cache_version = 2;
+		struct index_cache_header
+		{
+			char magic[8];
+			uint32_t version;
+			uint32_t build_id_len;
+			unsigned char build_id[64];
+			/* .debug_info, .debug_abbrev, .debug_str */
+			uint64_t section_sizes[3];
+			uint64_t section_sums[3];
+			uint64_t file_size;
+			uint64_t ndies;
+			uint64_t topology_off;
+			uint64_t nnames;
+			uint64_t names_off;
+			uint64_t name_chars_off;
+			uint64_t name_chars_len;
+			uint64_t names_complete;
+			uint64_t nrefs;
+			uint64_t refs_off;
+			/* The name filters' arrays (see cu_name_filters). */
+			uint64_t nfilter_cus;
+			uint64_t filter_cu_offsets_off;
+			uint64_t filter_starts_off;
+			uint64_t nfilter_words;
+			uint64_t filter_words_off;
+		};
+		struct index_cache_name
+		{
+			uint64_t die_off;
+			uint32_t name_pos; // in the name_chars blob
+			uint32_t name_len;
+		};
+		struct index_cache_ref
+		{
+			uint64_t from;
+			uint64_t to;
+			uint32_t attr;
+			uint32_t padding;
+		};
+
+		static uint64_t align8(uint64_t n) { return (n + 7) & ~(uint64_t) 7; }
+
+		/* Where the topology arrays go, given where they start. Returns the end. */
+		static uint64_t topology_layout(uint64_t n, uint64_t base, uint64_t out[6])
+		{
+			uint64_t pos = base;
+			const uint64_t elsizes[6] = {
+				sizeof (Dwarf_Off), // offsets
+				sizeof (topology_index::ordinal), // parents
+				sizeof (topology_index::ordinal), // next siblings
+				sizeof (topology_index::ordinal), // subtree sizes
+				sizeof (Dwarf_Half), // tags
+				sizeof (unsigned short) // depths
+			};
+			for (unsigned i = 0; i < 6; ++i)
+			{
+				out[i] = pos;
+				pos = align8(pos + n * elsizes[i]);
+			}
+			return pos;
+		}
+
+		/* Hashing the whole of a big .debug_info would cost most of what
+		 * we're trying to save. The build ID (if any) already names the
+		 * contents; this is to catch files rebuilt without one, or modified
+		 * in place. So we take one word from every page, plus the last. */
+		static uint64_t sampled_checksum(const native::section& s)
+		{
+			uint64_t h = 0xcbf29ce484222325ull ^ s.size();
+			auto mix = [&h](uint64_t w) { h ^= w; h *= 0x100000001b3ull; h ^= h >> 29; };
+			uint64_t w;
+			for (size_t off = 0; off + sizeof w <= s.size(); off += 4096)
+			{
+				memcpy(&w, s.begin + off, sizeof w);
+				mix(w);
+			}
+			if (s.size() >= sizeof w)
+			{
+				memcpy(&w, s.end - sizeof w, sizeof w);
+				mix(w);
+			}
+			return h;
+		}
+
+		static void fill_key(const native::image& img, index_cache_header& h)
+		{
+			memset(&h, 0, sizeof h);
+			memcpy(h.magic, index_cache_magic, sizeof h.magic);
+			h.version = index_cache_version;
+			h.build_id_len = std::min<size_t>(img.build_id().size(), sizeof h.build_id);
+			if (h.build_id_len > 0) memcpy(h.build_id, img.build_id().begin, h.build_id_len);
+			const native::section *secs[] = {
+				&img.info_section(), &img.abbrev_section(), &img.str_section()
+			};
+			for (unsigned i = 0; i < 3; ++i)
+			{
+				h.section_sizes[i] = secs[i]->size();
+				h.section_sums[i] = *secs[i] ? sampled_checksum(*secs[i]) : 0;
+			}
+		}
+
+		/* Whether n elements of elsize bytes at off fit in len bytes,
+		 * without overflowing on the way. */
+		static bool fits(uint64_t off, uint64_t n, uint64_t elsize, uint64_t len)
+		{
+			return off <= len && n <= (len - off) / elsize;
+		}
+
+		/* The arrays come from a file, so they may be garbage even if they
+		 * fit. Check they describe a tree in pre-order before anyone uses
+		 * an ordinal from them as an index. */
+		static bool topology_is_sane(const topology_index::arrays& a)
+		{
+			const topology_index::ordinal NONE = topology_index::NONE;
+			for (topology_index::ordinal i = 0; i < a.n; ++i)
+			{
+				if (i > 0 && a.offsets[i] <= a.offsets[i - 1]) return false;
+				if (a.subtree_sizes[i] < 1 || a.subtree_sizes[i] > a.n - i) return false;
+				topology_index::ordinal p = a.parents[i];
+				if (p == NONE) { if (a.depths[i] != 1) return false; }
+				else if (p >= i || i >= p + a.subtree_sizes[p]
+					|| a.depths[i] != a.depths[p] + 1) return false;
+				topology_index::ordinal next = a.next_siblings[i];
+				if (next != NONE && (next != i + a.subtree_sizes[i] || next >= a.n
+					|| a.parents[next] != p)) return false;
+			}
+			return true;
+		}
+
+		/* Likewise for the name filters: each a power of two words, in order. */
+		static bool filters_are_sane(const cu_name_filters::arrays& fa, uint64_t nwords)
+		{
+			if (fa.starts[0] != 0 || fa.starts[fa.n_cus] != nwords) return false;
+			for (uint64_t i = 0; i < fa.n_cus; ++i)
+			{
+				if (fa.starts[i + 1] <= fa.starts[i]) return false;
+				uint64_t n = fa.starts[i + 1] - fa.starts[i];
+				if ((n & (n - 1)) != 0) return false;
+				if (i > 0 && fa.cu_offsets[i] <= fa.cu_offsets[i - 1]) return false;
+			}
+			return true;
+		}
+
+		static bool same_key(const index_cache_header& h1, const index_cache_header& h2)
+		{
+			return 0 == memcmp(h1.magic, h2.magic, sizeof h1.magic)
+				&& h1.version == h2.version
+				&& h1.build_id_len == h2.build_id_len
+				&& 0 == memcmp(h1.build_id, h2.build_id, h1.build_id_len)
+				&& 0 == memcmp(h1.section_sizes, h2.section_sizes, sizeof h1.section_sizes)
+				&& 0 == memcmp(h1.section_sums, h2.section_sums, sizeof h1.section_sums);
+		}
+
+		string root_die::default_index_cache_path() const
+		{
+			if (!p_native) return string();
+			string dir;
+			if (getenv("DWARFPP_INDEX_CACHE_DIR")) dir = getenv("DWARFPP_INDEX_CACHE_DIR");
+			else if (getenv("XDG_CACHE_HOME")) dir = string(getenv("XDG_CACHE_HOME")) + "/dwarfpp";
+			else if (getenv("HOME")) dir = string(getenv("HOME")) + "/.cache/dwarfpp";
+			else return string();
+
+			std::ostringstream s;
+			s << dir << "/" << std::hex << std::setfill('0');
+			const native::section& id = p_native->build_id();
+			if (id) for (const unsigned char *p = id.begin; p != id.end; ++p)
+			{
+				s << std::setw(2) << (unsigned) *p;
+			}
+			else s << "no-build-id-" << p_native->info_section().size()
+				<< "-" << sampled_checksum(p_native->info_section());
+			s << ".idx";
+			return s.str();
+		}
+
+		bool root_die::save_index_cache(const string& path_arg /* = string() */)
+		{
+			guard g(*this);
+			if (!p_native)
+			{
+				debug(1) << "Can't save an index cache without the native decoder" << endl;
+				return false;
+			}
+			string path = path_arg.empty() ? default_index_cache_path() : path_arg;
+			if (path.empty()) return false;
+
+			/* Make sure what we save is complete. */
+			build_topology_index(0);
+			build_name_filters(0);
+			ensure_refers_to_cache_is_complete();
+			if (!visible_named_grandchildren_is_complete)
+			{
+				auto vg_seq = visible_named_grandchildren();
+				for (auto i_g = std::move(vg_seq.first); i_g != vg_seq.second; ++i_g);
+			}
+
+			/* Only DIEs from the file are worth saving. Also, the
+			 * grandchildren cache can contain duplicates. */
+			auto in_file = [this](Dwarf_Off off) {
+				return p_topology->ordinal_of(off) != topology_index::NONE;
+			};
+			std::set<pair<string, Dwarf_Off> > names;
+			for (auto i_n = visible_named_grandchildren_cache.begin();
+				i_n != visible_named_grandchildren_cache.end(); ++i_n)
+			{
+				if (in_file(i_n->second)) names.insert(*i_n);
+			}
+			vector<index_cache_ref> refs;
+			for (auto i_r = refers_to.begin(); i_r != refers_to.end(); ++i_r)
+			{
+				if (!in_file(i_r->first.first) || !in_file(i_r->second)) continue;
+				index_cache_ref r = { i_r->first.first, i_r->second, i_r->first.second, 0 };
+				refs.push_back(r);
+			}
+
+			index_cache_header h;
+			fill_key(*p_native, h);
+			const topology_index::arrays& a = p_topology->get_arrays();
+			h.ndies = a.n;
+			h.topology_off = align8(sizeof h);
+			uint64_t layout[6];
+			h.nnames = names.size();
+			h.names_off = topology_layout(h.ndies, h.topology_off, layout);
+			h.name_chars_off = align8(h.names_off + h.nnames * sizeof (index_cache_name));
+			h.name_chars_len = 0;
+			for (auto i_n = names.begin(); i_n != names.end(); ++i_n) h.name_chars_len += i_n->first.size();
+			h.names_complete = visible_named_grandchildren_is_complete;
+			h.nrefs = refs.size();
+			h.refs_off = align8(h.name_chars_off + h.name_chars_len);
+			const cu_name_filters::arrays& fa = p_name_filters->get_arrays();
+			h.nfilter_cus = fa.n_cus;
+			h.filter_cu_offsets_off = h.refs_off + h.nrefs * sizeof (index_cache_ref);
+			h.filter_starts_off = h.filter_cu_offsets_off + h.nfilter_cus * sizeof (Dwarf_Off);
+			h.nfilter_words = fa.starts[fa.n_cus];
+			h.filter_words_off = h.filter_starts_off + (h.nfilter_cus + 1) * sizeof (uint64_t);
+			h.file_size = h.filter_words_off + h.nfilter_words * sizeof (uint64_t);
+
+			/* Make the directory, if it's not there already. */
+			for (size_t slash = path.find('/', 1); slash != string::npos; slash = path.find('/', slash + 1))
+			{
+				mkdir(path.substr(0, slash).c_str(), 0755);
+			}
+			/* Write to a temporary and rename, so concurrent readers never
+			 * see a half-written file. */
+			std::ostringstream tmp_path_s;
+			tmp_path_s << path << ".tmp." << getpid();
+			string tmp_path = tmp_path_s.str();
+			{
+				std::ofstream out(tmp_path, std::ios::binary | std::ios::trunc);
+				if (!out)
+				{
+					debug(1) << "Could not create index cache file " << tmp_path << endl;
+					return false;
+				}
+				uint64_t written = 0;
+				auto put = [&out, &written](const void *p, size_t len) {
+					out.write(static_cast<const char *>(p), len);
+					written += len;
+				};
+				auto pad_to = [&put, &written](uint64_t pos) {
+					static const char zeroes[8] = { 0 };
+					assert(pos >= written && pos - written < sizeof zeroes);
+					put(zeroes, pos - written);
+				};
+				put(&h, sizeof h);
+				pad_to(layout[0]); put(a.offsets, a.n * sizeof (Dwarf_Off));
+				pad_to(layout[1]); put(a.parents, a.n * sizeof (topology_index::ordinal));
+				pad_to(layout[2]); put(a.next_siblings, a.n * sizeof (topology_index::ordinal));
+				pad_to(layout[3]); put(a.subtree_sizes, a.n * sizeof (topology_index::ordinal));
+				pad_to(layout[4]); put(a.tags, a.n * sizeof (Dwarf_Half));
+				pad_to(layout[5]); put(a.depths, a.n * sizeof (unsigned short));
+				pad_to(h.names_off);
+				uint32_t name_pos = 0;
+				for (auto i_n = names.begin(); i_n != names.end(); ++i_n)
+				{
+					index_cache_name rec = { i_n->second, name_pos, (uint32_t) i_n->first.size() };
+					put(&rec, sizeof rec);
+					name_pos += i_n->first.size();
+				}
+				pad_to(h.name_chars_off);
+				for (auto i_n = names.begin(); i_n != names.end(); ++i_n)
+				{
+					put(i_n->first.data(), i_n->first.size());
+				}
+				pad_to(h.refs_off);
+				if (!refs.empty()) put(&refs[0], refs.size() * sizeof refs[0]);
+				put(fa.cu_offsets, fa.n_cus * sizeof (Dwarf_Off));
+				put(fa.starts, (fa.n_cus + 1) * sizeof (uint64_t));
+				put(fa.words, h.nfilter_words * sizeof (uint64_t));
+				assert(written == h.file_size);
+				if (!out)
+				{
+					debug(1) << "Error writing index cache file " << tmp_path << endl;
+					unlink(tmp_path.c_str());
+					return false;
+				}
+			}
+			if (0 != rename(tmp_path.c_str(), path.c_str()))
+			{
+				debug(1) << "Could not rename index cache file to " << path
+					<< ": " << strerror(errno) << endl;
+				unlink(tmp_path.c_str());
+				return false;
+			}
+			debug(2) << "Saved index cache to " << path << " (" << h.ndies << " DIEs, "
+				<< h.nnames << " names, " << h.nrefs << " references, "
+				<< h.nfilter_cus << " name filters)" << endl;
+			return true;
+		}
+
+		bool root_die::load_index_cache(const string& path_arg /* = string() */)
+		{
+			guard g(*this);
+			if (!p_native) return false;
+			string path = path_arg.empty() ? default_index_cache_path() : path_arg;
+			if (path.empty()) return false;
+
+			int fd = open(path.c_str(), O_RDONLY);
+			if (fd == -1) return false;
+			struct stat st;
+			if (0 != fstat(fd, &st) || (size_t) st.st_size < sizeof (index_cache_header))
+			{
+				close(fd);
+				return false;
+			}
+			size_t len = st.st_size;
+			void *mapping = mmap(nullptr, len, PROT_READ, MAP_PRIVATE, fd, 0);
+			close(fd);
+			if (mapping == MAP_FAILED) return false;
+			std::shared_ptr<const void> p_mapping(mapping, [len](const void *p) {
+				munmap(const_cast<void *>(p), len);
+			});
+			const unsigned char *base = static_cast<const unsigned char *>(mapping);
+
+			const index_cache_header& h = *static_cast<const index_cache_header *>(mapping);
+			index_cache_header expected;
+			fill_key(*p_native, expected);
+			if (!same_key(h, expected) || h.file_size != len)
+			{
+				debug(1) << "Index cache " << path << " is stale; ignoring it" << endl;
+				return false;
+			}
+			/* Check everything is within the file, and aligned, before we
+			 * look at it; then check the contents before we trust them.
+			 * If anything's wrong, our caller builds afresh. */
+			uint64_t layout[6];
+			if (h.ndies >= topology_index::NONE || h.ndies > len || h.nfilter_cus > len
+				|| h.topology_off % 8 != 0 || h.names_off % 8 != 0 || h.refs_off % 8 != 0
+				|| h.filter_cu_offsets_off % 8 != 0 || h.filter_starts_off % 8 != 0
+				|| h.filter_words_off % 8 != 0
+				|| h.topology_off > len || topology_layout(h.ndies, h.topology_off, layout) > len
+				|| !fits(h.names_off, h.nnames, sizeof (index_cache_name), len)
+				|| !fits(h.name_chars_off, h.name_chars_len, 1, len)
+				|| !fits(h.refs_off, h.nrefs, sizeof (index_cache_ref), len)
+				|| !fits(h.filter_cu_offsets_off, h.nfilter_cus, sizeof (Dwarf_Off), len)
+				|| !fits(h.filter_starts_off, h.nfilter_cus + 1, sizeof (uint64_t), len)
+				|| !fits(h.filter_words_off, h.nfilter_words, sizeof (uint64_t), len))
+			{
+				debug(1) << "Index cache " << path << " is corrupt; ignoring it" << endl;
+				return false;
+			}
+			topology_index::arrays a = {
+				(topology_index::ordinal) h.ndies,
+				reinterpret_cast<const Dwarf_Off *>(base + layout[0]),
+				reinterpret_cast<const Dwarf_Half *>(base + layout[4]),
+				reinterpret_cast<const unsigned short *>(base + layout[5]),
+				reinterpret_cast<const topology_index::ordinal *>(base + layout[1]),
+				reinterpret_cast<const topology_index::ordinal *>(base + layout[2]),
+				reinterpret_cast<const topology_index::ordinal *>(base + layout[3])
+			};
+			cu_name_filters::arrays fa = {
+				h.nfilter_cus,
+				reinterpret_cast<const Dwarf_Off *>(base + h.filter_cu_offsets_off),
+				reinterpret_cast<const uint64_t *>(base + h.filter_starts_off),
+				reinterpret_cast<const uint64_t *>(base + h.filter_words_off)
+			};
+			if (!topology_is_sane(a) || !filters_are_sane(fa, h.nfilter_words))
+			{
+				debug(1) << "Index cache " << path << " is corrupt; ignoring it" << endl;
+				return false;
+			}
+
+			if (!p_topology) p_topology.reset(new topology_index(a, p_mapping));
+			if (!p_name_filters) p_name_filters.reset(new cu_name_filters(fa, p_mapping));
+			if (!visible_named_grandchildren_is_complete)
+			{
+				const index_cache_name *recs
+				 = reinterpret_cast<const index_cache_name *>(base + h.names_off);
+				const char *chars = reinterpret_cast<const char *>(base + h.name_chars_off);
+				visible_named_grandchildren_cache.clear();
+				for (uint64_t i = 0; i < h.nnames; ++i)
+				{
+					if ((uint64_t) recs[i].name_pos + recs[i].name_len > h.name_chars_len) continue;
+					visible_named_grandchildren_cache.insert(make_pair(
+						string(chars + recs[i].name_pos, recs[i].name_len), recs[i].die_off));
+				}
+				visible_named_grandchildren_is_complete = h.names_complete;
+			}
+			if (!refers_to_cache_is_complete)
+			{
+				const index_cache_ref *recs
+				 = reinterpret_cast<const index_cache_ref *>(base + h.refs_off);
+				refers_to.clear();
+				referred_from.clear();
+				for (uint64_t i = 0; i < h.nrefs; ++i)
+				{
+					auto k = make_pair((Dwarf_Off) recs[i].from, (Dwarf_Half) recs[i].attr);
+					refers_to[k] = recs[i].to;
+					referred_from.insert(make_pair((Dwarf_Off) recs[i].to, k));
+				}
+				refers_to_cache_is_complete = true;
+			}
+			debug(2) << "Loaded index cache from " << path << endl;
+			return true;
+		}
+
+		bool root_die::load_or_save_index_cache(const string& path /* = string() */)
+		{
+			return load_index_cache(path) || save_index_cache(path);
+		}
+	}
+}
@@ -21,7 +21,6 @@
 namespace dwarf
 {
 	using std::endl;
-	using std::dynamic_pointer_cast;
 	
 	namespace core
 	{
@@ -75,7 +74,7 @@ namespace dwarf
 				/* This means we *can* ask the payload. What will the 
 				 * payload do by default? Call the root, of course. 
 				 * (But some payloads might be smarter.) */
-				auto p_with = dynamic_pointer_cast<with_named_children_die>(cur_payload);
+				auto p_with = payload_cast<with_named_children_die>(cur_payload.get());
 				if (p_with)
 				{
 					return p_with->named_child(name);
@@ -100,6 +99,18 @@ namespace dwarf
 			if (!is_real_die_position()) return opt<string>();
 			return get_handle().get_name();
 		}
+		string_view
+		iterator_base::name_view_here() const
+		{
+			if (!is_real_die_position()) return string_view();
+			return get_handle().get_name_view();
+		}
+		block_view
+		iterator_base::block_view_here(Dwarf_Half attr) const
+		{
+			if (!is_real_die_position()) return block_view();
+			return get_handle().get_block_view(attr);
+		}
 		opt<string>
 		iterator_base::global_name_here() const
 		{
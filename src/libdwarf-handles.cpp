@@ -19,17 +19,66 @@
 #include "dwarfpp/iter-inl.hpp"
 #include "dwarfpp/dies.hpp"
 #include "dwarfpp/dies-inl.hpp"
+#include "dwarfpp/native.hpp"
 
 namespace dwarf
 {
 	namespace core
 	{
+		Die::handle_type::handle_type(raw_handle_type h, deleter d)
+		 : off(0UL), materialised(h), del(d)
+		{
+			if (h)
+			{
+				int ret = dwarf_dieoffset(h, &off, &current_dwarf_error);
+				assert(ret == DW_DLV_OK);
+			}
+		}
+		Die::raw_handle_type Die::handle_type::get() const
+		{
+			/* Payloads' handles are shared between threads, so even the
+			 * first look at "materialised" must be under the lock. (The
+			 * guard is free unless the root is concurrent.) */
+			if (del.p_constructing_root)
+			{
+				root_die::guard g(*del.p_constructing_root);
+				if (!materialised && off != 0UL && del.dbg)
+				{
+					int ret = dwarf_offdie(del.dbg, off, &materialised, &current_dwarf_error);
+					if (ret != DW_DLV_OK) materialised = nullptr;
+				}
+				return materialised;
+			}
+			if (!materialised && off != 0UL && del.dbg)
+			{
+				int ret = dwarf_offdie(del.dbg, off, &materialised, &current_dwarf_error);
+				if (ret != DW_DLV_OK) materialised = nullptr;
+			}
+			return materialised;
+		}
+#if DWARFPP_NATIVE_DECODER
+		const native::image *Die::native_image() const
+		{
+			root_die *p_r = handle.get_deleter().p_constructing_root;
+			return p_r ? p_r->get_native_image() : nullptr;
+		}
+#endif
 		Die::handle_type 
 		Die::try_construct(root_die& r, const iterator_base& it) /* siblingof */
 		{
+			root_die::guard g(r);
 			raw_handle_type returned;
-			if (!dynamic_cast<Die *>(&it.get_handle())) return handle_type(nullptr, deleter(nullptr, r));
-			int ret = dwarf_siblingof(r.dbg.handle.get(), dynamic_cast<Die&>(it.get_handle()).handle.get(), 
+			if (!it.get_handle().as_libdwarf_die()) return handle_type(nullptr, deleter(nullptr, r));
+#if DWARFPP_NATIVE_DECODER
+			if (r.get_native_image())
+			{
+				Dwarf_Off next = r.get_native_image()->next_sibling(
+					it.get_handle().as_libdwarf_die()->offset_here());
+				if (next) return handle_type(next, deleter(r.dbg.handle.get(), r));
+				else return handle_type(nullptr, deleter(nullptr, r));
+			}
+#endif
+			int ret = dwarf_siblingof(r.dbg.handle.get(), it.get_handle().as_libdwarf_die()->handle.get(), 
 			    &returned, &current_dwarf_error);
 			if (ret == DW_DLV_OK) return handle_type(returned, deleter(r.dbg.handle.get(), r));
 			else return handle_type(nullptr, deleter(nullptr, r));
@@ -37,8 +86,18 @@ namespace dwarf
 		Die::handle_type 
 		Die::try_construct(root_die& r) /* siblingof in "first DIE of current CU" case */
 		{
+			root_die::guard g(r);
 			raw_handle_type returned;
 			if (!r.dbg.handle) return handle_type(nullptr, deleter(nullptr, r));
+#if DWARFPP_NATIVE_DECODER
+			/* libdwarf's current CU is the one ending at its "next CU header". */
+			if (r.get_native_image() && r.last_seen_next_cu_header)
+			{
+				Dwarf_Off cu_off = r.get_native_image()->cu_offset_for_next_header(
+					*r.last_seen_next_cu_header);
+				if (cu_off) return handle_type(cu_off, deleter(r.dbg.handle.get(), r));
+			}
+#endif
 			int ret = dwarf_siblingof(r.dbg.handle.get(), nullptr, &returned, &current_dwarf_error);
 			if (ret == DW_DLV_OK) return handle_type(returned, deleter(r.dbg.handle.get(), r));
 			else return handle_type(nullptr, deleter(nullptr, r));
@@ -48,16 +107,34 @@ namespace dwarf
 		{
 			raw_handle_type returned;
 			root_die& r = it.get_root();
-			if (!dynamic_cast<Die *>(&it.get_handle())) return handle_type(nullptr, deleter(nullptr, r));
-			int ret = dwarf_child(dynamic_cast<Die&>(it.get_handle()).handle.get(), &returned, &current_dwarf_error);
+			root_die::guard g(r);
+			if (!it.get_handle().as_libdwarf_die()) return handle_type(nullptr, deleter(nullptr, r));
+#if DWARFPP_NATIVE_DECODER
+			if (r.get_native_image())
+			{
+				Dwarf_Off child = r.get_native_image()->first_child(
+					it.get_handle().as_libdwarf_die()->offset_here());
+				if (child) return handle_type(child, deleter(r.dbg.handle.get(), r));
+				else return handle_type(nullptr, deleter(nullptr, r));
+			}
+#endif
+			int ret = dwarf_child(it.get_handle().as_libdwarf_die()->handle.get(), &returned, &current_dwarf_error);
 			if (ret == DW_DLV_OK) return handle_type(returned, deleter(it.get_root().dbg.handle.get(), r));
 			else return handle_type(nullptr, deleter(nullptr, r));
 		}
 		Die::handle_type 
 		Die::try_construct(root_die& r, Dwarf_Off off) /* offdie */
 		{
+			root_die::guard g(r);
 			raw_handle_type returned;
 			if (!r.dbg.handle) return handle_type(nullptr, deleter(nullptr, r));
+#if DWARFPP_NATIVE_DECODER
+			if (r.get_native_image())
+			{
+				if (r.get_native_image()->is_die_offset(off)) return handle_type(off, deleter(r.dbg.handle.get(), r));
+				else return handle_type(nullptr, deleter(nullptr, r));
+			}
+#endif
 			int ret = dwarf_offdie(r.dbg.handle.get(), off, &returned, &current_dwarf_error);
 			if (ret == DW_DLV_OK) return handle_type(returned, deleter(r.dbg.handle.get(), r));
 			else return handle_type(nullptr, deleter(nullptr, r));
@@ -77,6 +154,7 @@ namespace dwarf
 		 : handle(try_construct(r, it))
 		{ 
 			if (!this->handle) throw Error(current_dwarf_error, 0);
+			root_die::guard g(r);
 			// also update the parent cache and sibling cache.
 			// 1. "it"'s parent is our parent; what is "it"'s parent?
 			Dwarf_Off off = this->offset_here();
@@ -103,6 +181,7 @@ namespace dwarf
 		 : handle(try_construct(r))
 		{ 
 			if (!this->handle) throw Error(current_dwarf_error, 0); 
+			root_die::guard g(r);
 			// update parent cache
 			Dwarf_Off off = this->offset_here();
 			r.parent_of[off] = 0UL; // FIXME: looks wrong
@@ -119,12 +198,43 @@ namespace dwarf
 		{
 			root_die& r = it.get_root();
 			if (!this->handle) throw Error(current_dwarf_error, 0);
+			root_die::guard g(r);
 			Dwarf_Off off = this->offset_here();
 			r.parent_of[off] = it.offset_here();
 			// first_child_of, next_sibling_of
 			r.first_child_of[it.offset_here()] = off;
 		}
 		
+		void Die::deleter::operator()(raw_handle_type arg) const
+		{
+			if (!dbg) { assert(!arg); return; }
+			if (!arg) return;
+			if (p_constructing_root)
+			{
+				root_die::guard g(*p_constructing_root);
+				dwarf_dealloc(dbg, arg, DW_DLA_DIE);
+			}
+			else dwarf_dealloc(dbg, arg, DW_DLA_DIE);
+		}
+		void string_deleter::operator()(const char *arg) const
+		{
+			if (borrowed) return;
+			if (!dbg) { assert(!arg); return; }
+			if (!arg) return;
+			void *p = const_cast<void*>(static_cast<const void *>(arg));
+			if (p_root)
+			{
+				root_die::guard g(*p_root);
+				dwarf_dealloc(dbg, p, DW_DLA_STRING);
+			}
+			else dwarf_dealloc(dbg, p, DW_DLA_STRING);
+		}
+		encap::attribute_map Die::copy_attrs() const
+		{
+			root_die::guard g(get_constructing_root());
+			return encap::attribute_map(AttributeList(*this), *this, get_constructing_root());
+		}
+		
 		spec& Die::spec_here() const
 		{
 			// HACK: avoid creating any payload for now, for speed-testing
@@ -205,13 +315,14 @@ namespace dwarf
 		}
 		Dwarf_Off Die::offset_here() const
 		{
-			Dwarf_Off off;
-			int ret = dwarf_dieoffset(raw_handle(), &off, &current_dwarf_error);
-			assert(ret == DW_DLV_OK);
-			return off;
+			return handle.off; // handle_type always knows it
 		}
 		Dwarf_Half Die::tag_here() const
 		{
+#if DWARFPP_NATIVE_DECODER
+			if (native_image()) return native_image()->tag(handle.off);
+#endif
+			root_die::guard g(get_constructing_root());
 			Dwarf_Half tag;
 			int ret = dwarf_tag(handle.get(), &tag, &current_dwarf_error);
 			assert(ret == DW_DLV_OK);
@@ -220,17 +331,76 @@ namespace dwarf
 		std::unique_ptr<const char, string_deleter>
 		Die::name_here() const
 		{
+#if DWARFPP_NATIVE_DECODER
+			if (native_image())
+			{
+				const char *str = native_image()->name(handle.off);
+				if (!str) return nullptr;
+				return unique_ptr<const char, string_deleter>(str, string_deleter::borrowing());
+			}
+#endif
+			root_die::guard g(get_constructing_root());
 			char *str;
 			int ret = dwarf_diename(raw_handle(), &str, &current_dwarf_error);
 			if (ret == DW_DLV_NO_ENTRY) return nullptr;
 			if (ret == DW_DLV_OK) return unique_ptr<const char, string_deleter>(
-				str, string_deleter(get_dbg()));
+				str, string_deleter(get_dbg(), handle.get_deleter().p_constructing_root));
 			//debug() << "Aborting with " << ret << " from dwarf_diename ("
 			//	<< dwarf_errormsg(current_dwarf_error) << ")" << std::endl; 
 			abort();
 		}
+		string_view Die::get_name_view() const
+		{
+#if DWARFPP_NATIVE_DECODER
+			if (native_image())
+			{
+				const char *str = native_image()->name(handle.off);
+				return str ? string_view(str) : string_view();
+			}
+#endif
+			/* libdwarf's string is ours to free, so the root keeps a copy. */
+			auto name = name_here();
+			if (!name) return string_view();
+			return get_constructing_root().intern_string(name.get());
+		}
+		block_view Die::get_block_view(Dwarf_Half attr) const
+		{
+#if DWARFPP_NATIVE_DECODER
+			if (native_image())
+			{
+				native::raw_attr raw;
+				if (!native_image()->fetch_attr(handle.off, attr, raw) || !raw) return block_view();
+				return native_image()->block_value(raw);
+			}
+#endif
+			root_die::guard g(get_constructing_root());
+			if (!has_attr_here(attr)) return block_view();
+			Attribute a(*this, attr);
+			Dwarf_Half form;
+			int ret = dwarf_whatform(a.handle.get(), &form, &current_dwarf_error);
+			if (ret != DW_DLV_OK) return block_view();
+			/* Either way, the bytes are in libdwarf's copy of the section,
+			 * which lasts as long as our root, so they outlive the handles. */
+			if (form == DW_FORM_exprloc)
+			{
+				Dwarf_Unsigned len;
+				Dwarf_Ptr ptr;
+				ret = dwarf_formexprloc(a.handle.get(), &len, &ptr, &current_dwarf_error);
+				if (ret != DW_DLV_OK) return block_view();
+				const unsigned char *begin = static_cast<const unsigned char *>(ptr);
+				return block_view(begin, begin + len);
+			}
+			auto h = Block::try_construct(a);
+			if (!h) return block_view();
+			const unsigned char *begin = static_cast<const unsigned char *>(h->bl_data);
+			return block_view(begin, begin + h->bl_len);
+		}
 		bool Die::has_attr_here(Dwarf_Half attr) const
 		{
+#if DWARFPP_NATIVE_DECODER
+			if (native_image()) return native_image()->has_attr(handle.off, attr);
+#endif
+			root_die::guard g(get_constructing_root());
 			Dwarf_Bool returned;
 			int ret = dwarf_hasattr(raw_handle(), attr, &returned, &current_dwarf_error);
 			assert(ret == DW_DLV_OK);
@@ -240,6 +410,10 @@ namespace dwarf
 		// dwarf_CU_dieoffset_given_die -- gives you the CU of a DIE
 		Dwarf_Off Die::enclosing_cu_offset_here() const
 		{
+#if DWARFPP_NATIVE_DECODER
+			if (native_image()) return native_image()->enclosing_cu_offset(handle.off);
+#endif
+			root_die::guard g(get_constructing_root());
 			Dwarf_Off cu_offset;
 			int ret = dwarf_CU_dieoffset_given_die(raw_handle(),
 				&cu_offset, &current_dwarf_error);
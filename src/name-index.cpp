@@ -0,0 +1,1084 @@
+/* dwarfpp: C++ binding for a useful subset of libdwarf, plus extra goodies.
+ *
+ * name-index.cpp: indexes of the names visible from the root
+ *
+ * Copyright (c) 2008--17, Stephen Kell. For licensing information, see the
+ * LICENSE file in the root of the libdwarfpp tree.
+ */
+
+#include "dwarfpp/name-index.hpp"
+#include "dwarfpp/native.hpp"
+#include "dwarfpp/root.hpp"
+#include "dwarfpp/root-inl.hpp"
+#include "dwarfpp/iter.hpp"
+#include "dwarfpp/iter-inl.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <thread>
+#include <srk31/endian.hpp>
+
+#ifndef DW_IDX_compile_unit
+#define DW_IDX_compile_unit 1
+#define DW_IDX_type_unit 2
+#define DW_IDX_die_offset 3
+#endif
+
+namespace dwarf
+{
+	namespace core
+	{
+		using native::read_fixed;
+		using native::read_sized;
+		using native::read_uleb128;
+		using native::read_sleb128;
+
+		/* The DIE's name, if it has one and isn't DW_VIS_local. */
+		static const char *visible_name(const native::image& img, Dwarf_Off off)
+		{
+			const char *name = img.name(off);
+			if (!name) return nullptr;
+			native::raw_attr vis;
+			if (img.fetch_attr(off, DW_AT_visibility, vis) && vis)
+			{
+				opt<Dwarf_Unsigned> v = img.unsigned_value(vis);
+				if (v && *v == DW_VIS_local) return nullptr;
+			}
+			return name;
+		}
+
+		/* Call f(ordinal, name) for each of the CU's children with a visible
+		 * name, in order. */
+		template <typename F>
+		static void for_each_visible_child(const native::image& img, const topology_index& t,
+			topology_index::ordinal cu, F f)
+		{
+			for (auto c = t.first_child(cu); c != topology_index::NONE; c = t.next_sibling(c))
+			{
+				const char *name = visible_name(img, t.offset(c));
+				if (name) f(c, string_view(name));
+			}
+		}
+
+		/* The same, through the iterators. */
+		template <typename F>
+		static void for_each_visible_child(root_die& r, const topology_index& t,
+			topology_index::ordinal cu, F f)
+		{
+			for (auto c = t.first_child(cu); c != topology_index::NONE; c = t.next_sibling(c))
+			{
+				iterator_base i = r.pos(t.offset(c), 2, t.offset(cu));
+				/* libdwarf's names are interned by the root, so they last. */
+				string_view name = i.name_view_here();
+				if (!name.data()) continue;
+				if (i.has_attr_here(DW_AT_visibility)
+					&& i.attr(DW_AT_visibility).get_unsigned() == DW_VIS_local) continue;
+				f(c, name);
+			}
+		}
+
+		uint32_t name_index::hash(string_view s)
+		{
+			uint32_t h = 5381;
+			for (auto i_c = s.begin(); i_c != s.end(); ++i_c) h = h * 33 + (unsigned char) *i_c;
+			return h;
+		}
+
+		void name_index::insert(const slot& s)
+		{
+			size_t mask = slots.size() - 1;
+			size_t i = s.hash & mask;
+			while (slots[i].name) i = (i + 1) & mask;
+			slots[i] = s;
+		}
+
+		void name_index::index_pieces(vector<piece>& pieces)
+		{
+			n = 0;
+			for (auto i_p = pieces.begin(); i_p != pieces.end(); ++i_p) n += i_p->size();
+			size_t nslots = 16;
+			while (nslots < 2 * n) nslots *= 2;
+			slots.assign(nslots, slot());
+			/* Pieces are in CU order and each is in ordinal order, so
+			 * equal names go in (and are probed) in ordinal order. */
+			for (auto i_p = pieces.begin(); i_p != pieces.end(); ++i_p)
+			{
+				for (auto i_s = i_p->begin(); i_s != i_p->end(); ++i_s) insert(*i_s);
+				*i_p = piece();
+			}
+		}
+
+		name_index::name_index(const native::image& img, const topology_index& t, unsigned nthreads)
+		{
+			vector<ordinal> cus;
+			for (ordinal cu = t.first_top_level(); cu != topology_index::NONE; cu = t.next_sibling(cu))
+			{
+				cus.push_back(cu);
+			}
+			if (nthreads == 0) nthreads = std::max(1u, std::thread::hardware_concurrency());
+			vector<piece> pieces(cus.size());
+			parallel_for_each_index(cus.size(), nthreads, [&img, &t, &cus, &pieces](size_t i) {
+				for_each_visible_child(img, t, cus[i], [&pieces, i](ordinal c, string_view name) {
+					pieces[i].push_back(slot { hash(name), (uint32_t) name.size(), name.data(), c });
+				});
+			});
+			index_pieces(pieces);
+		}
+
+		name_index::name_index(root_die& r, const topology_index& t)
+		{
+			vector<piece> pieces;
+			for (ordinal cu = t.first_top_level(); cu != topology_index::NONE; cu = t.next_sibling(cu))
+			{
+				pieces.push_back(piece());
+				for_each_visible_child(r, t, cu, [&pieces](ordinal c, string_view name) {
+					pieces.back().push_back(slot { hash(name), (uint32_t) name.size(), name.data(), c });
+				});
+			}
+			index_pieces(pieces);
+		}
+
+		void name_index::find(string_view name, vector<ordinal>& out) const
+		{
+			if (slots.empty()) return;
+			uint32_t h = hash(name);
+			size_t mask = slots.size() - 1;
+			/* Everything with this name is in the run of full slots that
+			 * starts at its home slot, in the order it went in. */
+			for (size_t i = h & mask; slots[i].name; i = (i + 1) & mask)
+			{
+				const slot& s = slots[i];
+				if (s.hash == h && s.len == name.size()
+					&& 0 == memcmp(s.name, name.data(), s.len)) out.push_back(s.o);
+			}
+		}
+
+		void sorted_name_table::index_pieces(vector<piece>& pieces)
+		{
+			piece all;
+			size_t n = 0;
+			for (auto i_p = pieces.begin(); i_p != pieces.end(); ++i_p) n += i_p->size();
+			all.reserve(n);
+			for (auto i_p = pieces.begin(); i_p != pieces.end(); ++i_p)
+			{
+				all.insert(all.end(), i_p->begin(), i_p->end());
+				*i_p = piece();
+			}
+			/* By name, then ordinal, so each name's DIEs come out in order. */
+			std::sort(all.begin(), all.end());
+			names.clear();
+			starts.assign(1, 0);
+			ordinals.clear();
+			ordinals.reserve(all.size());
+			for (auto i_e = all.begin(); i_e != all.end(); ++i_e)
+			{
+				if (names.empty() || names.back() != i_e->first)
+				{
+					if (!names.empty()) starts.push_back(ordinals.size());
+					names.push_back(i_e->first);
+				}
+				ordinals.push_back(i_e->second);
+			}
+			if (!names.empty()) starts.push_back(ordinals.size());
+		}
+
+		sorted_name_table::sorted_name_table(const native::image& img, const topology_index& t,
+			unsigned nthreads)
+		{
+			vector<ordinal> cus;
+			for (ordinal cu = t.first_top_level(); cu != topology_index::NONE; cu = t.next_sibling(cu))
+			{
+				cus.push_back(cu);
+			}
+			if (nthreads == 0) nthreads = std::max(1u, std::thread::hardware_concurrency());
+			vector<piece> pieces(cus.size());
+			parallel_for_each_index(cus.size(), nthreads, [&img, &t, &cus, &pieces](size_t i) {
+				for_each_visible_child(img, t, cus[i], [&pieces, i](ordinal c, string_view name) {
+					pieces[i].push_back(std::make_pair(name, c));
+				});
+			});
+			index_pieces(pieces);
+		}
+
+		sorted_name_table::sorted_name_table(root_die& r, const topology_index& t)
+		{
+			vector<piece> pieces;
+			for (ordinal cu = t.first_top_level(); cu != topology_index::NONE; cu = t.next_sibling(cu))
+			{
+				pieces.push_back(piece());
+				for_each_visible_child(r, t, cu, [&pieces](ordinal c, string_view name) {
+					pieces.back().push_back(std::make_pair(name, c));
+				});
+			}
+			index_pieces(pieces);
+		}
+
+		size_t sorted_name_table::footprint() const
+		{
+			return names.capacity() * sizeof (string_view)
+				+ starts.capacity() * sizeof (uint32_t)
+				+ ordinals.capacity() * sizeof (ordinal);
+		}
+
+		std::pair<size_t, size_t> sorted_name_table::prefix_range(string_view prefix) const
+		{
+			auto begin = std::lower_bound(names.begin(), names.end(), prefix);
+			/* The names with the prefix are a run starting there. */
+			auto end = std::partition_point(begin, names.end(), [prefix](string_view name) {
+				return name.substr(0, prefix.size()) == prefix;
+			});
+			return std::make_pair(begin - names.begin(), end - names.begin());
+		}
+
+		void sorted_name_table::append_dies(size_t begin, size_t end, vector<ordinal>& out) const
+		{
+			size_t first_out = out.size();
+			for (size_t i = begin; i < end; ++i)
+			{
+				out.insert(out.end(), ordinals.begin() + starts[i], ordinals.begin() + starts[i + 1]);
+			}
+			std::sort(out.begin() + first_out, out.end());
+		}
+
+		void sorted_name_table::find_prefix(string_view prefix, vector<ordinal>& out) const
+		{
+			auto r = prefix_range(prefix);
+			append_dies(r.first, r.second, out);
+		}
+
+		void sorted_name_table::find_glob(string_view pattern, vector<ordinal>& out) const
+		{
+			auto r = prefix_range(glob_literal_prefix(pattern));
+			size_t first_out = out.size();
+			for (size_t i = r.first; i < r.second; ++i)
+			{
+				if (!glob_match(pattern, names[i])) continue;
+				out.insert(out.end(), ordinals.begin() + starts[i], ordinals.begin() + starts[i + 1]);
+			}
+			std::sort(out.begin() + first_out, out.end());
+		}
+
+		std::string sorted_name_table::glob_literal_prefix(string_view pattern)
+		{
+			std::string prefix;
+			for (size_t i = 0; i < pattern.size(); ++i)
+			{
+				if (pattern[i] == '*' || pattern[i] == '?') break;
+				if (pattern[i] == '\\' && i + 1 < pattern.size()) ++i;
+				prefix.push_back(pattern[i]);
+			}
+			return prefix;
+		}
+
+		bool sorted_name_table::glob_match(string_view pattern, string_view s)
+		{
+			/* The usual greedy match: on a mismatch, let the most recent
+			 * star eat one more character and try again from there. */
+			size_t p = 0, i = 0;
+			size_t star_p = string_view::npos, star_i = 0;
+			while (i < s.size())
+			{
+				if (p < pattern.size() && pattern[p] == '*')
+				{
+					star_p = p++;
+					star_i = i;
+					continue;
+				}
+				if (p < pattern.size() && pattern[p] == '?') { ++p; ++i; continue; }
+				size_t lit = (p + 1 < pattern.size() && pattern[p] == '\\') ? p + 1 : p;
+				if (lit < pattern.size() && pattern[lit] == s[i]) { p = lit + 1; ++i; continue; }
+				if (star_p == string_view::npos) return false;
+				p = star_p + 1;
+				i = ++star_i;
+			}
+			while (p < pattern.size() && pattern[p] == '*') ++p;
+			return p == pattern.size();
+		}
+
+		/* When a DIE without a DW_AT_linkage_name has its name as its symbol
+		 * (see compile_unit_die::mangled_name_for()): always in C, and in
+		 * C++ only where the name is plainly not mangled. */
+		enum plain_names { NO_PLAIN_NAMES, PLAIN_NAMES, UNMANGLED_PLAIN_NAMES };
+		static plain_names plain_names_for(Dwarf_Unsigned lang)
+		{
+			switch (lang)
+			{
+				case DW_LANG_C:
+				case DW_LANG_C89:
+#ifdef DW_LANG_C99
+				case DW_LANG_C99:
+#endif
+#ifdef DW_LANG_C11
+				case DW_LANG_C11:
+#endif
+					return PLAIN_NAMES;
+				case DW_LANG_C_plus_plus:
+#ifdef DW_LANG_C_plus_plus_03
+				case DW_LANG_C_plus_plus_03:
+#endif
+#ifdef DW_LANG_C_plus_plus_11
+				case DW_LANG_C_plus_plus_11:
+#endif
+#ifdef DW_LANG_C_plus_plus_14
+				case DW_LANG_C_plus_plus_14:
+#endif
+#ifdef DW_LANG_C_plus_plus_17
+				case DW_LANG_C_plus_plus_17:
+#endif
+					return UNMANGLED_PLAIN_NAMES;
+				default:
+					return NO_PLAIN_NAMES;
+			}
+		}
+
+		/* Whether a location expression starting with this op is a static
+		 * address, i.e. the variable has a symbol. */
+		static bool is_static_address_op(unsigned char op)
+		{
+			switch (op)
+			{
+				case DW_OP_addr:
+#ifdef DW_OP_addrx
+				case DW_OP_addrx:
+#endif
+#ifdef DW_OP_GNU_addr_index
+				case DW_OP_GNU_addr_index:
+#endif
+					return true;
+				default:
+					return false;
+			}
+		}
+
+		/* The name of the symbol the DIE stands for, as get_linkage_name()
+		 * would have it, or null if it doesn't stand for one. Local symbols
+		 * count, so a name may have a definition in each of several CUs. */
+		static const char *symbol_name(const native::image& img, const topology_index& t,
+			topology_index::ordinal o, plain_names plain)
+		{
+			Dwarf_Off off = t.offset(o);
+			Dwarf_Half tag = t.tag(o);
+			native::raw_attr a;
+			if (img.fetch_attr(off, DW_AT_declaration, a) && a)
+			{
+				opt<bool> is_declaration = img.flag_value(a);
+				if (is_declaration && *is_declaration) return nullptr;
+			}
+			/* Abstract instances of inlined subprograms have no code. */
+			if (tag == DW_TAG_subprogram && !(img.fetch_attr(off, DW_AT_low_pc, a) && a)
+				&& !(img.fetch_attr(off, DW_AT_ranges, a) && a)) return nullptr;
+			if (tag == DW_TAG_variable)
+			{
+				if (!img.fetch_attr(off, DW_AT_location, a) || !a) return nullptr;
+				block_view expr = img.block_value(a);
+				if (!expr.data() || expr.empty() || !is_static_address_op(expr[0])) return nullptr;
+			}
+			/* Follow whatever we complete or instantiate, as find_all_attrs() does. */
+			opt<Dwarf_Unsigned> visibility;
+			bool external = false;
+			Dwarf_Off cur = off;
+			for (unsigned hops = 0; cur != 0 && hops < 8; ++hops)
+			{
+				Dwarf_Half linkage_attrs[] = { DW_AT_linkage_name, DW_AT_MIPS_linkage_name };
+				for (Dwarf_Half attr : linkage_attrs)
+				{
+					if (!img.fetch_attr(cur, attr, a) || !a) continue;
+					const char *linkage_name = img.string_value(a);
+					if (linkage_name) return linkage_name;
+				}
+				if (!visibility && img.fetch_attr(cur, DW_AT_visibility, a) && a)
+				{
+					visibility = img.unsigned_value(a);
+				}
+				if (!external && img.fetch_attr(cur, DW_AT_external, a) && a)
+				{
+					opt<bool> is_external = img.flag_value(a);
+					external = is_external && *is_external;
+				}
+				opt<Dwarf_Off> next;
+				if (img.fetch_attr(cur, DW_AT_specification, a) && a) next = img.ref_value(a);
+				else if (img.fetch_attr(cur, DW_AT_abstract_origin, a) && a) next = img.ref_value(a);
+				cur = next ? *next : 0;
+			}
+			/* Otherwise it's our own name, if we're not hidden, and if the
+			 * language doesn't mangle it (see default_cxx_mangle()). */
+			const char *name = img.name(off);
+			if (!name || (visibility && *visibility != DW_VIS_exported)) return nullptr;
+			switch (plain)
+			{
+				case PLAIN_NAMES: return name;
+				case UNMANGLED_PLAIN_NAMES:
+					if (string_view(name) == "main") return name;
+					if (t.depth(o) != 2 || !external) return nullptr;
+					if (tag == DW_TAG_subprogram)
+					{
+						for (auto c = t.first_child(o); c != topology_index::NONE; c = t.next_sibling(c))
+						{
+							if (t.tag(c) == DW_TAG_formal_parameter) return nullptr;
+						}
+					}
+					return name;
+				default: return nullptr;
+			}
+		}
+
+		/* Call f(ordinal, name) for each DIE in the CU that defines a symbol,
+		 * in ordinal order. Its subtree is a run of ordinals. */
+		template <typename F>
+		static void for_each_symbol(const native::image& img, const topology_index& t,
+			topology_index::ordinal cu, F f)
+		{
+			native::raw_attr lang;
+			opt<Dwarf_Unsigned> maybe_lang;
+			if (img.fetch_attr(t.offset(cu), DW_AT_language, lang) && lang)
+			{
+				maybe_lang = img.unsigned_value(lang);
+			}
+			plain_names plain = maybe_lang ? plain_names_for(*maybe_lang) : NO_PLAIN_NAMES;
+			topology_index::ordinal end = cu + t.subtree_size(cu);
+			for (topology_index::ordinal o = cu + 1; o < end; ++o)
+			{
+				if (t.tag(o) != DW_TAG_subprogram && t.tag(o) != DW_TAG_variable) continue;
+				const char *name = symbol_name(img, t, o, plain);
+				if (name) f(o, string_view(name));
+			}
+		}
+
+		/* The same, through the iterators. */
+		template <typename F>
+		static void for_each_symbol(root_die& r, const topology_index& t,
+			topology_index::ordinal cu, F f)
+		{
+			topology_index::ordinal end = cu + t.subtree_size(cu);
+			for (topology_index::ordinal o = cu + 1; o < end; ++o)
+			{
+				if (t.tag(o) != DW_TAG_subprogram && t.tag(o) != DW_TAG_variable) continue;
+				iterator_base i = r.pos(t.offset(o), t.depth(o), t.parent_offset(o));
+				/* As symbol_name() above, but through the iterator. */
+				if (i.has_attr_here(DW_AT_declaration) && i.attr(DW_AT_declaration).get_flag()) continue;
+				if (t.tag(o) == DW_TAG_subprogram
+					&& !i.has_attr_here(DW_AT_low_pc) && !i.has_attr_here(DW_AT_ranges)) continue;
+				if (t.tag(o) == DW_TAG_variable)
+				{
+					encap::attribute_value loc = i.attr(DW_AT_location);
+					if (!loc.is_loclist() || loc.get_loclist().empty()
+						|| loc.get_loclist().begin()->empty()
+						|| !is_static_address_op(loc.get_loclist().begin()->begin()->lr_atom)) continue;
+				}
+				opt<string> symbol = i.as_a<with_static_location_die>()->get_linkage_name();
+				if (!symbol) continue;
+				/* Names from libdwarf are interned by the root, so they last. */
+				f(o, r.intern_string(symbol->c_str()));
+			}
+		}
+
+		linkage_name_index::linkage_name_index(const native::image& img, const topology_index& t,
+			unsigned nthreads)
+		{
+			vector<ordinal> cus;
+			for (ordinal cu = t.first_top_level(); cu != topology_index::NONE; cu = t.next_sibling(cu))
+			{
+				cus.push_back(cu);
+			}
+			if (nthreads == 0) nthreads = std::max(1u, std::thread::hardware_concurrency());
+			vector<piece> pieces(cus.size());
+			parallel_for_each_index(cus.size(), nthreads, [&img, &t, &cus, &pieces](size_t i) {
+				for_each_symbol(img, t, cus[i], [&pieces, i](ordinal o, string_view name) {
+					pieces[i].push_back(slot { hash(name), (uint32_t) name.size(), name.data(), o });
+				});
+			});
+			index_pieces(pieces);
+		}
+
+		linkage_name_index::linkage_name_index(root_die& r, const topology_index& t)
+		{
+			vector<piece> pieces;
+			for (ordinal cu = t.first_top_level(); cu != topology_index::NONE; cu = t.next_sibling(cu))
+			{
+				pieces.push_back(piece());
+				for_each_symbol(r, t, cu, [&pieces](ordinal o, string_view name) {
+					pieces.back().push_back(slot { hash(name), (uint32_t) name.size(), name.data(), o });
+				});
+			}
+			index_pieces(pieces);
+		}
+
+		void linkage_name_index::find_in_cu(const native::image& img, const topology_index& t,
+			ordinal cu, string_view name, vector<ordinal>& out)
+		{
+			for_each_symbol(img, t, cu, [name, &out](ordinal o, string_view symbol) {
+				if (symbol == name) out.push_back(o);
+			});
+		}
+
+		void linkage_name_index::find_in_cu(root_die& r, const topology_index& t,
+			ordinal cu, string_view name, vector<ordinal>& out)
+		{
+			for_each_symbol(r, t, cu, [name, &out](ordinal o, string_view symbol) {
+				if (symbol == name) out.push_back(o);
+			});
+		}
+
+		/* Where a name's bits go: one word of the CU's filter, chosen by the
+		 * top half of a multiplicative mix of its hash, and four bits in that
+		 * word, chosen by four 6-bit fields of the bottom half. */
+		static uint64_t filter_mix(string_view name)
+		{
+			return (uint64_t) name_index::hash(name) * 0x9e3779b97f4a7c15ull;
+		}
+		static uint64_t filter_bits(uint64_t g)
+		{
+			return (1ull << (g & 63)) | (1ull << ((g >> 6) & 63))
+				| (1ull << ((g >> 12) & 63)) | (1ull << ((g >> 18) & 63));
+		}
+
+		void cu_name_filters::add_cu(Dwarf_Off cu_off, const vector<uint64_t>& mixes)
+		{
+			/* About ten bits per name, rounded up to a power of two words. */
+			size_t nwords = 1;
+			while (nwords * 64 < 10 * mixes.size()) nwords *= 2;
+			size_t start = words.size();
+			words.resize(start + nwords, 0);
+			for (auto i_m = mixes.begin(); i_m != mixes.end(); ++i_m)
+			{
+				words[start + ((*i_m >> 32) & (nwords - 1))] |= filter_bits(*i_m);
+			}
+			cu_offsets.push_back(cu_off);
+			starts.push_back(words.size());
+		}
+
+		void cu_name_filters::point_at_vectors()
+		{
+			a.n_cus = cu_offsets.size();
+			a.cu_offsets = cu_offsets.data();
+			a.starts = starts.data();
+			a.words = words.data();
+		}
+
+		cu_name_filters::cu_name_filters(const native::image& img, const topology_index& t,
+			unsigned nthreads)
+		{
+			vector<ordinal> cus;
+			for (ordinal cu = t.first_top_level(); cu != topology_index::NONE; cu = t.next_sibling(cu))
+			{
+				cus.push_back(cu);
+			}
+			if (nthreads == 0) nthreads = std::max(1u, std::thread::hardware_concurrency());
+			vector<vector<uint64_t> > mixes(cus.size());
+			parallel_for_each_index(cus.size(), nthreads, [&img, &t, &cus, &mixes](size_t i) {
+				for_each_visible_child(img, t, cus[i], [&mixes, i](ordinal c, string_view name) {
+					mixes[i].push_back(filter_mix(name));
+				});
+				for_each_symbol(img, t, cus[i], [&mixes, i](ordinal o, string_view name) {
+					mixes[i].push_back(filter_mix(name));
+				});
+			});
+			starts.push_back(0);
+			for (size_t i = 0; i < cus.size(); ++i)
+			{
+				add_cu(t.offset(cus[i]), mixes[i]);
+				mixes[i] = vector<uint64_t>();
+			}
+			point_at_vectors();
+		}
+
+		cu_name_filters::cu_name_filters(root_die& r, const topology_index& t)
+		{
+			starts.push_back(0);
+			for (ordinal cu = t.first_top_level(); cu != topology_index::NONE; cu = t.next_sibling(cu))
+			{
+				vector<uint64_t> mixes;
+				for_each_visible_child(r, t, cu, [&mixes](ordinal c, string_view name) {
+					mixes.push_back(filter_mix(name));
+				});
+				for_each_symbol(r, t, cu, [&mixes](ordinal o, string_view name) {
+					mixes.push_back(filter_mix(name));
+				});
+				add_cu(t.offset(cu), mixes);
+			}
+			point_at_vectors();
+		}
+
+		size_t cu_name_filters::footprint() const
+		{
+			return cu_offsets.capacity() * sizeof (Dwarf_Off)
+				+ (starts.capacity() + words.capacity()) * sizeof (uint64_t);
+		}
+
+		void cu_name_filters::candidate_cus(string_view name, vector<Dwarf_Off>& out) const
+		{
+			uint64_t g = filter_mix(name);
+			uint64_t bits = filter_bits(g);
+			for (size_t i = 0; i < a.n_cus; ++i)
+			{
+				uint64_t nwords = a.starts[i + 1] - a.starts[i];
+				uint64_t w = a.words[a.starts[i] + ((g >> 32) & (nwords - 1))];
+				if ((w & bits) == bits) out.push_back(a.cu_offsets[i]);
+			}
+		}
+
+		bool cu_name_filters::may_contain(Dwarf_Off cu_off, string_view name) const
+		{
+			const Dwarf_Off *found = std::lower_bound(a.cu_offsets, a.cu_offsets + a.n_cus, cu_off);
+			/* CUs we don't know about might contain anything. */
+			if (found == a.cu_offsets + a.n_cus || *found != cu_off) return true;
+			size_t i = found - a.cu_offsets;
+			uint64_t g = filter_mix(name);
+			uint64_t bits = filter_bits(g);
+			uint64_t nwords = a.starts[i + 1] - a.starts[i];
+			return (a.words[a.starts[i] + ((g >> 32) & (nwords - 1))] & bits) == bits;
+		}
+
+		/* Whether the string at s, which is terminated before end if it's
+		 * well-formed, is exactly name. */
+		static bool names_equal(const char *s, const unsigned char *end, string_view name)
+		{
+			return (size_t) (end - (const unsigned char *) s) > name.size()
+				&& 0 == memcmp(s, name.data(), name.size()) && s[name.size()] == '\0';
+		}
+
+		accelerator_tables::accelerator_tables(const native::image& img)
+		 : img(img), k(NONE), gdb()
+		{
+			if (read_debug_names()) k = DEBUG_NAMES;
+			else if (read_gdb_index()) k = GDB_INDEX;
+			else if (read_pubnames()) k = PUBNAMES;
+		}
+
+		bool accelerator_tables::read_debug_names()
+		{
+			const native::section& sec = img.debug_names_section();
+			if (!sec) return false;
+			const unsigned char *pos = sec.begin;
+			while (sec.end - pos >= 4)
+			{
+				names_unit u;
+				Dwarf_Unsigned length = read_fixed<uint32_t>(pos);
+				u.offset_size = 4;
+				if (length == 0xffffffffu)
+				{
+					if (sec.end - pos < 8) break;
+					length = read_fixed<uint64_t>(pos);
+					u.offset_size = 8;
+				}
+				else if (length >= 0xfffffff0u) break; // reserved
+				if (length > (Dwarf_Unsigned) (sec.end - pos) || length < 36) break;
+				u.end = pos + length;
+				uint16_t version = read_fixed<uint16_t>(pos);
+				if (version != 5) { pos = u.end; continue; }
+				pos += 2; // padding
+				u.comp_unit_count = read_fixed<uint32_t>(pos);
+				uint32_t local_type_unit_count = read_fixed<uint32_t>(pos);
+				uint32_t foreign_type_unit_count = read_fixed<uint32_t>(pos);
+				u.bucket_count = read_fixed<uint32_t>(pos);
+				u.name_count = read_fixed<uint32_t>(pos);
+				uint32_t abbrev_table_size = read_fixed<uint32_t>(pos);
+				uint32_t augmentation_string_size = read_fixed<uint32_t>(pos);
+				Dwarf_Unsigned augmentation_size = ((Dwarf_Unsigned) augmentation_string_size + 3) & ~3ull;
+				if (augmentation_size > (Dwarf_Unsigned) (u.end - pos)) { pos = u.end; continue; }
+				pos += augmentation_size;
+				/* Everything after the header is laid out back to back. If
+				 * there is no hash table, there are no hashes either. */
+				u.cu_list = pos;
+				Dwarf_Unsigned sizes[] = {
+					(Dwarf_Unsigned) u.comp_unit_count * u.offset_size,
+					(Dwarf_Unsigned) local_type_unit_count * u.offset_size
+						+ (Dwarf_Unsigned) foreign_type_unit_count * 8,
+					(Dwarf_Unsigned) u.bucket_count * 4,
+					u.bucket_count ? (Dwarf_Unsigned) u.name_count * 4 : 0,
+					(Dwarf_Unsigned) u.name_count * u.offset_size,
+					(Dwarf_Unsigned) u.name_count * u.offset_size,
+					abbrev_table_size
+				};
+				const unsigned char **starts[] = { nullptr, nullptr, &u.buckets, &u.hashes,
+					&u.str_offsets, &u.entry_offsets, nullptr };
+				bool fits = true;
+				for (unsigned i = 0; i < sizeof sizes / sizeof sizes[0]; ++i)
+				{
+					if (pos > u.end || sizes[i] > (Dwarf_Unsigned) (u.end - pos)) { fits = false; break; }
+					if (starts[i]) *starts[i] = pos;
+					pos += sizes[i];
+				}
+				if (!fits) { pos = u.end; continue; }
+				u.entry_pool = pos;
+				/* The abbreviations are what we need to read the entries. */
+				const unsigned char *abbrev_pos = u.entry_pool - abbrev_table_size;
+				const unsigned char *abbrev_end = u.entry_pool;
+				while (abbrev_pos < abbrev_end)
+				{
+					opt<Dwarf_Unsigned> code = read_uleb128(abbrev_pos, abbrev_end);
+					if (!code || *code == 0) break;
+					names_abbrev a;
+					opt<Dwarf_Unsigned> tag = read_uleb128(abbrev_pos, abbrev_end);
+					if (!tag) break;
+					a.tag = *tag;
+					bool terminated = false;
+					while (abbrev_pos < abbrev_end)
+					{
+						opt<Dwarf_Unsigned> idx = read_uleb128(abbrev_pos, abbrev_end);
+						opt<Dwarf_Unsigned> form = read_uleb128(abbrev_pos, abbrev_end);
+						if (!idx || !form) break;
+						if (*idx == 0 && *form == 0) { terminated = true; break; }
+						a.idx_forms.push_back(std::make_pair(*idx, *form));
+					}
+					/* An abbreviation cut short would misread its entries. */
+					if (!terminated) break;
+					u.abbrevs.insert(std::make_pair(*code, std::move(a)));
+				}
+				pos = u.end;
+				names_units.push_back(std::move(u));
+			}
+			return !names_units.empty();
+		}
+
+		bool accelerator_tables::read_gdb_index()
+		{
+			const native::section& sec = img.gdb_index_section();
+			/* It's always little-endian, whatever the target. */
+			if (!sec || sec.size() < 24 || !srk31::host_is_little_endian()) return false;
+			const unsigned char *pos = sec.begin;
+			uint32_t version = read_fixed<uint32_t>(pos);
+			/* Before version 5, the hash function was different. */
+			if (version < 5 || version > 8) return false;
+			uint32_t cu_list_offset = read_fixed<uint32_t>(pos);
+			uint32_t types_cu_list_offset = read_fixed<uint32_t>(pos);
+			uint32_t address_area_offset = read_fixed<uint32_t>(pos);
+			uint32_t symbol_table_offset = read_fixed<uint32_t>(pos);
+			uint32_t constant_pool_offset = read_fixed<uint32_t>(pos);
+			/* The areas come in this order, after the header, within the
+			 * section; so each table's extent is bounded by the next. */
+			if (cu_list_offset < 24
+				|| cu_list_offset > types_cu_list_offset
+				|| types_cu_list_offset > address_area_offset
+				|| address_area_offset > symbol_table_offset
+				|| symbol_table_offset > constant_pool_offset
+				|| constant_pool_offset > sec.size()) return false;
+			gdb.cu_list = sec.begin + cu_list_offset;
+			gdb.n_cus = (types_cu_list_offset - cu_list_offset) / 16;
+			gdb.symbol_table = sec.begin + symbol_table_offset;
+			gdb.n_slots = (constant_pool_offset - symbol_table_offset) / 8;
+			gdb.constant_pool = sec.begin + constant_pool_offset;
+			return gdb.n_slots > 0 && (gdb.n_slots & (gdb.n_slots - 1)) == 0;
+		}
+
+		bool accelerator_tables::read_pubnames()
+		{
+			const native::section *secs[] = { &img.pubnames_section(), &img.pubtypes_section() };
+			for (const native::section *p_sec : secs)
+			{
+				if (!*p_sec) continue;
+				const unsigned char *pos = p_sec->begin;
+				while (p_sec->end - pos >= 4)
+				{
+					/* Each CU's set is a header, then pairs of CU-relative DIE
+					 * offset and name, ending with a zero offset. */
+					Dwarf_Unsigned length = read_fixed<uint32_t>(pos);
+					unsigned offset_size = 4;
+					if (length == 0xffffffffu)
+					{
+						if (p_sec->end - pos < 8) break;
+						length = read_fixed<uint64_t>(pos);
+						offset_size = 8;
+					}
+					else if (length >= 0xfffffff0u) break;
+					if (length > (Dwarf_Unsigned) (p_sec->end - pos)
+						|| length < 2 + 2 * offset_size) break;
+					const unsigned char *set_end = pos + length;
+					read_fixed<uint16_t>(pos); // version
+					Dwarf_Off cu_off = read_sized(pos, offset_size);
+					read_sized(pos, offset_size); // the CU's length
+					while ((size_t) (set_end - pos) >= offset_size)
+					{
+						Dwarf_Off die_off = read_sized(pos, offset_size);
+						if (die_off == 0) break;
+						const char *name = reinterpret_cast<const char *>(pos);
+						size_t len = strnlen(name, set_end - pos);
+						if (len == (size_t) (set_end - pos)) break; // unterminated
+						pos += len + 1;
+						pub_entries.push_back(std::make_pair(string_view(name, len), cu_off + die_off));
+					}
+					pos = set_end;
+				}
+			}
+			std::sort(pub_entries.begin(), pub_entries.end());
+			return !pub_entries.empty();
+		}
+
+		/* DW_FORM_* values as they appear in .debug_names entries, not
+		 * reading past end. None if we can't. */
+		static opt<Dwarf_Unsigned> read_idx_value(Dwarf_Unsigned form, const unsigned char *& pos,
+			const unsigned char *end)
+		{
+			size_t avail = end - pos;
+			switch (form)
+			{
+				case DW_FORM_flag_present: return opt<Dwarf_Unsigned>(1);
+				case DW_FORM_flag:
+				case DW_FORM_data1:
+				case DW_FORM_ref1:
+					if (avail < 1) return opt<Dwarf_Unsigned>();
+					return opt<Dwarf_Unsigned>(read_fixed<uint8_t>(pos));
+				case DW_FORM_data2:
+				case DW_FORM_ref2:
+					if (avail < 2) return opt<Dwarf_Unsigned>();
+					return opt<Dwarf_Unsigned>(read_fixed<uint16_t>(pos));
+				case DW_FORM_data4:
+				case DW_FORM_ref4:
+					if (avail < 4) return opt<Dwarf_Unsigned>();
+					return opt<Dwarf_Unsigned>(read_fixed<uint32_t>(pos));
+				case DW_FORM_data8:
+				case DW_FORM_ref8:
+				case DW_FORM_ref_sig8:
+					if (avail < 8) return opt<Dwarf_Unsigned>();
+					return opt<Dwarf_Unsigned>(read_fixed<uint64_t>(pos));
+				case DW_FORM_udata:
+				case DW_FORM_ref_udata: return read_uleb128(pos, end);
+				case DW_FORM_sdata: {
+					opt<Dwarf_Signed> v = read_sleb128(pos, end);
+					return v ? opt<Dwarf_Unsigned>(*v) : opt<Dwarf_Unsigned>();
+				}
+				default: return opt<Dwarf_Unsigned>(); // can't skip it
+			}
+		}
+
+		void accelerator_tables::names_candidates(const names_unit& u, string_view name,
+			vector<Dwarf_Off>& dies) const
+		{
+			auto offset_at = [&u](const unsigned char *array, uint32_t i) -> Dwarf_Off {
+				const unsigned char *pos = array + (size_t) i * u.offset_size;
+				return read_sized(pos, u.offset_size);
+			};
+			const native::section& str = img.str_section();
+			auto name_is = [&](uint32_t i) -> bool {
+				Dwarf_Off str_off = offset_at(u.str_offsets, i);
+				return str_off < str.size()
+					&& names_equal(reinterpret_cast<const char *>(str.begin + str_off), str.end, name);
+			};
+			/* Find the name's slot, by hash if there's a table. The hash is
+			 * Bernstein's again, but of the case-folded name. */
+			opt<uint32_t> found;
+			if (u.bucket_count == 0)
+			{
+				for (uint32_t i = 0; i < u.name_count; ++i) if (name_is(i)) { found = i; break; }
+			}
+			else
+			{
+				uint32_t h = 5381;
+				for (auto i_c = name.begin(); i_c != name.end(); ++i_c)
+				{
+					unsigned char c = *i_c;
+					h = h * 33 + ((c >= 'A' && c <= 'Z') ? c - 'A' + 'a' : c);
+				}
+				uint32_t bucket = h % u.bucket_count;
+				const unsigned char *pos = u.buckets + (size_t) bucket * 4;
+				uint32_t first = read_fixed<uint32_t>(pos); // 1-based; 0 means empty
+				for (uint32_t i = first ? first - 1 : u.name_count; i < u.name_count; ++i)
+				{
+					pos = u.hashes + (size_t) i * 4;
+					uint32_t h_i = read_fixed<uint32_t>(pos);
+					if (h_i % u.bucket_count != bucket) break;
+					if (h_i == h && name_is(i)) { found = i; break; }
+				}
+			}
+			if (!found) return;
+
+			/* Its entries run until a zero abbreviation code. */
+			Dwarf_Off entry_off = offset_at(u.entry_offsets, *found);
+			if (entry_off >= (Dwarf_Off) (u.end - u.entry_pool)) return;
+			const unsigned char *pos = u.entry_pool + entry_off;
+			while (pos < u.end)
+			{
+				opt<Dwarf_Unsigned> code = read_uleb128(pos, u.end);
+				if (!code || *code == 0) break;
+				auto i_abbrev = u.abbrevs.find(*code);
+				if (i_abbrev == u.abbrevs.end()) return;
+				opt<Dwarf_Unsigned> cu;
+				opt<Dwarf_Unsigned> die_off;
+				bool in_type_unit = false;
+				for (auto i_f = i_abbrev->second.idx_forms.begin();
+					i_f != i_abbrev->second.idx_forms.end(); ++i_f)
+				{
+					opt<Dwarf_Unsigned> v = read_idx_value(i_f->second, pos, u.end);
+					if (!v) return;
+					switch (i_f->first)
+					{
+						case DW_IDX_compile_unit: cu = v; break;
+						case DW_IDX_type_unit: in_type_unit = true; break;
+						case DW_IDX_die_offset: die_off = v; break;
+						default: break;
+					}
+				}
+				if (in_type_unit || !die_off) continue;
+				/* With only one CU, entries needn't say which. */
+				if (!cu && u.comp_unit_count == 1) cu = 0;
+				if (!cu || *cu >= u.comp_unit_count) continue;
+				dies.push_back(offset_at(u.cu_list, *cu) + *die_off);
+			}
+		}
+
+		void accelerator_tables::gdb_index_candidates(string_view name, vector<Dwarf_Off>& cus) const
+		{
+			/* gdb's hash, case-insensitive since version 5. */
+			uint32_t h = 0;
+			for (auto i_c = name.begin(); i_c != name.end(); ++i_c)
+			{
+				unsigned char c = *i_c;
+				h = h * 67 + ((c >= 'A' && c <= 'Z') ? c - 'A' + 'a' : c) - 113;
+			}
+			uint32_t mask = gdb.n_slots - 1;
+			uint32_t step = ((h * 17) & mask) | 1;
+			const native::section& sec = img.gdb_index_section();
+			uint32_t i = h & mask;
+			for (uint32_t tries = 0; tries < gdb.n_slots; ++tries, i = (i + step) & mask)
+			{
+				const unsigned char *pos = gdb.symbol_table + (size_t) i * 8;
+				uint32_t name_off = read_fixed<uint32_t>(pos);
+				uint32_t vec_off = read_fixed<uint32_t>(pos);
+				if (name_off == 0 && vec_off == 0) return; // empty slot: not there
+				if (name_off >= (size_t) (sec.end - gdb.constant_pool)) return;
+				if (!names_equal(reinterpret_cast<const char *>(gdb.constant_pool + name_off),
+					sec.end, name)) continue;
+				/* The CU vector: a count, then CU indexes (with attributes
+				 * in the top byte). Indexes past the CUs are type units. */
+				if (vec_off + 4 > (size_t) (sec.end - gdb.constant_pool)) return;
+				pos = gdb.constant_pool + vec_off;
+				uint32_t count = read_fixed<uint32_t>(pos);
+				if (count > (size_t) (sec.end - pos) / 4) return;
+				for (uint32_t j = 0; j < count; ++j)
+				{
+					uint32_t cu = read_fixed<uint32_t>(pos) & 0xffffff;
+					if (cu >= gdb.n_cus) continue;
+					const unsigned char *cu_pos = gdb.cu_list + (size_t) cu * 16;
+					cus.push_back(read_fixed<uint64_t>(cu_pos));
+				}
+				return;
+			}
+		}
+
+		void accelerator_tables::find(string_view name, vector<Dwarf_Off>& out) const
+		{
+			vector<Dwarf_Off> dies;
+			vector<Dwarf_Off> cus;
+			switch (k)
+			{
+				case DEBUG_NAMES:
+					for (auto i_u = names_units.begin(); i_u != names_units.end(); ++i_u)
+					{
+						names_candidates(*i_u, name, dies);
+					}
+					break;
+				case GDB_INDEX:
+					gdb_index_candidates(name, cus);
+					break;
+				case PUBNAMES: {
+					auto found = std::equal_range(pub_entries.begin(), pub_entries.end(),
+						std::make_pair(name, (Dwarf_Off) 0),
+						[](const std::pair<string_view, Dwarf_Off>& a,
+							const std::pair<string_view, Dwarf_Off>& b) { return a.first < b.first; });
+					for (auto i_e = found.first; i_e != found.second; ++i_e) dies.push_back(i_e->second);
+				} break;
+				default: return;
+			}
+			/* The tables also list DIEs that aren't the root's grandchildren
+			 * (and pubnames may qualify names), so check each one. */
+			size_t first_out = out.size();
+			for (auto i_d = dies.begin(); i_d != dies.end(); ++i_d)
+			{
+				native::location loc;
+				if (!img.locate(*i_d, loc) || loc.depth != 2) continue;
+				const char *found_name = visible_name(img, *i_d);
+				if (found_name && string_view(found_name) == name) out.push_back(*i_d);
+			}
+			for (auto i_cu = cus.begin(); i_cu != cus.end(); ++i_cu)
+			{
+				const native::unit *p_u = img.unit_containing(*i_cu);
+				if (!p_u || p_u->offset != *i_cu) continue;
+				for (Dwarf_Off c = img.first_child(p_u->first_die); c != 0; c = img.next_sibling(c))
+				{
+					const char *found_name = visible_name(img, c);
+					if (found_name && string_view(found_name) == name) out.push_back(c);
+				}
+			}
+			std::sort(out.begin() + first_out, out.end());
+			out.erase(std::unique(out.begin() + first_out, out.end()), out.end());
+		}
+
+		size_t accelerator_tables::footprint() const
+		{
+			size_t bytes = names_units.capacity() * sizeof (names_unit)
+				+ pub_entries.capacity() * sizeof (pub_entries[0]);
+			for (auto i_u = names_units.begin(); i_u != names_units.end(); ++i_u)
+			{
+				for (auto i_a = i_u->abbrevs.begin(); i_a != i_u->abbrevs.end(); ++i_a)
+				{
+					bytes += 4 * sizeof (void*) + sizeof (*i_a)
+						+ i_a->second.idx_forms.capacity() * sizeof (i_a->second.idx_forms[0]);
+				}
+			}
+			return bytes;
+		}
+
+		uint32_t child_name_index::hash(Dwarf_Off parent, string_view name)
+		{
+			return name_index::hash(name) ^ (uint32_t) ((parent ^ (parent >> 32)) * 0x9e3779b1u);
+		}
+
+		size_t child_name_index::probe(uint32_t h, Dwarf_Off parent, string_view name) const
+		{
+			size_t mask = slots.size() - 1;
+			size_t i = h & mask;
+			for (; slots[i].name; i = (i + 1) & mask)
+			{
+				const slot& s = slots[i];
+				if (s.hash == h && s.parent == parent && s.len == name.size()
+					&& 0 == memcmp(s.name, name.data(), s.len)) break;
+			}
+			return i;
+		}
+
+		void child_name_index::grow()
+		{
+			vector<slot> old;
+			old.swap(slots);
+			slots.assign(old.empty() ? 16 : 2 * old.size(), slot());
+			size_t mask = slots.size() - 1;
+			for (auto i_s = old.begin(); i_s != old.end(); ++i_s)
+			{
+				if (!i_s->name) continue;
+				size_t i = i_s->hash & mask;
+				while (slots[i].name) i = (i + 1) & mask;
+				slots[i] = *i_s;
+			}
+		}
+
+		void child_name_index::add_parent(Dwarf_Off parent,
+			const vector<std::pair<string_view, Dwarf_Off> >& named_children)
+		{
+			if (!parents.insert(parent).second) return;
+			for (auto i_c = named_children.begin(); i_c != named_children.end(); ++i_c)
+			{
+				if (2 * (n + 1) > slots.size()) grow();
+				uint32_t h = hash(parent, i_c->first);
+				size_t i = probe(h, parent, i_c->first);
+				if (slots[i].name) continue; // an earlier sibling has this name
+				slots[i] = slot { h, (uint32_t) i_c->first.size(), i_c->first.data(), parent, i_c->second };
+				++n;
+			}
+		}
+
+		opt<Dwarf_Off> child_name_index::find(Dwarf_Off parent, string_view name) const
+		{
+			if (slots.empty()) return opt<Dwarf_Off>();
+			size_t i = probe(hash(parent, name), parent, name);
+			if (!slots[i].name) return opt<Dwarf_Off>();
+			return slots[i].child;
+		}
+
+		size_t child_name_index::footprint() const
+		{
+			return slots.capacity() * sizeof (slot)
+				+ parents.size() * (sizeof (Dwarf_Off) + 2 * sizeof (void*))
+				+ parents.bucket_count() * sizeof (void*);
+		}
+	}
+}
@@ -0,0 +1,775 @@
+/* dwarfpp: C++ binding for a useful subset of libdwarf, plus extra goodies.
+ *
+ * native.cpp: a minimal decoder for .debug_info over mmapped sections
+ *
+ * Copyright (c) 2008--17, Stephen Kell. For licensing information, see the
+ * LICENSE file in the root of the libdwarfpp tree.
+ */
+
+#include "dwarfpp/native.hpp"
+
+#include <algorithm>
+#include <string>
+#include <elf.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <srk31/endian.hpp>
+
+namespace dwarf
+{
+	using std::endl;
+	namespace core
+	{
+		namespace native
+		{
+			/* The forms skip_form() knows how to skip. */
+			static bool is_known_form(Dwarf_Unsigned form)
+			{
+				switch (form)
+				{
+					case DW_FORM_flag_present: case DW_FORM_implicit_const:
+					case DW_FORM_addr:
+					case DW_FORM_data1: case DW_FORM_ref1: case DW_FORM_flag:
+					case DW_FORM_strx1: case DW_FORM_addrx1:
+					case DW_FORM_data2: case DW_FORM_ref2:
+					case DW_FORM_strx2: case DW_FORM_addrx2:
+					case DW_FORM_strx3: case DW_FORM_addrx3:
+					case DW_FORM_data4: case DW_FORM_ref4: case DW_FORM_ref_sup4:
+					case DW_FORM_strx4: case DW_FORM_addrx4:
+					case DW_FORM_data8: case DW_FORM_ref8: case DW_FORM_ref_sig8:
+					case DW_FORM_ref_sup8:
+					case DW_FORM_data16:
+					case DW_FORM_strp: case DW_FORM_line_strp: case DW_FORM_sec_offset:
+					case DW_FORM_strp_sup: case DW_FORM_GNU_ref_alt: case DW_FORM_GNU_strp_alt:
+					case DW_FORM_ref_addr:
+					case DW_FORM_sdata:
+					case DW_FORM_udata: case DW_FORM_ref_udata: case DW_FORM_strx:
+					case DW_FORM_addrx: case DW_FORM_loclistx: case DW_FORM_rnglistx:
+					case DW_FORM_GNU_addr_index: case DW_FORM_GNU_str_index:
+					case DW_FORM_string:
+					case DW_FORM_block1: case DW_FORM_block2: case DW_FORM_block4:
+					case DW_FORM_block: case DW_FORM_exprloc:
+						return true;
+					default:
+						return false;
+				}
+			}
+
+			abbrev_table::abbrev_table(const section& s, Dwarf_Unsigned off)
+			{
+				if (!s.contains(off)) throw No_entry();
+				const unsigned char *pos = s.begin + off;
+				while (pos < s.end)
+				{
+					Dwarf_Unsigned code = read_uleb128(pos);
+					if (code == 0) break;
+					/* Don't let a silly code make us allocate a silly vector. */
+					if (code > (1u<<20)) throw No_entry();
+					if (code >= by_code.size()) by_code.resize(code + 1);
+					abbrev& a = by_code[code];
+					a.code = code;
+					a.tag = read_uleb128(pos);
+					a.has_children = (*pos++ == DW_CHILDREN_yes);
+					a.first_spec = specs.size();
+					while (pos < s.end)
+					{
+						attr_spec spec;
+						spec.attr = read_uleb128(pos);
+						spec.form = read_uleb128(pos);
+						spec.implicit_const = 0;
+						spec.offset = 0;
+						if (spec.attr == 0 && spec.form == 0) break;
+						/* A form we can't skip (vendor, future, or one that
+						 * only says at each DIE what it is) means we can't
+						 * decode the unit. libdwarf will have to. */
+						if (!is_known_form(spec.form)) throw No_entry();
+						if (spec.form == DW_FORM_implicit_const) spec.implicit_const = read_sleb128(pos);
+						if (spec.attr == DW_AT_sibling) a.sibling_spec = specs.size() - a.first_spec;
+						specs.push_back(spec);
+					}
+					a.nspecs = specs.size() - a.first_spec;
+				}
+			}
+
+			/* The size of a form's bytes, if it doesn't depend on the bytes. */
+			static opt<unsigned> fixed_form_size(Dwarf_Half form, const unit& u)
+			{
+				switch (form)
+				{
+					case DW_FORM_flag_present:
+					case DW_FORM_implicit_const:
+						return 0u;
+					case DW_FORM_addr:
+						return (unsigned) u.address_size;
+					case DW_FORM_data1: case DW_FORM_ref1: case DW_FORM_flag:
+					case DW_FORM_strx1: case DW_FORM_addrx1:
+						return 1u;
+					case DW_FORM_data2: case DW_FORM_ref2:
+					case DW_FORM_strx2: case DW_FORM_addrx2:
+						return 2u;
+					case DW_FORM_strx3: case DW_FORM_addrx3:
+						return 3u;
+					case DW_FORM_data4: case DW_FORM_ref4: case DW_FORM_ref_sup4:
+					case DW_FORM_strx4: case DW_FORM_addrx4:
+						return 4u;
+					case DW_FORM_data8: case DW_FORM_ref8: case DW_FORM_ref_sig8:
+					case DW_FORM_ref_sup8:
+						return 8u;
+					case DW_FORM_data16:
+						return 16u;
+					case DW_FORM_strp: case DW_FORM_line_strp: case DW_FORM_sec_offset:
+					case DW_FORM_strp_sup: case DW_FORM_GNU_ref_alt: case DW_FORM_GNU_strp_alt:
+						return (unsigned) u.offset_size;
+					case DW_FORM_ref_addr:
+						return (unsigned) (u.version <= 2 ? u.address_size : u.offset_size);
+					default: // LEB128s, strings and blocks
+						return opt<unsigned>();
+				}
+			}
+
+			void abbrev_table::lay_out(const unit& u)
+			{
+				for (auto i_a = by_code.begin(); i_a != by_code.end(); ++i_a)
+				{
+					if (i_a->code == 0) continue;
+					unsigned off = 0;
+					bool all_fixed = true;
+					unsigned i = 0;
+					while (all_fixed && i < i_a->nspecs)
+					{
+						attr_spec& spec = specs[i_a->first_spec + i++];
+						spec.offset = off;
+						opt<unsigned> sz = fixed_form_size(spec.form, u);
+						if (sz) off += *sz;
+						else all_fixed = false; // we're placed, but our successors aren't
+					}
+					i_a->nplaced = i;
+					i_a->attrs_size = all_fixed ? opt<unsigned>(off) : opt<unsigned>();
+				}
+				laid_out_address_size = u.address_size;
+				laid_out_ref_addr_size = (u.version <= 2 ? u.address_size : u.offset_size);
+				laid_out_offset_size = u.offset_size;
+			}
+
+			image::image(int fd) : mapping(MAP_FAILED), mapping_len(0)
+			{
+				struct stat s;
+				if (0 != fstat(fd, &s)) throw No_entry();
+				mapping_len = s.st_size;
+				mapping = mmap(nullptr, mapping_len, PROT_READ, MAP_PRIVATE, fd, 0);
+				if (mapping == MAP_FAILED) throw No_entry();
+				try
+				{
+					find_sections();
+					read_units();
+					unit_offset_indexes.resize(units.size());
+				}
+				catch (No_entry)
+				{
+					munmap(mapping, mapping_len);
+					throw;
+				}
+				debug(2) << "Native decoder: " << units.size() << " units, "
+					<< abbrev_tables.size() << " abbrev tables" << endl;
+			}
+
+			image::~image()
+			{
+				if (mapping != MAP_FAILED) munmap(mapping, mapping_len);
+			}
+
+			/* Walk the section headers, calling back with each section's name,
+			 * file offset, size and flags. */
+			template <typename Ehdr, typename Shdr, typename Callback>
+			static void for_each_section(const unsigned char *base, size_t len, Callback cb)
+			{
+				if (len < sizeof (Ehdr)) throw No_entry();
+				const Ehdr *ehdr = reinterpret_cast<const Ehdr *>(base);
+				/* We don't do relocation, so relocatable files are out. */
+				if (ehdr->e_type == ET_REL) throw No_entry();
+				if (ehdr->e_shoff == 0 || ehdr->e_shentsize != sizeof (Shdr)
+					|| ehdr->e_shoff + ehdr->e_shnum * sizeof (Shdr) > len) throw No_entry();
+				const Shdr *shdrs = reinterpret_cast<const Shdr *>(base + ehdr->e_shoff);
+				if (ehdr->e_shstrndx == SHN_UNDEF || ehdr->e_shstrndx >= ehdr->e_shnum) throw No_entry();
+				const Shdr& shstrtab = shdrs[ehdr->e_shstrndx];
+				if (shstrtab.sh_offset + shstrtab.sh_size > len) throw No_entry();
+				const char *names = reinterpret_cast<const char *>(base + shstrtab.sh_offset);
+				for (unsigned i = 0; i < ehdr->e_shnum; ++i)
+				{
+					if (shdrs[i].sh_name >= shstrtab.sh_size) continue;
+					if (shdrs[i].sh_type == SHT_NOBITS) continue;
+					if (shdrs[i].sh_offset + shdrs[i].sh_size > len) throw No_entry();
+					cb(names + shdrs[i].sh_name, shdrs[i].sh_offset, shdrs[i].sh_size,
+						shdrs[i].sh_flags);
+				}
+			}
+
+			void image::find_sections()
+			{
+				const unsigned char *base = static_cast<const unsigned char *>(mapping);
+				if (mapping_len < EI_NIDENT || 0 != memcmp(base, ELFMAG, SELFMAG)) throw No_entry();
+				/* We only read host-endian DWARF. */
+				bool file_is_little_endian = (base[EI_DATA] == ELFDATA2LSB);
+				if (file_is_little_endian != srk31::host_is_little_endian()) throw No_entry();
+
+				auto cb = [this, base](const char *name, Dwarf_Off off, Dwarf_Unsigned size,
+					Dwarf_Unsigned flags) {
+					section *p_s = nullptr;
+					if (0 == strcmp(name, ".debug_info")) p_s = &info;
+					else if (0 == strcmp(name, ".debug_abbrev")) p_s = &abbrev_sec;
+					else if (0 == strcmp(name, ".debug_str")) p_s = &str;
+					else if (0 == strcmp(name, ".debug_line_str")) p_s = &line_str;
+					else if (0 == strcmp(name, ".debug_str_offsets")) p_s = &str_offsets;
+					else if (0 == strcmp(name, ".debug_names")) p_s = &debug_names;
+					else if (0 == strcmp(name, ".gdb_index")) p_s = &gdb_index;
+					else if (0 == strcmp(name, ".debug_pubnames")) p_s = &pubnames;
+					else if (0 == strcmp(name, ".debug_pubtypes")) p_s = &pubtypes;
+					else if (0 == strcmp(name, ".note.gnu.build-id"))
+					{
+						/* A note is namesz, descsz, type, then the padded name
+						 * ("GNU") and the descriptor, which is the build ID. */
+						if (size < 12) return;
+						const unsigned char *pos = base + off;
+						uint32_t namesz = read_fixed<uint32_t>(pos);
+						uint32_t descsz = read_fixed<uint32_t>(pos);
+						uint32_t type = read_fixed<uint32_t>(pos);
+						pos += (namesz + 3) & ~3u;
+						if (type != NT_GNU_BUILD_ID || pos + descsz > base + off + size) return;
+						build_id_bytes = section(pos, pos + descsz);
+						return;
+					}
+					else if (0 == strncmp(name, ".zdebug_", sizeof ".zdebug_" - 1)) throw No_entry();
+					if (!p_s) return;
+#ifdef SHF_COMPRESSED
+					if (flags & SHF_COMPRESSED) throw No_entry();
+#endif
+					*p_s = section(base + off, base + off + size);
+				};
+				switch (base[EI_CLASS])
+				{
+					case ELFCLASS32: for_each_section<Elf32_Ehdr, Elf32_Shdr>(base, mapping_len, cb); break;
+					case ELFCLASS64: for_each_section<Elf64_Ehdr, Elf64_Shdr>(base, mapping_len, cb); break;
+					default: throw No_entry();
+				}
+				if (!info || !abbrev_sec) throw No_entry();
+			}
+
+			void image::read_units()
+			{
+				const unsigned char *pos = info.begin;
+				while (pos < info.end)
+				{
+					unit u;
+					u.offset = pos - info.begin;
+					Dwarf_Unsigned length = read_fixed<uint32_t>(pos);
+					u.offset_size = 4;
+					if (length == 0xffffffffu)
+					{
+						length = read_fixed<uint64_t>(pos);
+						u.offset_size = 8;
+					}
+					else if (length >= 0xfffffff0u) throw No_entry(); // reserved
+					u.end = (pos - info.begin) + length;
+					if (u.end > info.size()) throw No_entry();
+					u.version = read_fixed<uint16_t>(pos);
+					if (u.version < 2 || u.version > 5) throw No_entry();
+					if (u.version >= 5)
+					{
+						u.unit_type = read_fixed<uint8_t>(pos);
+						u.address_size = read_fixed<uint8_t>(pos);
+						u.abbrev_offset = read_sized(pos, u.offset_size);
+						/* We only do full and partial units. Skeletons want their
+						 * split halves from a .dwo, and type units are found by
+						 * signature, neither of which we follow; rather than
+						 * give a different tree from libdwarf, we decline. */
+						switch (u.unit_type)
+						{
+							case DW_UT_compile:
+							case DW_UT_partial:
+								break;
+							default: throw No_entry();
+						}
+					}
+					else
+					{
+						u.unit_type = DW_UT_compile;
+						u.abbrev_offset = read_sized(pos, u.offset_size);
+						u.address_size = read_fixed<uint8_t>(pos);
+					}
+					u.first_die = pos - info.begin;
+
+					auto found = abbrev_tables.find(u.abbrev_offset);
+					if (found == abbrev_tables.end())
+					{
+						found = abbrev_tables.insert(std::make_pair(u.abbrev_offset,
+							abbrev_table(abbrev_sec, u.abbrev_offset))).first;
+						found->second.lay_out(u);
+					}
+					u.p_abbrevs = &found->second; // map nodes don't move
+					units.push_back(u);
+
+					/* strx forms need the CU's DW_AT_str_offsets_base. */
+					cursor c;
+					if (decode(units.back().first_die, &units.back(), c) && c.p_abbrev)
+					{
+						Dwarf_Half form;
+						const unsigned char *attr_pos = find_attr(c, DW_AT_str_offsets_base, &form);
+						if (attr_pos) units.back().str_offsets_base
+							= read_sized(attr_pos, units.back().offset_size);
+					}
+					pos = info.begin + u.end;
+				}
+			}
+
+			const unit *image::unit_containing(Dwarf_Off off) const
+			{
+				auto found = std::upper_bound(units.begin(), units.end(), off,
+					[](Dwarf_Off o, const unit& u) { return o < u.offset; });
+				if (found == units.begin()) return nullptr;
+				--found;
+				if (off >= found->end) return nullptr;
+				return &*found;
+			}
+
+			bool image::decode(Dwarf_Off off, const unit *p_u, cursor& out) const
+			{
+				if (!p_u || off < p_u->first_die || off >= p_u->end) return false;
+				const unsigned char *pos = info.begin + off;
+				Dwarf_Unsigned code = read_uleb128(pos);
+				out.off = off;
+				out.p_unit = p_u;
+				out.attrs = pos;
+				if (code == 0) { out.p_abbrev = nullptr; return true; } // null entry
+				out.p_abbrev = p_u->p_abbrevs->lookup(code);
+				return out.p_abbrev != nullptr;
+			}
+			bool image::decode(Dwarf_Off off, cursor& out) const
+			{ return decode(off, unit_containing(off), out); }
+
+			const unsigned char *image::skip_form(Dwarf_Half form, const unit& u,
+				const unsigned char *pos) const
+			{
+				switch (form)
+				{
+					case DW_FORM_flag_present:
+					case DW_FORM_implicit_const:
+						return pos;
+					case DW_FORM_addr:
+						return pos + u.address_size;
+					case DW_FORM_data1: case DW_FORM_ref1: case DW_FORM_flag:
+					case DW_FORM_strx1: case DW_FORM_addrx1:
+						return pos + 1;
+					case DW_FORM_data2: case DW_FORM_ref2:
+					case DW_FORM_strx2: case DW_FORM_addrx2:
+						return pos + 2;
+					case DW_FORM_strx3: case DW_FORM_addrx3:
+						return pos + 3;
+					case DW_FORM_data4: case DW_FORM_ref4: case DW_FORM_ref_sup4:
+					case DW_FORM_strx4: case DW_FORM_addrx4:
+						return pos + 4;
+					case DW_FORM_data8: case DW_FORM_ref8: case DW_FORM_ref_sig8:
+					case DW_FORM_ref_sup8:
+						return pos + 8;
+					case DW_FORM_data16:
+						return pos + 16;
+					case DW_FORM_strp: case DW_FORM_line_strp: case DW_FORM_sec_offset:
+					case DW_FORM_strp_sup: case DW_FORM_GNU_ref_alt: case DW_FORM_GNU_strp_alt:
+						return pos + u.offset_size;
+					case DW_FORM_ref_addr:
+						return pos + (u.version <= 2 ? u.address_size : u.offset_size);
+					case DW_FORM_sdata:
+						read_sleb128(pos); return pos;
+					case DW_FORM_udata: case DW_FORM_ref_udata: case DW_FORM_strx:
+					case DW_FORM_addrx: case DW_FORM_loclistx: case DW_FORM_rnglistx:
+					case DW_FORM_GNU_addr_index: case DW_FORM_GNU_str_index:
+						read_uleb128(pos); return pos;
+					case DW_FORM_string:
+						return pos + strlen(reinterpret_cast<const char *>(pos)) + 1;
+					case DW_FORM_block1: { Dwarf_Unsigned len = read_fixed<uint8_t>(pos); return pos + len; }
+					case DW_FORM_block2: { Dwarf_Unsigned len = read_fixed<uint16_t>(pos); return pos + len; }
+					case DW_FORM_block4: { Dwarf_Unsigned len = read_fixed<uint32_t>(pos); return pos + len; }
+					case DW_FORM_block:
+					case DW_FORM_exprloc: { Dwarf_Unsigned len = read_uleb128(pos); return pos + len; }
+					default:
+						/* The abbrev table rejected any other form. */
+						throw No_entry();
+				}
+			}
+
+			const unsigned char *image::skip_attrs(const cursor& c) const
+			{
+				assert(c.p_abbrev);
+				const abbrev_table& t = *c.p_unit->p_abbrevs;
+				if (c.p_abbrev->attrs_size && t.laid_out_for(*c.p_unit))
+				{
+					return c.attrs + *c.p_abbrev->attrs_size;
+				}
+				const unsigned char *pos = c.attrs;
+				for (auto p_spec = t.specs_begin(*c.p_abbrev); p_spec != t.specs_end(*c.p_abbrev); ++p_spec)
+				{
+					pos = skip_form(p_spec->form, *c.p_unit, pos);
+				}
+				return pos;
+			}
+
+			const unsigned char *image::find_attr(const cursor& c, Dwarf_Half attr,
+				Dwarf_Half *out_form, const attr_spec **out_spec) const
+			{
+				assert(c.p_abbrev);
+				const abbrev_table& t = *c.p_unit->p_abbrevs;
+				const attr_spec *p_begin = t.specs_begin(*c.p_abbrev);
+				const attr_spec *p_end = t.specs_end(*c.p_abbrev);
+				/* The abbrev alone tells us whether the attribute is there. */
+				const attr_spec *p_found = p_begin;
+				while (p_found != p_end && p_found->attr != attr) ++p_found;
+				if (p_found == p_end) return nullptr;
+				/* Jump to the last spec at a known offset before the one we want
+				 * (often the one we want), and only decode our way from there. */
+				const attr_spec *p_start = p_begin;
+				const unsigned char *pos = c.attrs;
+				if (t.laid_out_for(*c.p_unit))
+				{
+					p_start = std::min(p_found, p_begin + c.p_abbrev->nplaced - 1);
+					pos = c.attrs + p_start->offset;
+				}
+				for (auto p_spec = p_start; p_spec != p_end; ++p_spec)
+				{
+					Dwarf_Half form = p_spec->form;
+					if (p_spec->attr == attr)
+					{
+						if (out_form) *out_form = form;
+						if (out_spec) *out_spec = p_spec;
+						return pos;
+					}
+					pos = skip_form(form, *c.p_unit, pos);
+				}
+				return nullptr;
+			}
+
+			const char *image::form_string(Dwarf_Half form, const unit& u,
+				const unsigned char *pos) const
+			{
+				Dwarf_Unsigned str_off;
+				switch (form)
+				{
+					case DW_FORM_string:
+						return reinterpret_cast<const char *>(pos);
+					case DW_FORM_strp:
+						str_off = read_sized(pos, u.offset_size);
+						return str.contains(str_off) ? reinterpret_cast<const char *>(str.begin + str_off) : nullptr;
+					case DW_FORM_line_strp:
+						str_off = read_sized(pos, u.offset_size);
+						return line_str.contains(str_off) ? reinterpret_cast<const char *>(line_str.begin + str_off) : nullptr;
+					case DW_FORM_strx: case DW_FORM_GNU_str_index:
+					case DW_FORM_strx1: case DW_FORM_strx2: case DW_FORM_strx3: case DW_FORM_strx4: {
+						Dwarf_Unsigned idx;
+						switch (form)
+						{
+							case DW_FORM_strx1: idx = read_sized(pos, 1); break;
+							case DW_FORM_strx2: idx = read_sized(pos, 2); break;
+							case DW_FORM_strx3: idx = read_sized(pos, 3); break;
+							case DW_FORM_strx4: idx = read_sized(pos, 4); break;
+							default: idx = read_uleb128(pos); break;
+						}
+						if (!u.str_offsets_base) return nullptr;
+						Dwarf_Off entry_off = *u.str_offsets_base + idx * u.offset_size;
+						if (!str_offsets.contains(entry_off)) return nullptr;
+						const unsigned char *entry = str_offsets.begin + entry_off;
+						str_off = read_sized(entry, u.offset_size);
+						return str.contains(str_off) ? reinterpret_cast<const char *>(str.begin + str_off) : nullptr;
+					}
+					default:
+						/* e.g. DW_FORM_GNU_strp_alt, which points into a dwz file we
+						 * haven't got. */
+						debug(2) << "Native decoder: can't get a string from form 0x"
+							<< std::hex << form << std::dec << endl;
+						return nullptr;
+				}
+			}
+
+			bool image::fetch_attr(Dwarf_Off off, Dwarf_Half attr, raw_attr& out) const
+			{
+				cursor c;
+				if (!decode(off, c) || !c.p_abbrev) return false;
+				const attr_spec *p_spec = nullptr;
+				out.attr = attr;
+				out.p_unit = c.p_unit;
+				out.pos = find_attr(c, attr, &out.form, &p_spec);
+				out.implicit_const = p_spec ? p_spec->implicit_const : 0;
+				return true;
+			}
+
+			opt<Dwarf_Unsigned> image::unsigned_value(const raw_attr& a) const
+			{
+				const unsigned char *pos = a.pos;
+				if (!pos) return opt<Dwarf_Unsigned>();
+				switch (a.form)
+				{
+					case DW_FORM_data1: return read_sized(pos, 1);
+					case DW_FORM_data2: return read_sized(pos, 2);
+					case DW_FORM_data4: return read_sized(pos, 4);
+					case DW_FORM_data8: return read_sized(pos, 8);
+					case DW_FORM_udata: return read_uleb128(pos);
+					case DW_FORM_sdata: return (Dwarf_Unsigned) read_sleb128(pos);
+					case DW_FORM_implicit_const: return (Dwarf_Unsigned) a.implicit_const;
+					default: return opt<Dwarf_Unsigned>();
+				}
+			}
+
+			opt<Dwarf_Signed> image::signed_value(const raw_attr& a) const
+			{
+				const unsigned char *pos = a.pos;
+				if (!pos) return opt<Dwarf_Signed>();
+				switch (a.form)
+				{
+					case DW_FORM_data1: return (Dwarf_Signed) read_fixed<int8_t>(pos);
+					case DW_FORM_data2: return (Dwarf_Signed) read_fixed<int16_t>(pos);
+					case DW_FORM_data4: return (Dwarf_Signed) read_fixed<int32_t>(pos);
+					case DW_FORM_data8: return (Dwarf_Signed) read_fixed<int64_t>(pos);
+					case DW_FORM_udata: return (Dwarf_Signed) read_uleb128(pos);
+					case DW_FORM_sdata: return read_sleb128(pos);
+					case DW_FORM_implicit_const: return a.implicit_const;
+					default: return opt<Dwarf_Signed>();
+				}
+			}
+
+			opt<bool> image::flag_value(const raw_attr& a) const
+			{
+				if (!a.pos) return opt<bool>();
+				switch (a.form)
+				{
+					case DW_FORM_flag: return *a.pos != 0;
+					case DW_FORM_flag_present: return true;
+					default: return opt<bool>();
+				}
+			}
+
+			opt<Dwarf_Addr> image::address_value(const raw_attr& a) const
+			{
+				const unsigned char *pos = a.pos;
+				/* addrx forms need .debug_addr, which we don't read. */
+				if (!pos || a.form != DW_FORM_addr) return opt<Dwarf_Addr>();
+				return (Dwarf_Addr) read_sized(pos, a.p_unit->address_size);
+			}
+
+			block_view image::block_value(const raw_attr& a) const
+			{
+				const unsigned char *pos = a.pos;
+				if (!pos) return block_view();
+				Dwarf_Unsigned len;
+				switch (a.form)
+				{
+					case DW_FORM_block1: len = read_fixed<uint8_t>(pos); break;
+					case DW_FORM_block2: len = read_fixed<uint16_t>(pos); break;
+					case DW_FORM_block4: len = read_fixed<uint32_t>(pos); break;
+					case DW_FORM_block:
+					case DW_FORM_exprloc: len = read_uleb128(pos); break;
+					default: return block_view();
+				}
+				return block_view(pos, pos + len);
+			}
+
+			opt<Dwarf_Off> image::ref_value(const raw_attr& a) const
+			{
+				const unsigned char *pos = a.pos;
+				if (!pos) return opt<Dwarf_Off>();
+				const unit& u = *a.p_unit;
+				switch (a.form)
+				{
+					case DW_FORM_ref1: return u.offset + read_sized(pos, 1);
+					case DW_FORM_ref2: return u.offset + read_sized(pos, 2);
+					case DW_FORM_ref4: return u.offset + read_sized(pos, 4);
+					case DW_FORM_ref8: return u.offset + read_sized(pos, 8);
+					case DW_FORM_ref_udata: return u.offset + read_uleb128(pos);
+					case DW_FORM_ref_addr: return read_sized(pos,
+						u.version <= 2 ? u.address_size : u.offset_size);
+					default: return opt<Dwarf_Off>(); // e.g. ref_sig8, or into a dwz file
+				}
+			}
+
+			Dwarf_Off image::skip_subtree(const cursor& c) const
+			{
+				assert(c.p_abbrev);
+				const unsigned char *pos = c.attrs;
+				if (!c.p_abbrev->has_children) return skip_attrs(c) - info.begin;
+				if (c.p_abbrev->sibling_spec)
+				{
+					/* Use DW_AT_sibling to skip the children in one go. */
+					Dwarf_Half form;
+					pos = find_attr(c, DW_AT_sibling, &form);
+					assert(pos);
+					switch (form)
+					{
+						case DW_FORM_ref1: return c.p_unit->offset + read_sized(pos, 1);
+						case DW_FORM_ref2: return c.p_unit->offset + read_sized(pos, 2);
+						case DW_FORM_ref4: return c.p_unit->offset + read_sized(pos, 4);
+						case DW_FORM_ref8: return c.p_unit->offset + read_sized(pos, 8);
+						case DW_FORM_ref_udata: return c.p_unit->offset + read_uleb128(pos);
+						case DW_FORM_ref_addr: return read_sized(pos,
+							c.p_unit->version <= 2 ? c.p_unit->address_size : c.p_unit->offset_size);
+						default: break; // fall through to the slow way
+					}
+				}
+				/* Walk the children, each of which may be able to skip its own. */
+				Dwarf_Off cur = skip_attrs(c) - info.begin;
+				cursor child;
+				while (decode(cur, c.p_unit, child))
+				{
+					if (!child.p_abbrev) return cur + 1; // the null entry is one byte
+					cur = skip_subtree(child);
+				}
+				/* Ran off the end of the unit, or hit garbage. */
+				return c.p_unit->end;
+			}
+
+			bool image::is_die_offset(Dwarf_Off off) const
+			{
+				cursor c;
+				return decode(off, c) && c.p_abbrev;
+			}
+
+			Dwarf_Off image::first_child(Dwarf_Off off) const
+			{
+				cursor c;
+				if (!decode(off, c) || !c.p_abbrev || !c.p_abbrev->has_children) return 0UL;
+				Dwarf_Off child_off = skip_attrs(c) - info.begin;
+				cursor child;
+				if (!decode(child_off, c.p_unit, child) || !child.p_abbrev) return 0UL;
+				return child_off;
+			}
+
+			Dwarf_Off image::next_sibling(Dwarf_Off off) const
+			{
+				cursor c;
+				if (!decode(off, c) || !c.p_abbrev) return 0UL;
+				/* The unit's top-level DIE has no siblings *within the unit*;
+				 * moving between CUs is the caller's business. */
+				if (off == c.p_unit->first_die) return 0UL;
+				Dwarf_Off next_off = skip_subtree(c);
+				cursor next;
+				if (!decode(next_off, c.p_unit, next) || !next.p_abbrev) return 0UL;
+				return next_off;
+			}
+
+			Dwarf_Half image::tag(Dwarf_Off off) const
+			{
+				cursor c;
+				if (!decode(off, c) || !c.p_abbrev) throw No_entry();
+				return c.p_abbrev->tag;
+			}
+
+			const char *image::name(Dwarf_Off off) const
+			{
+				cursor c;
+				if (!decode(off, c) || !c.p_abbrev) return nullptr;
+				Dwarf_Half form;
+				const unsigned char *pos = find_attr(c, DW_AT_name, &form);
+				if (!pos) return nullptr;
+				return form_string(form, *c.p_unit, pos);
+			}
+
+			bool image::has_attr(Dwarf_Off off, Dwarf_Half attr) const
+			{
+				cursor c;
+				if (!decode(off, c) || !c.p_abbrev) return false;
+				/* Only the abbrev is needed for this -- no attribute bytes. */
+				const abbrev_table& t = *c.p_unit->p_abbrevs;
+				for (auto p_spec = t.specs_begin(*c.p_abbrev); p_spec != t.specs_end(*c.p_abbrev); ++p_spec)
+				{
+					if (p_spec->attr == attr) return true;
+				}
+				return false;
+			}
+
+			Dwarf_Off image::enclosing_cu_offset(Dwarf_Off off) const
+			{
+				const unit *p_u = unit_containing(off);
+				assert(p_u);
+				return p_u->first_die;
+			}
+
+			const unit_offset_index& image::offset_index_for(const unit& u) const
+			{
+				std::lock_guard<std::mutex> guard(unit_offset_indexes_lock);
+				std::unique_ptr<unit_offset_index>& p_idx = unit_offset_indexes[&u - &units[0]];
+				if (p_idx) return *p_idx;
+				
+				p_idx.reset(new unit_offset_index);
+				vector<Dwarf_Off> open; // DIEs whose children we're among
+				Dwarf_Off cur = u.first_die;
+				unsigned count = 0;
+				cursor c;
+				while (decode(cur, &u, c))
+				{
+					if (!c.p_abbrev)
+					{
+						++cur;
+						if (open.empty()) break; // padding after the unit's DIE
+						open.pop_back();
+						if (open.empty()) break; // closed the unit's DIE
+						continue;
+					}
+					if (count++ % unit_offset_index::interval == 0)
+					{
+						unit_offset_index::checkpoint cp = {
+							cur, (unsigned) p_idx->ancestors.size(), (unsigned short) (open.size() + 1)
+						};
+						p_idx->checkpoints.push_back(cp);
+						p_idx->ancestors.insert(p_idx->ancestors.end(), open.begin(), open.end());
+					}
+					Dwarf_Off next = skip_attrs(c) - info.begin;
+					if (c.p_abbrev->has_children) open.push_back(cur);
+					else if (open.empty()) break; // the unit's DIE had no children
+					cur = next;
+				}
+				return *p_idx;
+			}
+
+			bool image::locate(Dwarf_Off off, location& out) const
+			{
+				const unit *p_u = unit_containing(off);
+				if (!p_u || off < p_u->first_die) return false;
+				const unit_offset_index& idx = offset_index_for(*p_u);
+				auto found = std::upper_bound(idx.checkpoints.begin(), idx.checkpoints.end(), off,
+					[](Dwarf_Off o, const unit_offset_index::checkpoint& cp) { return o < cp.off; });
+				if (found == idx.checkpoints.begin()) return false;
+				--found;
+				
+				/* Decode forwards from the checkpoint, keeping track of what's open. */
+				vector<Dwarf_Off> open(idx.ancestors.begin() + found->first_ancestor,
+					idx.ancestors.begin() + found->first_ancestor + (found->depth - 1));
+				Dwarf_Off cur = found->off;
+				cursor c;
+				while (cur <= off && decode(cur, p_u, c))
+				{
+					if (!c.p_abbrev)
+					{
+						if (open.empty()) return false;
+						open.pop_back();
+						++cur;
+						continue;
+					}
+					if (cur == off)
+					{
+						out.depth = open.size() + 1;
+						out.parent = open.empty() ? 0UL : open.back();
+						return true;
+					}
+					Dwarf_Off next = skip_attrs(c) - info.begin;
+					if (c.p_abbrev->has_children) open.push_back(cur);
+					cur = next;
+				}
+				return false;
+			}
+
+			Dwarf_Off image::cu_offset_for_next_header(Dwarf_Off next_cu_header) const
+			{
+				/* libdwarf's "next CU header" is the end of the current unit. */
+				auto found = std::lower_bound(units.begin(), units.end(), next_cu_header,
+					[](const unit& u, Dwarf_Off o) { return u.end < o; });
+				if (found == units.end() || found->end != next_cu_header) return 0UL;
+				return found->first_die;
+			}
+		}
+	}
+}
@@ -0,0 +1,89 @@
+/* dwarfpp: C++ binding for a useful subset of libdwarf, plus extra goodies.
+ *
+ * pool.cpp: per-root pooled allocation for DIE payloads
+ *
+ * Copyright (c) 2008--17, Stephen Kell. For licensing information, see the
+ * LICENSE file in the root of the libdwarfpp tree.
+ */
+
+#include "dwarfpp/pool.hpp"
+#include "dwarfpp/root.hpp"
+
+#include <algorithm>
+
+namespace dwarf
+{
+	namespace core
+	{
+		const size_t payload_pool::GRANULE;
+		const size_t payload_pool::NCLASSES;
+		const size_t payload_pool::CHUNK_SIZE;
+
+		payload_pool::payload_pool()
+		 : chunk_pos(nullptr), chunk_end(nullptr), bytes_in_use(0)
+		{
+			std::fill(free_lists, free_lists + NCLASSES, nullptr);
+		}
+
+		void *payload_pool::refill(size_t cls)
+		{
+			size_t sz = (cls + 1) * GRANULE;
+			if (chunk_end - chunk_pos < (ptrdiff_t) sz)
+			{
+				/* Whatever is left of the old chunk is too small for this
+				 * class; give it to the free lists for the smaller ones. */
+				while (chunk_end - chunk_pos >= (ptrdiff_t) GRANULE)
+				{
+					size_t left_cls = std::min<size_t>((chunk_end - chunk_pos) / GRANULE, NCLASSES) - 1;
+					free_block *b = reinterpret_cast<free_block *>(chunk_pos);
+					b->next = free_lists[left_cls];
+					free_lists[left_cls] = b;
+					chunk_pos += (left_cls + 1) * GRANULE;
+				}
+				chunks.emplace_back(new char[CHUNK_SIZE]);
+				chunk_pos = chunks.back().get();
+				chunk_end = chunk_pos + CHUNK_SIZE;
+			}
+			void *ret = chunk_pos;
+			chunk_pos += sz;
+			return ret;
+		}
+
+		/* Each payload is prefixed by a header saying which pool it came
+		 * from (null for the heap), so that delete can find its way back
+		 * without the payload, which has been destructed by then. */
+		struct alignas(16) payload_header
+		{
+			payload_pool *p_pool;
+			size_t size;
+		};
+
+		void *basic_die::operator new(size_t sz)
+		{
+			payload_header *h = static_cast<payload_header *>(
+				::operator new(sizeof (payload_header) + sz));
+			h->p_pool = nullptr;
+			h->size = sz;
+			return h + 1;
+		}
+		void *basic_die::operator new(size_t sz, root_die& r)
+		{
+			payload_header *h = static_cast<payload_header *>(
+				r.pool.allocate(sizeof (payload_header) + sz));
+			h->p_pool = &r.pool;
+			h->size = sz;
+			return h + 1;
+		}
+		void basic_die::operator delete(void *p)
+		{
+			if (!p) return;
+			payload_header *h = static_cast<payload_header *>(p) - 1;
+			if (h->p_pool) h->p_pool->deallocate(h, sizeof (payload_header) + h->size);
+			else ::operator delete(h);
+		}
+		void basic_die::operator delete(void *p, root_die& r)
+		{
+			basic_die::operator delete(p);
+		}
+	}
+}
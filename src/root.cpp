@@ -13,6 +13,9 @@
 #include "dwarfpp/frame.hpp"
 
 #include <iostream>
+#include <thread>
+#include <exception>
+#include <algorithm>
 #include <srk31/indenting_ostream.hpp>
 #include <srk31/algorithm.hpp>
 
@@ -89,45 +92,83 @@ namespace dwarf
 		}
 		encap::attribute_value basic_die::attr(Dwarf_Half a) const
 		{
+			root_die::guard g(get_root());
 			Attribute attr(d, a);
 			return encap::attribute_value(attr, d, get_root());
 		}
 		void basic_die::left_merge_attrs(encap::attribute_map& m, const encap::attribute_map& arg)
 		{
-			for (auto i_attr = arg.begin(); i_attr != arg.end(); ++i_attr)
-			{
-				auto found = m.find(i_attr->first);
-				if (found == m.end()) m.insert(make_pair(i_attr->first, i_attr->second));
-			}
+			m.left_merge(arg);
+		}
+		void basic_die::left_merge_attrs(encap::attribute_map& m, encap::attribute_map&& arg)
+		{
+			m.left_merge(std::move(arg));
 		}
 		/* The same, but seeing through DW_AT_abstract_origin and DW_AT_specification references. */
 		encap::attribute_map basic_die::find_all_attrs() const
 		{
-			encap::attribute_map m = copy_attrs();
+			root_die& r = get_root();
+			bool memoize = r.policy.memoize_effective_attrs;
+			if (memoize)
+			{
+				root_die::guard g(r);
+				auto found = r.effective_attrs_cache.find(get_offset());
+				if (found != r.effective_attrs_cache.end()) return found->second;
+			}
+			encap::attribute_map m = all_attrs();
 			// merge with attributes of abstract_origin and specification
-			if (has_attr(DW_AT_abstract_origin))
+			/* We already have the reference in m, so needn't fetch it again.
+			 * Like find_attr(), we follow chains of origins and definitions,
+			 * but take a specification's own attributes only. */
+			auto found_origin = m.find(DW_AT_abstract_origin);
+			auto found_spec = m.find(DW_AT_specification);
+			bool linked = true;
+			if (found_origin != m.end())
 			{
-				encap::attribute_map origin_m = attr(DW_AT_abstract_origin).get_refiter()->all_attrs();
-				left_merge_attrs(m, origin_m);
+				left_merge_attrs(m, found_origin->second.get_refiter()->find_all_attrs());
 			}
-			else if (has_attr(DW_AT_specification))
+			else if (found_spec != m.end())
 			{
-				encap::attribute_map origin_m = attr(DW_AT_specification).get_refiter()->all_attrs();
-				left_merge_attrs(m, origin_m);
+				left_merge_attrs(m, found_spec->second.get_refiter()->all_attrs());
 			}
-			else if (has_attr(DW_AT_declaration))
+			else if (m.find(DW_AT_declaration) != m.end())
 			{
 				/* How do we get to the "real" DIE from this specification? The 
 				 * specification attr doesn't tell us, so we have to search. */
 				iterator_df<> found = find_definition();
-				if (found) left_merge_attrs(m, found->all_attrs());
+				if (found && found.offset_here() != get_offset())
+				{
+					left_merge_attrs(m, found->find_all_attrs());
+				}
+			}
+			else linked = false;
+			/* DIEs with no links would just be copies of themselves. */
+			if (memoize && linked)
+			{
+				root_die::guard g(r);
+				r.effective_attrs_cache.insert(make_pair(get_offset(), m));
 			}
 			return m;
 		}
 		encap::attribute_value basic_die::find_attr(Dwarf_Half a) const
 		{
 			if (has_attr(a)) { return attr(a); }
-			else if (has_attr(DW_AT_abstract_origin))
+			root_die& r = get_root();
+			if (r.policy.memoize_effective_attrs && (has_attr(DW_AT_abstract_origin)
+				|| has_attr(DW_AT_specification) || has_attr(DW_AT_declaration)))
+			{
+				/* find_all_attrs() merges in the same way that we search below. */
+				root_die::guard g(r);
+				auto found = r.effective_attrs_cache.find(get_offset());
+				encap::attribute_map computed;
+				const encap::attribute_map *p_m = &computed;
+				if (found != r.effective_attrs_cache.end()) p_m = &found->second;
+				else computed = find_all_attrs();
+				auto found_attr = p_m->find(a);
+				if (found_attr != p_m->end()) return found_attr->second;
+				return encap::attribute_value(); // a.k.a. a NO_ATTR-valued attribute_value
+			}
+			if (has_attr(DW_AT_abstract_origin))
 			{
 				return attr(DW_AT_abstract_origin).get_refiter()->find_attr(a);
 			}
@@ -157,6 +198,103 @@ namespace dwarf
 			}
 			return encap::attribute_value(); // a.k.a. a NO_ATTR-valued attribute_value
 		}
+		bool basic_die::fetch_raw_attr(Dwarf_Half a, native::raw_attr& out) const
+		{
+#if DWARFPP_NATIVE_DECODER
+			if (!d.handle) return false; // in-memory or dummy
+			const native::image *p_img = d.native_image();
+			return p_img && p_img->fetch_attr(d.handle.off, a, out);
+#else
+			return false;
+#endif
+		}
+		/* Data forms are signed or unsigned according to the attribute, as
+		 * in attribute_value's constructor; we only deal with the plain
+		 * "constant" interpretation. The native decoder only reads DWARF
+		 * that we model as dwarf_current (see iterator_base::spec_here()). */
+		static opt<Dwarf_Signed> raw_constant(const native::image& img, const native::raw_attr& raw)
+		{
+			if (raw.form == DW_FORM_implicit_const) return raw.implicit_const;
+			int cls = ::dwarf::spec::dwarf_current.get_interp(raw.attr, raw.form);
+			if ((cls & ~::dwarf::spec::interp::FLAGS) != ::dwarf::spec::interp::constant) return opt<Dwarf_Signed>();
+			if (raw.form == DW_FORM_sdata
+				|| (raw.form != DW_FORM_udata && (cls & ::dwarf::spec::interp::SIGNED)))
+			{
+				return img.signed_value(raw);
+			}
+			/* Like attribute_value's get_signed() and get_unsigned(), our
+			 * callers cast between the two as they see fit. */
+			opt<Dwarf_Unsigned> u = img.unsigned_value(raw);
+			return u ? opt<Dwarf_Signed>((Dwarf_Signed) *u) : opt<Dwarf_Signed>();
+		}
+		bool basic_die::raw_get_string(Dwarf_Half a, opt<std::string>& out) const
+		{
+			native::raw_attr raw;
+			if (!fetch_raw_attr(a, raw)) return false;
+			if (!raw) { out = opt<std::string>(); return true; }
+			const char *str = get_root().get_native_image()->string_value(raw);
+			if (!str) return false;
+			out = std::string(str);
+			return true;
+		}
+		bool basic_die::raw_get_flag(Dwarf_Half a, opt<bool>& out) const
+		{
+			native::raw_attr raw;
+			if (!fetch_raw_attr(a, raw)) return false;
+			if (!raw) { out = opt<bool>(); return true; }
+			out = get_root().get_native_image()->flag_value(raw);
+			return (bool) out;
+		}
+		bool basic_die::raw_get_unsigned(Dwarf_Half a, opt<Dwarf_Unsigned>& out) const
+		{
+			native::raw_attr raw;
+			if (!fetch_raw_attr(a, raw)) return false;
+			if (!raw) { out = opt<Dwarf_Unsigned>(); return true; }
+			opt<Dwarf_Signed> val = raw_constant(*get_root().get_native_image(), raw);
+			if (!val) return false;
+			out = (Dwarf_Unsigned) *val;
+			return true;
+		}
+		bool basic_die::raw_get_signed(Dwarf_Half a, opt<Dwarf_Signed>& out) const
+		{
+			native::raw_attr raw;
+			if (!fetch_raw_attr(a, raw)) return false;
+			if (!raw) { out = opt<Dwarf_Signed>(); return true; }
+			out = raw_constant(*get_root().get_native_image(), raw);
+			return (bool) out;
+		}
+		bool basic_die::raw_get_address(Dwarf_Half a, opt<encap::attribute_value::address>& out) const
+		{
+			native::raw_attr raw;
+			if (!fetch_raw_attr(a, raw)) return false;
+			if (!raw) { out = opt<encap::attribute_value::address>(); return true; }
+			/* Anything but DW_FORM_addr (e.g. a DWARF 4 high_pc, which is an
+			 * offset) goes the slow way, so it gets the same treatment as ever. */
+			opt<Dwarf_Addr> addr = get_root().get_native_image()->address_value(raw);
+			if (!addr) return false;
+			out = encap::attribute_value::address(*addr);
+			return true;
+		}
+		bool basic_die::raw_get_refiter(Dwarf_Half a, opt<iterator_df<basic_die> >& out) const
+		{
+			native::raw_attr raw;
+			if (!fetch_raw_attr(a, raw)) return false;
+			if (!raw) { out = opt<iterator_df<basic_die> >(); return true; }
+			opt<Dwarf_Off> off = get_root().get_native_image()->ref_value(raw);
+			if (!off) return false;
+			out = iterator_df<basic_die>(get_root().pos(*off));
+			return true;
+		}
+		bool basic_die::raw_get_refiter_is_type(Dwarf_Half a, opt<iterator_df<type_die> >& out) const
+		{
+			native::raw_attr raw;
+			if (!fetch_raw_attr(a, raw)) return false;
+			if (!raw) { out = opt<iterator_df<type_die> >(); return true; }
+			opt<Dwarf_Off> off = get_root().get_native_image()->ref_value(raw);
+			if (!off) return false;
+			out = iterator_df<type_die>(get_root().pos(*off));
+			return true;
+		}
 		iterator_base basic_die::find_definition() const
 		{
 			/* For most DIEs, we just return ourselves if we don't have DW_AT_specification. */
@@ -170,7 +308,10 @@ namespace dwarf
 		}
 		
 		root_die::root_die(int fd)
-		 :  dbg(fd), 
+		 :  concurrent(false),
+			fd(fd),
+			dbg(fd), 
+			recently_used_bytes(0),
 			refers_to_cache_is_complete(false),
 			visible_named_grandchildren_is_complete(false),
 			p_fs(new FrameSection(get_dbg(), true)), 
@@ -183,10 +324,197 @@ namespace dwarf
 			last_seen_offset_size(),
 			last_seen_extension_size(),
 			last_seen_next_cu_header()
-		{ assert(p_fs != 0); }
+		{
+			assert(p_fs != 0);
+			set_cache_policy(cache_policy());
+#if DWARFPP_NATIVE_DECODER
+			try
+			{
+				p_native.reset(new native::image(fd));
+			}
+			catch (No_entry)
+			{
+				debug(1) << "Native decoder can't handle this file; falling back to libdwarf" << endl;
+			}
+#endif
+		}
 		
 		root_die::~root_die() { delete p_fs; }
 		
+		void root_die::build_topology_index(unsigned nthreads /* = 1 */)
+		{
+			guard g(*this);
+			if (p_topology) return;
+			/* Build it fully before installing it, so that the libdwarf walk
+			 * doesn't try to consult a half-built index. */
+			std::unique_ptr<topology_index> p_built(
+				p_native ? new topology_index(*p_native, nthreads) : new topology_index(*this));
+			debug(2) << "Built topology index of " << p_built->size() << " DIEs in "
+				<< p_built->footprint() << " bytes" << endl;
+			p_topology = std::move(p_built);
+		}
+		
+		void root_die::build_name_index(unsigned nthreads /* = 1 */)
+		{
+			build_topology_index(nthreads);
+			guard g(*this);
+			if (p_names) return;
+			std::unique_ptr<name_index> p_built(p_native
+				? new name_index(*p_native, *p_topology, nthreads)
+				: new name_index(*this, *p_topology));
+			debug(2) << "Built name index of " << p_built->size() << " names in "
+				<< p_built->footprint() << " bytes" << endl;
+			p_names = std::move(p_built);
+		}
+		
+		void root_die::build_linkage_name_index(unsigned nthreads /* = 1 */)
+		{
+			build_topology_index(nthreads);
+			guard g(*this);
+			if (p_linkage_names) return;
+			std::unique_ptr<linkage_name_index> p_built(p_native
+				? new linkage_name_index(*p_native, *p_topology, nthreads)
+				: new linkage_name_index(*this, *p_topology));
+			debug(2) << "Built linkage name index of " << p_built->size() << " symbols in "
+				<< p_built->footprint() << " bytes" << endl;
+			p_linkage_names = std::move(p_built);
+		}
+		
+		std::vector<iterator_base> root_die::find_by_linkage_name(const string& name)
+		{
+			vector<topology_index::ordinal> found;
+			const cu_name_filters *filters;
+			{
+				guard g(*this);
+				/* In-memory DIEs have no symbols we index, so the filters
+				 * needn't know about them. */
+				filters = p_linkage_names ? nullptr : p_name_filters.get();
+			}
+			if (filters)
+			{
+				/* No need for the index if we can rule out most CUs. */
+				vector<Dwarf_Off> cus;
+				filters->candidate_cus(name, cus);
+				for (auto i_cu = cus.begin(); i_cu != cus.end(); ++i_cu)
+				{
+					topology_index::ordinal cu = p_topology->ordinal_of(*i_cu);
+					if (p_native) linkage_name_index::find_in_cu(*p_native, *p_topology, cu, name, found);
+					else linkage_name_index::find_in_cu(*this, *p_topology, cu, name, found);
+				}
+			}
+			else
+			{
+				build_linkage_name_index();
+				p_linkage_names->find(name, found);
+			}
+			std::vector<iterator_base> out;
+			for (auto i_o = found.begin(); i_o != found.end(); ++i_o)
+			{
+				out.push_back(pos(p_topology->offset(*i_o), p_topology->depth(*i_o),
+					p_topology->parent_offset(*i_o)));
+			}
+			return out;
+		}
+		
+		void root_die::build_name_filters(unsigned nthreads /* = 1 */)
+		{
+			build_topology_index(nthreads);
+			guard g(*this);
+			if (p_name_filters) return;
+			std::unique_ptr<cu_name_filters> p_built(p_native
+				? new cu_name_filters(*p_native, *p_topology, nthreads)
+				: new cu_name_filters(*this, *p_topology));
+			debug(2) << "Built name filters for " << p_built->cu_count() << " CUs in "
+				<< p_built->footprint() << " bytes" << endl;
+			p_name_filters = std::move(p_built);
+		}
+		
+		void root_die::build_sorted_name_table(unsigned nthreads /* = 1 */)
+		{
+			build_topology_index(nthreads);
+			guard g(*this);
+			if (p_sorted_names) return;
+			std::unique_ptr<sorted_name_table> p_built(p_native
+				? new sorted_name_table(*p_native, *p_topology, nthreads)
+				: new sorted_name_table(*this, *p_topology));
+			debug(2) << "Built sorted name table of " << p_built->size() << " names in "
+				<< p_built->footprint() << " bytes" << endl;
+			p_sorted_names = std::move(p_built);
+		}
+		
+		const accelerator_tables *root_die::name_accelerators()
+		{
+			guard g(*this);
+			if (!p_native) return nullptr;
+			if (!p_accelerators) p_accelerators.reset(new accelerator_tables(*p_native));
+			return p_accelerators.get();
+		}
+		
+		const topology_index& root_die::tag_postings()
+		{
+			guard g(*this);
+			if (!p_topology) build_topology_index();
+			if (!p_topology->has_postings()) p_topology->build_postings();
+			return *p_topology;
+		}
+		
+		void root_die::set_concurrent(bool c /* = true */)
+		{
+			/* Build the index first, while we're still single-threaded; it
+			 * can use as many threads as it likes. */
+			if (c) build_topology_index(0);
+			concurrent = c;
+		}
+		
+		void root_die::for_each_cu_in_workers(
+			const std::function<void(unsigned, const iterator_base&)>& work,
+			unsigned nthreads)
+		{
+			if (nthreads == 0) nthreads = std::max(1u, std::thread::hardware_concurrency());
+			/* Workers take CU numbers from here. Each walks the CU chain
+			 * in its own root, which only costs a header read per CU it
+			 * passes over, doing the ones it has taken. */
+			std::atomic<unsigned> next(0);
+			auto scan = [&work, &next](root_die& r) {
+				unsigned want = next++;
+				unsigned idx = 0;
+				for (iterator_base cu = r.first_child(r.begin()); cu != iterator_base::END; ++idx)
+				{
+					if (idx == want)
+					{
+						work(idx, cu);
+						want = next++;
+					}
+					if (!r.move_to_next_sibling(cu)) break;
+				}
+			};
+			if (fd == -1 || nthreads == 1) { scan(*this); return; }
+			
+			/* Open the workers' roots here, one at a time, since we
+			 * can't be sure that libdwarf's set-up is thread-safe. */
+			vector<std::unique_ptr<root_die> > workers;
+			for (unsigned t = 0; t < nthreads; ++t)
+			{
+				workers.emplace_back(new root_die(fd));
+				workers.back()->set_cache_policy(policy);
+			}
+			std::exception_ptr first_exception;
+			std::mutex exception_lock;
+			auto run = [&scan, &first_exception, &exception_lock](root_die *p_r) {
+				try { scan(*p_r); }
+				catch (...)
+				{
+					std::lock_guard<std::mutex> l(exception_lock);
+					if (!first_exception) first_exception = std::current_exception();
+				}
+			};
+			vector<std::thread> threads;
+			for (unsigned t = 1; t < nthreads; ++t) threads.emplace_back(run, workers[t].get());
+			run(workers[0].get());
+			for (auto i_t = threads.begin(); i_t != threads.end(); ++i_t) i_t->join();
+			if (first_exception) std::rethrow_exception(first_exception);
+		}
+		
 		::Elf *root_die::get_elf()
 		{
 			if (returned_elf) return returned_elf;
@@ -217,6 +545,7 @@ namespace dwarf
 		iterator_base 
 		root_die::parent(const iterator_base& it)
 		{
+			guard g(*this);
 			assert(&it.get_root() == this);
 			if (it.tag_here() == DW_TAG_compile_unit) 
 			{
@@ -227,7 +556,19 @@ namespace dwarf
 			else
 			{
 				assert(it.get_depth() > 0);
-				auto found = parent_of.find(it.offset_here());
+				if (p_topology)
+				{
+					auto o = p_topology->ordinal_of(it.offset_here());
+					if (o != topology_index::NONE)
+					{
+						/* CUs were dealt with above, so we have a real parent. */
+						auto p = p_topology->parent(o);
+						assert(p != topology_index::NONE);
+						return pos(p_topology->offset(p), p_topology->depth(p));
+					}
+					// else it's an in-memory DIE; use the cache
+				}
+				auto found = cached_parent_of(it.offset_here());
 				if (found == parent_of.end()) 
 				{
 					// find ourselves downwards, then try again
@@ -260,15 +601,29 @@ namespace dwarf
 			}
 		}
 		
+		unordered_map<Dwarf_Off, Dwarf_Off>::iterator
+		root_die::cached_parent_of(Dwarf_Off off)
+		{
+			auto found = parent_of.find(off);
+			native::location loc;
+			if (found == parent_of.end() && p_native && p_native->locate(off, loc))
+			{
+				found = parent_of.insert(make_pair(off, loc.parent)).first;
+			}
+			return found;
+		}
+		
 		bool 
 		root_die::move_to_parent(iterator_base& it)
 		{
 			auto maybe_parent = parent(it); 
 			if (maybe_parent != iterator_base::END) 
 			{
-				/* check we really got the parent! */
-				assert(parent_of.find(it.offset_here()) != parent_of.end());
-				assert(maybe_parent.offset_here() == parent_of[it.offset_here()]);
+				/* check we really got the parent! With a byte budget, making
+				 * its iterator may have evicted the edge, so don't insist. */
+				auto found = parent_of.find(it.offset_here());
+				assert(p_topology || policy.max_bytes || found != parent_of.end());
+				assert(found == parent_of.end() || maybe_parent.offset_here() == found->second);
 				it = std::move(maybe_parent); 
 				return true; 
 			}
@@ -284,11 +639,26 @@ namespace dwarf
 		iterator_base
 		root_die::first_child(const iterator_base& it)
 		{
+			guard g(*this);
 			assert(it.is_real_die_position() || it.is_root_position());
 			assert(&it.get_root() == this);
 			Dwarf_Off start_offset = it.offset_here();
 			Die::handle_type maybe_handle(nullptr, Die::deleter(nullptr)); // TODO: reenable deleter's default constructor
 			
+			if (p_topology)
+			{
+				auto o = (start_offset == 0UL) ? topology_index::NONE : p_topology->ordinal_of(start_offset);
+				if (start_offset == 0UL || o != topology_index::NONE)
+				{
+					auto c = (start_offset == 0UL) ? p_topology->first_top_level()
+						: p_topology->first_child(o);
+					if (c != topology_index::NONE) return pos(p_topology->offset(c), p_topology->depth(c));
+					/* The file has no children here, but we might have
+					 * created some in memory. If not, we're done. */
+					if (first_child_of.find(start_offset) == first_child_of.end()) return iterator_base::END;
+				}
+			}
+			
 			// check for cached edges 
 			auto found = first_child_of.find(start_offset);
 			if (found != first_child_of.end())
@@ -339,6 +709,34 @@ namespace dwarf
 		}
 		
 
+		Dwarf_Off
+		root_die::first_child_offset(const iterator_base& it)
+		{
+			guard g(*this);
+			assert(it.is_real_die_position() || it.is_root_position());
+			Dwarf_Off start_offset = it.offset_here();
+			// cached edges are always good, and cover in-memory children
+			auto found = first_child_of.find(start_offset);
+			if (found != first_child_of.end()) return found->second;
+			if (p_topology)
+			{
+				auto o = (start_offset == 0UL) ? topology_index::NONE : p_topology->ordinal_of(start_offset);
+				if (start_offset == 0UL || o != topology_index::NONE)
+				{
+					auto c = (start_offset == 0UL) ? p_topology->first_top_level()
+						: p_topology->first_child(o);
+					return (c == topology_index::NONE) ? 0UL : p_topology->offset(c);
+				}
+			}
+			if (p_native && start_offset != 0UL && p_native->is_die_offset(start_offset))
+			{
+				return p_native->first_child(start_offset);
+			}
+			// slow path: make the iterator (which records the edges for next time)
+			auto c = first_child(it);
+			return (c == iterator_base::END) ? 0UL : c.offset_here();
+		}
+
 		bool 
 		root_die::move_to_first_child(iterator_base& it)
 		{
@@ -348,13 +746,50 @@ namespace dwarf
 			{ it = std::move(maybe_child); assert(it.depth() == start_depth + 1); return true; }
 			else return false;
 		}
+		string_view root_die::intern_string(const char *s)
+		{
+			guard g(*this);
+			return string_view(*interned_strings.insert(string(s)).first);
+		}
 		iterator_base
 		root_die::find_named_child(const iterator_base& start, const string& name)
 		{
+			if (start.is_real_die_position() && start.is_a<with_named_children_die>())
+			{
+				Dwarf_Off parent_off = start.offset_here();
+				Dwarf_Off cu_off = start.enclosing_cu_offset_here();
+				opt<Dwarf_Off> found;
+				bool indexed;
+				{
+					guard g(*this);
+					const child_name_index& t = child_names[cu_off];
+					indexed = t.has_parent(parent_off);
+					if (indexed) found = t.find(parent_off, name);
+				}
+				if (!indexed)
+				{
+					/* Gather the names without holding the lock. */
+					vector<pair<string_view, Dwarf_Off> > named_children;
+					auto children = start.children_here();
+					for (auto i_child = std::move(children.first); i_child != children.second; ++i_child)
+					{
+						string_view child_name = i_child.name_view_here();
+						if (child_name.data()) named_children.push_back(
+							make_pair(child_name, i_child.offset_here()));
+					}
+					guard g(*this);
+					child_name_index& t = child_names[cu_off];
+					t.add_parent(parent_off, named_children);
+					found = t.find(parent_off, name);
+				}
+				if (!found) return iterator_base::END;
+				return pos(*found, start.depth() + 1, parent_off);
+			}
 			auto children = start.children_here();
 			for (auto i_child = std::move(children.first); i_child != children.second; ++i_child)
 			{
-				if (i_child.name_here() && *i_child.name_here() == name)
+				string_view child_name = i_child.name_view_here();
+				if (child_name.data() && child_name == name)
 				{
 					return std::move(i_child);
 				}
@@ -382,8 +817,139 @@ namespace dwarf
 			return found;
 		}
 		
+		std::vector<iterator_base>
+		root_die::find_visible_grandchildren_with_prefix(const string& prefix)
+		{
+			build_sorted_name_table();
+			vector<topology_index::ordinal> found;
+			p_sorted_names->find_prefix(prefix, found);
+			return sorted_name_results(found, prefix, nullptr);
+		}
+		
+		std::vector<iterator_base>
+		root_die::find_visible_grandchildren_matching(const string& pattern)
+		{
+			build_sorted_name_table();
+			vector<topology_index::ordinal> found;
+			p_sorted_names->find_glob(pattern, found);
+			return sorted_name_results(found, sorted_name_table::glob_literal_prefix(pattern), &pattern);
+		}
+		
+		std::vector<iterator_base>
+		root_die::sorted_name_results(const vector<topology_index::ordinal>& found,
+			const string& prefix, const string *pattern)
+		{
+			/* The cache is sorted too, so its in-memory DIEs with the
+			 * prefix are a run. */
+			vector<Dwarf_Off> in_memory;
+			{
+				guard g(*this);
+				for (auto i_c = visible_named_grandchildren_cache.lower_bound(prefix);
+					i_c != visible_named_grandchildren_cache.end()
+						&& i_c->first.compare(0, prefix.size(), prefix) == 0;
+					++i_c)
+				{
+					if (p_topology->ordinal_of(i_c->second) != topology_index::NONE) continue;
+					if (pattern && !sorted_name_table::glob_match(*pattern, i_c->first)) continue;
+					in_memory.push_back(i_c->second);
+				}
+			}
+			std::vector<iterator_base> out;
+			for (auto i_o = found.begin(); i_o != found.end(); ++i_o)
+			{
+				out.push_back(pos(p_topology->offset(*i_o), 2, p_topology->parent_offset(*i_o)));
+			}
+			for (auto i_m = in_memory.begin(); i_m != in_memory.end(); ++i_m) out.push_back(pos(*i_m, 2));
+			return out;
+		}
+		
+		std::vector<iterator_base>
+		root_die::scoped_resolve_each(const iterator_base& start, const std::vector<string>& names)
+		{
+			std::vector<iterator_base> results(names.size(), iterator_base::END);
+			vector<unsigned> pending;
+			for (unsigned i = 0; i < names.size(); ++i) pending.push_back(i);
+			
+			/* Outwards through the enclosing scopes, as scoped_resolve_all() goes. */
+			iterator_base scope = start;
+			bool at_root = false;
+			while (!pending.empty() && !at_root)
+			{
+				vector<unsigned> still_pending;
+				for (auto i_p = pending.begin(); i_p != pending.end(); ++i_p)
+				{
+					iterator_base found = scope.named_child(names[*i_p]);
+					if (found) results[*i_p] = std::move(found);
+					else still_pending.push_back(*i_p);
+				}
+				pending.swap(still_pending);
+				do
+				{
+					move_to_parent(scope);
+					at_root = (scope.tag_here() == 0);
+				} while (!at_root && !scope.is_a<with_named_children_die>());
+			}
+			if (pending.empty()) return results;
+			
+			/* The rest are looked for among the root's visible grandchildren.
+			 * If the name index or the cache can answer each one directly,
+			 * let them. Otherwise try the producer's tables, then walk the
+			 * grandchildren once for all the names they didn't know. */
+			bool walk;
+			bool pruned;
+			{
+				guard g(*this);
+				walk = !p_names && !visible_named_grandchildren_is_complete;
+				pruned = p_name_filters.get();
+			}
+			if (walk && name_accelerators())
+			{
+				vector<unsigned> still_pending;
+				for (auto i_p = pending.begin(); i_p != pending.end(); ++i_p)
+				{
+					vector<Dwarf_Off> found;
+					p_accelerators->find(names[*i_p], found);
+					if (!found.empty()) results[*i_p] = pos(found.front(), 2);
+					else still_pending.push_back(*i_p);
+				}
+				pending.swap(still_pending);
+			}
+			/* With the name filters, each name's search only visits a few
+			 * CUs, which beats one walk of them all. */
+			if (!walk || pruned)
+			{
+				for (auto i_p = pending.begin(); i_p != pending.end(); ++i_p)
+				{
+					results[*i_p] = find_visible_grandchild_named(names[*i_p]);
+				}
+				return results;
+			}
+			struct name_hash
+			{
+				size_t operator()(string_view s) const { return name_index::hash(s); }
+			};
+			std::unordered_map<string_view, vector<unsigned>, name_hash> wanted;
+			for (auto i_p = pending.begin(); i_p != pending.end(); ++i_p)
+			{
+				wanted[string_view(names[*i_p])].push_back(*i_p);
+			}
+			auto vg_seq = visible_named_grandchildren();
+			for (auto i_g = std::move(vg_seq.first); i_g != vg_seq.second && !wanted.empty(); ++i_g)
+			{
+				auto found = wanted.find(i_g.name_view_here());
+				if (found == wanted.end()) continue;
+				for (auto i_i = found->second.begin(); i_i != found->second.end(); ++i_i)
+				{
+					results[*i_i] = i_g;
+				}
+				wanted.erase(found);
+			}
+			return results;
+		}
+		
 		void root_die::ensure_refers_to_cache_is_complete()
 		{
+			guard g(*this);
 			// We need to traverse all attributes, and for the ones that are refiters,
 			// ensure they're in the cache. Fortunately, get_referential_structure()
 			// already does this. So let's just call that. We throw away the data
@@ -408,6 +974,7 @@ namespace dwarf
 		
 		bool root_die::advance_cu_context()
 		{
+			guard g(*this);
 			Dwarf_Unsigned seen_cu_header_length;
 			Dwarf_Half seen_version_stamp;
 			Dwarf_Unsigned seen_abbrev_offset;
@@ -483,6 +1050,7 @@ namespace dwarf
 		}
 		bool root_die::clear_cu_context()
 		{
+			guard g(*this);
 			if (current_cu_offset == 0UL) return true;
 			while(advance_cu_context());
 			return true; // i.e. success
@@ -517,6 +1085,7 @@ namespace dwarf
 		}
 		bool root_die::set_cu_context(Dwarf_Off off)
 		{
+			guard g(*this);
 			bool ret = set_subsequent_cu_context(off);
 			if (!ret)
 			{
@@ -530,23 +1099,39 @@ namespace dwarf
 		iterator_base
 		root_die::next_sibling(const iterator_base& it)
 		{
+			guard g(*this);
 			assert(&it.get_root() == this);
 			if (!it.is_real_die_position()) return iterator_base::END;
 
 			Dwarf_Off offset_here = it.offset_here();
-			// check for cached edges 
+			if (p_topology)
+			{
+				auto o = p_topology->ordinal_of(offset_here);
+				if (o != topology_index::NONE)
+				{
+					auto s = p_topology->next_sibling(o);
+					if (s != topology_index::NONE) return pos(p_topology->offset(s), p_topology->depth(s));
+					/* As in first_child(): only in-memory DIEs can follow. */
+					if (next_sibling_of.find(offset_here) == next_sibling_of.end()) return iterator_base::END;
+				}
+			}
+			/* Check for cached edges. We keep the offsets, not iterators into
+			 * the caches, since making handles and iterators below can evict
+			 * from them or make them rehash. */
+			opt<Dwarf_Off> cached_sibling;
 			auto found_cached_sibling = next_sibling_of.find(offset_here);
 			if (found_cached_sibling != next_sibling_of.end())
 			{
-				auto found_live = live_dies.find(found_cached_sibling->second);
+				cached_sibling = found_cached_sibling->second;
+				auto found_live = live_dies.find(*cached_sibling);
 				if (found_live != live_dies.end())
 				{
-					assert(found_live->second->get_offset() == found_cached_sibling->second);
+					assert(found_live->second->get_offset() == *cached_sibling);
 					return iterator_base(static_cast<abstract_die&&>(*found_live->second), it.depth(), *this);
 				} // else fall through
 			}
 			
-			auto found_cached_parent = parent_of.find(offset_here);
+			auto found_cached_parent = cached_parent_of(offset_here);
 			// if we issued `it', we should have recorded its parent
 			// FIXME: relax this policy perhaps, to allow soft cache?
 			assert(found_cached_parent != parent_of.end());
@@ -576,8 +1161,7 @@ namespace dwarf
 				// install in parent cache
 				parent_of[new_it.offset_here()] = common_parent_offset;
 				// ditto for sibling cache -- but check we agree with what's already there
-				assert(found_cached_sibling == next_sibling_of.end()
-					|| found_cached_sibling->second == new_it.offset_here());
+				assert(!cached_sibling || *cached_sibling == new_it.offset_here());
 				next_sibling_of[offset_here] = new_it.offset_here();
 				return new_it;
 			} else return iterator_base::END;
@@ -602,6 +1186,7 @@ namespace dwarf
 		root_die::ptr_type 
 		root_die::make_payload(const iterator_base& it) // note: we update *mutable* fields
 		{
+			guard g(*this);
 			/* This call is asking us to heap-allocate the state of the iterator
 			 * and upgrade the iterator so that it is copyable. There are some exceptions:
 			 * root and END iterators have no handle, so they can be copied directly. */
@@ -611,15 +1196,16 @@ namespace dwarf
 			{
 				assert(it.state == iterator_base::HANDLE_ONLY);
 
-				// assert we're *not* sticky -- 
-				// iterators with handles should not be created in the sticky case.
-				// Whenever we construct an iterator, we build sticky payload if necessary.
-				assert(!is_sticky(it.get_handle()));
+				/* Whenever we construct an iterator, we build sticky payload if
+				 * necessary, so iterators with handles are usually not sticky.
+				 * But the cache policy may have changed since this one was made. */
+				bool sticky = is_sticky(it.get_handle());
 				
 				// we might be live. refcount will get bumped if so
 				auto found_live = live_dies.find(it.offset_here());
 				if (found_live != live_dies.end())
 				{
+					note_used(found_live->second, false);
 					return found_live->second;
 				}
 				
@@ -633,6 +1219,12 @@ namespace dwarf
 				{
 					debug(6) << "Warning: made payload for non-CU at 0x" << std::hex << it.offset_here() << std::dec << endl;
 				}
+				if (sticky) sticky_dies[it.offset_here()] = it.cur_payload;
+				else
+				{
+					note_used(it.cur_payload.get(), true);
+					enforce_cache_policy();
+				}
 				return it.cur_payload;
 			}
 		}
@@ -640,6 +1232,7 @@ namespace dwarf
 		iterator_df<compile_unit_die>
 		root_die::get_or_create_synthetic_cu()
 		{
+			guard g(*this);
 			if (this->synthetic_cu)
 			{
 				return find(*this->synthetic_cu).as_a<compile_unit_die>();
@@ -648,7 +1241,7 @@ namespace dwarf
 			auto created = make_new(begin(), DW_TAG_compile_unit);
 			/* Set attributes. We must have a DW_AT_language. We pretend we're C.
 			 * FIXME: should have one synthetic CU per language requested? */
-			auto& attrs = dynamic_cast<core::in_memory_abstract_die&>(created.dereference()).attrs();
+			auto& attrs = created.dereference().as_in_memory()->attrs();
 			encap::attribute_value v_lang((Dwarf_Unsigned) DW_LANG_C);
 			attrs.insert(make_pair(DW_AT_language, v_lang));
 			encap::attribute_value v_name(std::string("dwarfpp.synthetic"));
@@ -662,13 +1255,16 @@ namespace dwarf
 		iterator_base
 		root_die::make_new(const iterator_base& parent, Dwarf_Half tag)
 		{
+			guard g(*this);
 			/* heap-allocate the right kind of (in-memory) DIE, 
 			 * creating the intrusive ptr, hence bumping the refcount */
 			auto& spec = parent.is_root_position() ? DEFAULT_DWARF_SPEC : parent.enclosing_cu().spec_here();
 			root_die::ptr_type p = core::factory::for_spec(spec).make_new(parent, tag);
-			Dwarf_Off o = dynamic_cast<in_memory_abstract_die&>(*p).get_offset();
+			Dwarf_Off o = p->as_in_memory()->get_offset();
 			sticky_dies.insert(make_pair(o, p));
 			assert(live_dies.find(o) != live_dies.end());
+			/* It might be the definition some declaration was missing. */
+			note_in_memory_edit(p->as_in_memory()->get_enclosing_cu_offset());
 			parent_of.insert(make_pair(o, parent.offset_here()));
 			auto found = find(o);
 			assert(found);
@@ -694,7 +1290,255 @@ namespace dwarf
 			 * caller will still need the handle. 
 			 * HMM -- now tried changing it so the caller passes us the Die. */
 			
-			return d.get_tag() == DW_TAG_compile_unit;
+			Dwarf_Half tag = d.get_tag();
+			return tag < sticky_tag_bits.size() && sticky_tag_bits[tag];
+		}
+		
+		void root_die::set_cache_policy(const cache_policy& p)
+		{
+			guard g(*this);
+			policy = p;
+			/* is_sticky() is hot, so make it a bit test. */
+			sticky_tag_bits.assign(p.sticky_tags.empty() ? 0 : *p.sticky_tags.rbegin() + 1, false);
+			for (auto i_t = p.sticky_tags.begin(); i_t != p.sticky_tags.end(); ++i_t)
+			{
+				sticky_tag_bits[*i_t] = true;
+			}
+			if (!policy.max_bytes)
+			{
+				recently_used.clear();
+				recently_used_pos.clear();
+				recently_used_bytes = 0;
+			}
+			else enforce_cache_policy();
+			if (!policy.memoize_effective_attrs) effective_attrs_cache.clear();
+			if (!policy.memoize_scoped_resolve) scoped_resolve_cache.clear();
+		}
+		
+		void root_die::note_used(basic_die *p, bool is_new)
+		{
+			if (!policy.max_bytes) return;
+			if (!is_new)
+			{
+				/* Only move it up if we're keeping it already. Otherwise it's
+				 * sticky, or its users are keeping it alive anyway. */
+				auto found = recently_used_pos.find(p->get_offset());
+				if (found != recently_used_pos.end() && found->second != recently_used.begin())
+				{
+					recently_used.splice(recently_used.begin(), recently_used, found->second);
+				}
+				return;
+			}
+			size_t sz = p->payload_size();
+			recently_used.push_front(make_pair(ptr_type(p), sz));
+			recently_used_pos[p->get_offset()] = recently_used.begin();
+			recently_used_bytes += sz;
+		}
+		
+		template <typename Map>
+		static size_t estimated_bytes(const Map& m)
+		{
+			/* a node holding the entry, plus about three pointers' worth of
+			 * links and buckets */
+			return m.size() * (sizeof (typename Map::value_type) + 3 * sizeof (void*));
+		}
+		
+		size_t root_die::navigation_cache_bytes() const
+		{
+			return estimated_bytes(parent_of) + estimated_bytes(first_child_of)
+				+ estimated_bytes(next_sibling_of);
+		}
+		
+		void root_die::evict_navigation_caches()
+		{
+			/* We can only forget edges between DIEs in the file, and only if
+			 * something can tell us them again without walking from the root.
+			 * Edges to or from in-memory DIEs have to stay. */
+			if (!p_topology && !p_native) return;
+			/* In-memory DIEs get offsets just past something in the file, so
+			 * they may well decode as DIEs. Only an offset that locate() finds
+			 * by walking the unit, and that no in-memory DIE has taken, counts. */
+			auto from_file = [this](Dwarf_Off o) {
+				if (o == 0UL) return true;
+				if (p_topology) return p_topology->ordinal_of(o) != topology_index::NONE;
+				auto found_sticky = sticky_dies.find(o);
+				if (found_sticky != sticky_dies.end() && found_sticky->second->as_in_memory()) return false;
+				native::location loc;
+				return p_native->locate(o, loc);
+			};
+			auto evict_from = [from_file](unordered_map<Dwarf_Off, Dwarf_Off>& m) {
+				for (auto i = m.begin(); i != m.end(); )
+				{
+					if (from_file(i->first) && from_file(i->second)) i = m.erase(i);
+					else ++i;
+				}
+			};
+			evict_from(parent_of);
+			evict_from(first_child_of);
+			evict_from(next_sibling_of);
+		}
+		
+		void root_die::enforce_cache_policy()
+		{
+			if (!policy.max_bytes) return;
+			/* Evict the least recently used payloads first, but never the one
+			 * we've just been asked for. */
+			while (recently_used.size() > 1
+				&& recently_used_bytes + navigation_cache_bytes() > policy.max_bytes)
+			{
+				auto& victim = recently_used.back();
+				recently_used_pos.erase(victim.first->get_offset());
+				recently_used_bytes -= victim.second;
+				recently_used.pop_back(); // deletes it, unless someone else has it
+			}
+			/* Still too big? The navigation caches are what's left. It's not
+			 * worth doing these one at a time: most of them go. */
+			if (recently_used_bytes + navigation_cache_bytes() > policy.max_bytes)
+			{
+				evict_navigation_caches();
+			}
+		}
+		
+		void root_die::evict_caches()
+		{
+			guard g(*this);
+			recently_used.clear();
+			recently_used_pos.clear();
+			recently_used_bytes = 0;
+			evict_navigation_caches();
+			refers_to.clear();
+			referred_from.clear();
+			refers_to_cache_is_complete = false;
+			/* In-memory DIEs' names are found again by the next exhaustive walk. */
+			visible_named_grandchildren_cache.clear();
+			visible_named_grandchildren_is_complete = false;
+			equivalence_class_of.clear();
+			equivalence_classes_by_summary_code.clear();
+			equivalence_classes.clear();
+			effective_attrs_cache.clear();
+			compiled_loclists.clear();
+			child_names.clear();
+			scoped_resolve_cache.clear();
+			/* Nothing else refers to interned strings between queries. */
+			if (!p_names && !p_sorted_names && !p_linkage_names) interned_strings.clear();
+		}
+		
+		void root_die::build_effective_attrs_cache()
+		{
+			if (!policy.memoize_effective_attrs) return;
+			for (auto i = begin(); i != end(); ++i)
+			{
+				if (i.has_attr_here(DW_AT_abstract_origin) || i.has_attr_here(DW_AT_specification)
+					|| i.has_attr_here(DW_AT_declaration))
+				{
+					i->find_all_attrs();
+				}
+			}
+		}
+		
+		void root_die::invalidate_effective_attrs_cache()
+		{
+			guard g(*this);
+			effective_attrs_cache.clear();
+		}
+		
+		void root_die::note_in_memory_edit(Dwarf_Off cu_off)
+		{
+			guard g(*this);
+			auto found = std::lower_bound(cus_edited_in_memory.begin(),
+				cus_edited_in_memory.end(), cu_off);
+			if (found == cus_edited_in_memory.end() || *found != cu_off)
+			{
+				cus_edited_in_memory.insert(found, cu_off);
+			}
+			effective_attrs_cache.clear();
+			compiled_loclists.clear();
+			child_names.clear();
+			scoped_resolve_cache.clear();
+		}
+		
+		std::shared_ptr<const encap::compiled_loclist>
+		root_die::compiled_loclist_for(const iterator_base& it, Dwarf_Half attr)
+		{
+			guard g(*this);
+			auto k = make_pair(it.offset_here(), attr);
+			auto found = compiled_loclists.find(k);
+			if (found != compiled_loclists.end()) return found->second;
+			
+			encap::attribute_value v = it->find_attr(attr);
+			std::shared_ptr<const encap::compiled_loclist> p;
+			if (v.is_loclist())
+			{
+				iterator_df<compile_unit_die> i_cu = cu_pos(it.enclosing_cu_offset_here());
+				Dwarf_Addr cu_base = (i_cu && i_cu->get_low_pc()) ? i_cu->get_low_pc()->addr : 0;
+				p = std::make_shared<const encap::compiled_loclist>(v.get_loclist(), cu_base);
+			}
+			else p = std::make_shared<const encap::compiled_loclist>();
+			compiled_loclists.insert(make_pair(k, p));
+			return p;
+		}
+		
+		root_die::cache_footprint root_die::get_cache_footprint() const
+		{
+			guard g(*this);
+			cache_footprint f;
+			f.live_payloads = live_dies.size();
+			f.sticky_payloads = sticky_dies.size();
+			f.retained_payloads = recently_used.size();
+			f.payload_bytes = 0;
+			for (auto i_d = live_dies.begin(); i_d != live_dies.end(); ++i_d)
+			{
+				f.payload_bytes += i_d->second->payload_size();
+			}
+			f.cache_entries = parent_of.size() + first_child_of.size() + next_sibling_of.size()
+				+ refers_to.size() + referred_from.size()
+				+ visible_named_grandchildren_cache.size() + equivalence_class_of.size()
+				+ effective_attrs_cache.size() + compiled_loclists.size()
+				+ scoped_resolve_cache.size() + interned_strings.size();
+			f.cache_bytes = navigation_cache_bytes()
+				+ estimated_bytes(refers_to) + estimated_bytes(referred_from)
+				+ estimated_bytes(visible_named_grandchildren_cache)
+				+ estimated_bytes(equivalence_class_of)
+				+ estimated_bytes(effective_attrs_cache)
+				+ estimated_bytes(compiled_loclists)
+				+ estimated_bytes(scoped_resolve_cache)
+				+ estimated_bytes(interned_strings)
+				+ estimated_bytes(live_dies) + estimated_bytes(sticky_dies)
+				+ estimated_bytes(recently_used) + estimated_bytes(recently_used_pos);
+			for (auto i_cl = equivalence_classes.begin(); i_cl != equivalence_classes.end(); ++i_cl)
+			{
+				f.cache_bytes += estimated_bytes(*i_cl);
+			}
+			for (auto i_ll = compiled_loclists.begin(); i_ll != compiled_loclists.end(); ++i_ll)
+			{
+				f.cache_bytes += i_ll->second->ranges.size() * sizeof (encap::compiled_loclist::range);
+				for (auto i_e = i_ll->second->exprs.begin(); i_e != i_ll->second->exprs.end(); ++i_e)
+				{
+					f.cache_bytes += sizeof (encap::loc_expr) + i_e->size() * sizeof (encap::expr_instr);
+				}
+			}
+			for (auto i_s = scoped_resolve_cache.begin(); i_s != scoped_resolve_cache.end(); ++i_s)
+			{
+				f.cache_bytes += std::get<2>(i_s->first).capacity()
+					+ i_s->second.capacity() * sizeof (i_s->second[0]);
+			}
+			for (auto i_s = interned_strings.begin(); i_s != interned_strings.end(); ++i_s)
+			{
+				f.cache_bytes += i_s->capacity();
+			}
+			for (auto i_cu = child_names.begin(); i_cu != child_names.end(); ++i_cu)
+			{
+				f.cache_entries += i_cu->second.size();
+				f.cache_bytes += i_cu->second.footprint();
+			}
+			f.index_bytes = (p_topology ? p_topology->footprint() : 0)
+				+ (p_names ? p_names->footprint() : 0)
+				+ (p_linkage_names ? p_linkage_names->footprint() : 0)
+				+ (p_name_filters ? p_name_filters->footprint() : 0)
+				+ (p_sorted_names ? p_sorted_names->footprint() : 0)
+				+ (p_accelerators ? p_accelerators->footprint() : 0);
+			f.pool_bytes = pool.footprint();
+			return f;
 		}
 		
 		void
@@ -702,6 +1546,7 @@ namespace dwarf
 			unordered_map<Dwarf_Off, Dwarf_Off>& parent_of,
 			map<pair<Dwarf_Off, Dwarf_Half>, Dwarf_Off>& refers_to) const
 		{
+			guard g(*this);
 			/* We walk the whole tree depth-first. 
 			 * If we see any attributes that are references, we follow them. 
 			 * Then we return our maps. */
@@ -727,6 +1572,11 @@ namespace dwarf
 			}
 			
 			parent_of = this->parent_of;
+			/* With a topology index, the walk above didn't fill parent_of. */
+			if (p_topology) for (topology_index::ordinal o = 0; o < p_topology->size(); ++o)
+			{
+				parent_of[p_topology->offset(o)] = p_topology->parent_offset(o);
+			}
 			refers_to = this->refers_to;
 		}
 		
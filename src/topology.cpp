@@ -0,0 +1,264 @@
+/* dwarfpp: C++ binding for a useful subset of libdwarf, plus extra goodies.
+ *
+ * topology.cpp: dense array-based index of the DIE tree's shape
+ *
+ * Copyright (c) 2008--17, Stephen Kell. For licensing information, see the
+ * LICENSE file in the root of the libdwarfpp tree.
+ */
+
+#include "dwarfpp/topology.hpp"
+#include "dwarfpp/native.hpp"
+#include "dwarfpp/root.hpp"
+#include "dwarfpp/root-inl.hpp"
+#include "dwarfpp/iter.hpp"
+#include "dwarfpp/iter-inl.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <thread>
+
+namespace dwarf
+{
+	using std::endl;
+	namespace core
+	{
+		const topology_index::ordinal topology_index::NONE;
+
+		void topology_index::close_to(unsigned short depth)
+		{
+			while (open.size() > depth)
+			{
+				ordinal o = open.back();
+				subtree_sizes[o] = offsets.size() - o;
+				open.pop_back();
+			}
+		}
+
+		void topology_index::begin_die(Dwarf_Off off, Dwarf_Half tag, unsigned short depth)
+		{
+			assert(depth >= 1);
+			/* Our binary search relies on pre-order being offset order.
+			 * That's true of DWARF, and fresh_offset_under() maintains it
+			 * for in-memory DIEs. */
+			assert(offsets.empty() || off > offsets.back());
+			close_to(depth - 1);
+			assert(open.size() == depth - 1u);
+			ordinal o = offsets.size();
+			offsets.push_back(off);
+			tags.push_back(tag);
+			depths.push_back(depth);
+			parents.push_back(open.empty() ? NONE : open.back());
+			next_siblings.push_back(NONE);
+			subtree_sizes.push_back(1); // fixed up by close_to()
+
+			// the last DIE we saw at this depth (under the same parent) is our prev sibling
+			if (last_at_depth.size() > depth && last_at_depth[depth] != NONE)
+			{
+				next_siblings[last_at_depth[depth]] = o;
+			}
+			// anything deeper belonged to an earlier subtree
+			last_at_depth.resize(depth + 1, NONE);
+			last_at_depth[depth] = o;
+			open.push_back(o);
+		}
+
+		void topology_index::finish()
+		{
+			close_to(0);
+			vector<ordinal>().swap(open);
+			vector<ordinal>().swap(last_at_depth);
+		}
+
+		void topology_index::point_at_vectors()
+		{
+			a.n = offsets.size();
+			a.offsets = offsets.data();
+			a.tags = tags.data();
+			a.depths = depths.data();
+			a.parents = parents.data();
+			a.next_siblings = next_siblings.data();
+			a.subtree_sizes = subtree_sizes.data();
+		}
+
+		void topology_index::index_unit(const native::image& img, const native::unit& u)
+		{
+			Dwarf_Off cur = u.first_die;
+			unsigned short depth = 1;
+			native::cursor c;
+			/* Walk the unit's DIEs in order. A DIE with children pushes
+			 * us down a level; a null entry brings us back up. We stop
+			 * when we're back at top level, so any padding after the
+			 * unit's DIE is ignored. */
+			do
+			{
+				if (!img.decode(cur, &u, c)) break;
+				if (!c.p_abbrev)
+				{
+					++cur; // a null entry is one byte
+					--depth;
+					continue;
+				}
+				begin_die(cur, c.p_abbrev->tag, depth);
+				cur = img.skip_attrs(c) - img.info_section().begin;
+				if (c.p_abbrev->has_children) ++depth;
+			} while (depth > 1);
+		}
+
+		void topology_index::merge_pieces(vector<topology_index>& pieces, unsigned nthreads)
+		{
+			vector<ordinal> bases(pieces.size());
+			ordinal total = 0;
+			for (unsigned i = 0; i < pieces.size(); ++i)
+			{
+				bases[i] = total;
+				total += pieces[i].offsets.size();
+			}
+			offsets.resize(total);
+			tags.resize(total);
+			depths.resize(total);
+			parents.resize(total);
+			next_siblings.resize(total);
+			subtree_sizes.resize(total);
+			
+			/* Copying is as parallel as building was. Afterwards we can
+			 * throw each piece away. */
+			parallel_for_each_index(pieces.size(), nthreads, [this, &pieces, &bases](size_t i) {
+				topology_index& piece = pieces[i];
+				ordinal base = bases[i];
+				auto rebase = [base](ordinal o) { return (o == NONE) ? NONE : o + base; };
+				std::copy(piece.offsets.begin(), piece.offsets.end(), offsets.begin() + base);
+				std::copy(piece.tags.begin(), piece.tags.end(), tags.begin() + base);
+				std::copy(piece.depths.begin(), piece.depths.end(), depths.begin() + base);
+				std::copy(piece.subtree_sizes.begin(), piece.subtree_sizes.end(),
+					subtree_sizes.begin() + base);
+				std::transform(piece.parents.begin(), piece.parents.end(),
+					parents.begin() + base, rebase);
+				std::transform(piece.next_siblings.begin(), piece.next_siblings.end(),
+					next_siblings.begin() + base, rebase);
+				piece = topology_index();
+			});
+			
+			/* Finally, link up the CUs, skipping any empty units. */
+			ordinal prev_cu = NONE;
+			for (unsigned i = 0; i < bases.size(); ++i)
+			{
+				ordinal piece_size = ((i + 1 < bases.size()) ? bases[i + 1] : total) - bases[i];
+				if (piece_size == 0) continue;
+				if (prev_cu != NONE) next_siblings[prev_cu] = bases[i];
+				prev_cu = bases[i];
+			}
+		}
+
+		topology_index::topology_index(const native::image& img, unsigned nthreads)
+		{
+			auto& units = img.get_units();
+			if (nthreads == 0) nthreads = std::max(1u, std::thread::hardware_concurrency());
+			if (nthreads > 1 && units.size() > 1)
+			{
+				vector<topology_index> pieces(units.size());
+				parallel_for_each_index(units.size(), nthreads, [&img, &units, &pieces](size_t i) {
+					topology_index& piece = pieces[i];
+					Dwarf_Off guess = (units[i].end - units[i].offset) / 12;
+					piece.offsets.reserve(guess);
+					piece.tags.reserve(guess);
+					piece.depths.reserve(guess);
+					piece.parents.reserve(guess);
+					piece.next_siblings.reserve(guess);
+					piece.subtree_sizes.reserve(guess);
+					piece.index_unit(img, units[i]);
+					piece.finish();
+				});
+				merge_pieces(pieces, nthreads);
+				point_at_vectors();
+				return;
+			}
+			
+			/* Guess the DIE count to save most of the reallocation. DIEs
+			 * average out at rather more than a dozen bytes in practice. */
+			Dwarf_Off guess = img.info_section().size() / 12;
+			offsets.reserve(guess);
+			tags.reserve(guess);
+			depths.reserve(guess);
+			parents.reserve(guess);
+			next_siblings.reserve(guess);
+			subtree_sizes.reserve(guess);
+			for (auto i_u = units.begin(); i_u != units.end(); ++i_u)
+			{
+				index_unit(img, *i_u);
+			}
+			finish();
+			offsets.shrink_to_fit();
+			tags.shrink_to_fit();
+			depths.shrink_to_fit();
+			parents.shrink_to_fit();
+			next_siblings.shrink_to_fit();
+			subtree_sizes.shrink_to_fit();
+			point_at_vectors();
+		}
+
+		topology_index::topology_index(root_die& r)
+		{
+			for (iterator_df<> i = r.begin(); i != iterator_base::END; ++i)
+			{
+				if (i.is_root_position()) continue;
+				begin_die(i.offset_here(), i.tag_here(), i.depth());
+			}
+			finish();
+			point_at_vectors();
+		}
+
+		topology_index::ordinal topology_index::ordinal_of(Dwarf_Off off) const
+		{
+			const Dwarf_Off *end = a.offsets + a.n;
+			const Dwarf_Off *found = std::lower_bound(a.offsets, end, off);
+			if (found == end || *found != off) return NONE;
+			return found - a.offsets;
+		}
+
+		void topology_index::build_postings()
+		{
+			if (has_postings()) return;
+			/* A counting sort by tag. Tags are 16 bits, so count them all. */
+			vector<ordinal> counts(65536);
+			for (ordinal o = 0; o < a.n; ++o) ++counts[a.tags[o]];
+			vector<ordinal> next_slot(65536);
+			ordinal total = 0;
+			for (unsigned t = 0; t < 65536; ++t)
+			{
+				if (counts[t] == 0) continue;
+				posting_tags.push_back(t);
+				posting_starts.push_back(total);
+				next_slot[t] = total;
+				total += counts[t];
+			}
+			posting_starts.push_back(total);
+			posting_ordinals.resize(total);
+			for (ordinal o = 0; o < a.n; ++o) posting_ordinals[next_slot[a.tags[o]]++] = o;
+		}
+
+		std::pair<const topology_index::ordinal *, const topology_index::ordinal *>
+		topology_index::with_tag(Dwarf_Half tag) const
+		{
+			assert(has_postings());
+			auto found = std::lower_bound(posting_tags.begin(), posting_tags.end(), tag);
+			if (found == posting_tags.end() || *found != tag)
+			{
+				return std::make_pair(nullptr, nullptr);
+			}
+			unsigned i = found - posting_tags.begin();
+			const ordinal *base = posting_ordinals.data();
+			return std::make_pair(base + posting_starts[i], base + posting_starts[i + 1]);
+		}
+
+		size_t topology_index::footprint() const
+		{
+			return offsets.capacity() * sizeof (Dwarf_Off)
+				+ tags.capacity() * sizeof (Dwarf_Half)
+				+ depths.capacity() * sizeof (unsigned short)
+				+ (parents.capacity() + next_siblings.capacity() + subtree_sizes.capacity())
+					* sizeof (ordinal)
+				+ posting_tags.capacity() * sizeof (Dwarf_Half)
+				+ (posting_starts.capacity() + posting_ordinals.capacity()) * sizeof (ordinal);
+		}
+	}
+}
@@ -0,0 +1,82 @@
+#undef NDEBUG // assert is part of our logic
+#include <fstream>
+#include <map>
+#include <fileno.hpp>
+#include <dwarfpp/lib.hpp>
+
+using std::cout;
+using std::endl;
+using namespace dwarf;
+using namespace dwarf::lib;
+using core::iterator_df;
+
+int main(int argc, char **argv)
+{
+	cout << "Opening " << argv[0] << "..." << endl;
+	std::ifstream in(argv[0]);
+	assert(in);
+	core::root_die root(fileno(in));
+
+	unsigned ndies = 0, nmerged = 0;
+	for (iterator_df<> i = root.begin(); i != root.end(); ++i)
+	{
+		if (i.is_root_position()) continue;
+		++ndies;
+		encap::attribute_map m = i.copy_attrs();
+		/* Sorted and unique, and lookups agree with the DIE. */
+		for (auto i_attr = m.begin(); i_attr != m.end(); ++i_attr)
+		{
+			if (i_attr + 1 != m.end()) assert(i_attr->first < (i_attr + 1)->first);
+			assert(i.has_attr_here(i_attr->first));
+			assert(m.find(i_attr->first) == i_attr);
+		}
+		assert(m.find(0x3fff) == m.end()); // DW_AT_hi_user
+		/* Copies and moves keep the values. */
+		encap::attribute_map copied = m;
+		assert(copied == m);
+		encap::attribute_map moved = std::move(copied);
+		assert(moved == m);
+		/* The rest of the std::map interface we used to have. */
+		std::map<Dwarf_Half, encap::attribute_value> as_std_map(m.begin(), m.end());
+		encap::attribute_map from_range(as_std_map.begin(), as_std_map.end());
+		assert(from_range == m);
+		for (auto i_attr = m.begin(); i_attr != m.end(); ++i_attr)
+		{
+			assert(from_range.at(i_attr->first) == i_attr->second);
+			assert(from_range[i_attr->first] == i_attr->second);
+		}
+		try { from_range.at(0x3fff); assert(false); } catch (std::out_of_range&) {}
+		assert(from_range.emplace(0x3fff, m.empty() ? encap::attribute_value(
+			(Dwarf_Unsigned) 0) : m.begin()->second).second);
+		assert(from_range.size() == m.size() + 1);
+		from_range.erase(from_range.begin(), from_range.end() - 1);
+		assert(from_range.size() == 1 && from_range.begin()->first == 0x3fff);
+
+		/* Merging keeps everything we had, and adds the origin's. */
+		encap::attribute_map all = i->find_all_attrs();
+		for (auto i_attr = m.begin(); i_attr != m.end(); ++i_attr)
+		{
+			auto found = all.find(i_attr->first);
+			assert(found != all.end());
+			assert(found->second == i_attr->second);
+		}
+		if (m.find(DW_AT_abstract_origin) != m.end())
+		{
+			encap::attribute_map origin_m
+			 = m.find(DW_AT_abstract_origin)->second.get_refiter().copy_attrs();
+			for (auto i_attr = origin_m.begin(); i_attr != origin_m.end(); ++i_attr)
+			{
+				assert(all.find(i_attr->first) != all.end());
+			}
+			++nmerged;
+		}
+		for (auto i_attr = all.begin(); i_attr != all.end(); ++i_attr)
+		{
+			if (i_attr + 1 != all.end()) assert(i_attr->first < (i_attr + 1)->first);
+		}
+	}
+	assert(ndies > 0);
+	cout << "Attribute maps checked on " << ndies << " DIEs (" << nmerged
+		<< " with an abstract origin)." << endl;
+	return 0;
+}
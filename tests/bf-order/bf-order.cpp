@@ -0,0 +1,58 @@
+#undef NDEBUG // assert is part of our logic
+#include <fstream>
+#include <fileno.hpp>
+#include <dwarfpp/lib.hpp>
+#include <algorithm>
+
+using std::cout;
+using std::endl;
+using namespace dwarf;
+using namespace dwarf::lib;
+using core::iterator_df;
+using core::iterator_bf;
+
+static std::vector<std::pair<unsigned, Dwarf_Off> > bf_order(core::root_die& root)
+{
+	std::vector<std::pair<unsigned, Dwarf_Off> > seen;
+	for (iterator_bf<> i = root.begin(); i != root.end(); ++i)
+	{
+		seen.push_back(std::make_pair(i.depth(), i.offset_here()));
+	}
+	return seen;
+}
+
+int main(int argc, char **argv)
+{
+	cout << "Opening " << argv[0] << "..." << endl;
+	std::ifstream in(argv[0]);
+	assert(in);
+	core::root_die root(fileno(in));
+
+	/* Breadth-first order is depth-first order, stably sorted by depth. */
+	std::vector<std::pair<unsigned, Dwarf_Off> > expected;
+	for (iterator_df<> i = root.begin(); i != root.end(); ++i)
+	{
+		expected.push_back(std::make_pair(i.depth(), i.offset_here()));
+	}
+	std::stable_sort(expected.begin(), expected.end(),
+		[](const std::pair<unsigned, Dwarf_Off>& p1, const std::pair<unsigned, Dwarf_Off>& p2) {
+			return p1.first < p2.first;
+		});
+	assert(bf_order(root) == expected);
+
+	/* Same again when navigation goes via the topology index. */
+	root.build_topology_index();
+	assert(bf_order(root) == expected);
+
+	/* Skipping subtrees from the first CU visits exactly the CUs. */
+	unsigned ncus = 0;
+	iterator_bf<> i = root.begin(); ++i;
+	for (; i != root.end(); i.increment_skipping_subtree())
+	{
+		assert(i.depth() == 1);
+		++ncus;
+	}
+	assert(ncus > 0);
+	cout << "Breadth-first order agreed on " << expected.size() << " DIEs." << endl;
+	return 0;
+}
@@ -0,0 +1,63 @@
+#undef NDEBUG // assert is part of our logic
+#include <fstream>
+#include <fileno.hpp>
+#include <dwarfpp/lib.hpp>
+
+using std::cout;
+using std::endl;
+using namespace dwarf;
+using namespace dwarf::lib;
+using core::iterator_df;
+using core::root_die;
+
+int main(int argc, char **argv)
+{
+	cout << "Opening " << argv[0] << "..." << endl;
+	std::ifstream in(argv[0]);
+	assert(in);
+	root_die root(fileno(in));
+
+	/* By default, CUs are sticky and nothing else stays around. */
+	unsigned ncus = 0, ndies = 0;
+	for (iterator_df<> i = root.begin(); i != root.end(); ++i)
+	{
+		if (i.is_root_position()) continue;
+		++ndies;
+		if (i.tag_here() == DW_TAG_compile_unit) ++ncus;
+		(void) i->get_name(); // make payload
+	}
+	auto f = root.get_cache_footprint();
+	assert(f.sticky_payloads == ncus);
+	assert(f.retained_payloads == 0);
+	assert(f.live_payloads == ncus);
+
+	/* Now keep payloads, within a budget, and nothing sticky. */
+	root_die::cache_policy p;
+	p.sticky_tags.clear();
+	p.max_bytes = 4096;
+	root.set_cache_policy(p);
+	unsigned ndies_again = 0;
+	for (iterator_df<> i = root.begin(); i != root.end(); ++i)
+	{
+		if (i.is_root_position()) continue;
+		++ndies_again;
+		(void) i->get_name();
+		auto f = root.get_cache_footprint();
+		assert(f.sticky_payloads <= ncus); // the old ones stay
+		assert(f.retained_payloads < ndies);
+	}
+	assert(ndies_again == ndies);
+	f = root.get_cache_footprint();
+	assert(f.retained_payloads > 0);
+	cout << "Kept " << f.retained_payloads << " payloads; footprint "
+		<< f.total_bytes() << " bytes in total" << endl;
+
+	/* Everything recomputable can go. */
+	root.evict_caches();
+	f = root.get_cache_footprint();
+	assert(f.retained_payloads == 0);
+	assert(f.live_payloads == f.sticky_payloads);
+	assert(root.find_visible_grandchild_named("main"));
+
+	return 0;
+}
@@ -0,0 +1,81 @@
+#undef NDEBUG // assert is part of our logic
+#include <fstream>
+#include <limits>
+#include <fileno.hpp>
+#include <dwarfpp/lib.hpp>
+
+using std::cout;
+using std::endl;
+using namespace dwarf;
+using namespace dwarf::lib;
+using core::iterator_df;
+using core::compile_unit_die;
+
+/* loc_for_vaddr() is the uncompiled lookup, but it knows nothing of base
+ * address selection entries or of 0..0 meaning everywhere. */
+static bool plain_ranges_only(const encap::loclist& l)
+{
+	for (auto i_l = l.begin(); i_l != l.end(); ++i_l)
+	{
+		if (i_l->lopc == 0xffffffffU || i_l->lopc == 0xffffffffffffffffULL) return false;
+		if (i_l->lopc == 0 && i_l->hipc == 0) return false;
+	}
+	return true;
+}
+
+int main(int argc, char **argv)
+{
+	cout << "Opening " << argv[0] << "..." << endl;
+	std::ifstream in(argv[0]);
+	assert(in);
+	core::root_die root(fileno(in));
+
+	unsigned nlists = 0, nlookups = 0;
+	for (iterator_df<> i = root.begin(); i != root.end(); ++i)
+	{
+		if (i.is_root_position()) continue;
+		Dwarf_Half attrs[] = { DW_AT_location, DW_AT_frame_base };
+		for (Dwarf_Half a : attrs)
+		{
+			auto compiled = root.compiled_loclist_for(i, a);
+			assert(compiled);
+			/* It's kept. */
+			assert(root.compiled_loclist_for(i, a) == compiled);
+			encap::attribute_value v = i->find_attr(a);
+			if (!v.is_loclist()) { assert(compiled->empty()); continue; }
+			const encap::loclist& l = v.get_loclist();
+			iterator_df<compile_unit_die> i_cu = root.cu_pos(i.enclosing_cu_offset_here());
+			Dwarf_Addr cu_base = i_cu->get_low_pc() ? i_cu->get_low_pc()->addr : 0;
+			/* Ranges are sorted and disjoint. */
+			for (auto i_r = compiled->ranges.begin(); i_r != compiled->ranges.end(); ++i_r)
+			{
+				assert(i_r->lo < i_r->hi);
+				if (i_r + 1 != compiled->ranges.end()) assert(i_r->hi <= (i_r + 1)->lo);
+			}
+			if (!plain_ranges_only(l)) continue;
+			++nlists;
+			/* Try each end of each entry, and either side. */
+			for (auto i_l = l.begin(); i_l != l.end(); ++i_l)
+			{
+				Dwarf_Addr vaddrs[] = { i_l->lopc, i_l->lopc - 1, i_l->hipc, i_l->hipc - 1 };
+				for (Dwarf_Addr vaddr : vaddrs)
+				{
+					/* loc_for_vaddr() is relative to the CU base, so stay
+					 * where that doesn't wrap. */
+					if (vaddr == std::numeric_limits<Dwarf_Addr>::max()
+						|| vaddr > std::numeric_limits<Dwarf_Addr>::max() - cu_base) continue;
+					opt<encap::loc_expr> slow;
+					try { slow = l.loc_for_vaddr(vaddr); }
+					catch (No_entry) {}
+					const encap::loc_expr *fast = compiled->expr_for_pc(cu_base + vaddr);
+					assert(!!slow == !!fast);
+					if (slow) assert(*slow == *fast);
+					++nlookups;
+				}
+			}
+		}
+	}
+	cout << "Compiled loclists agreed on " << nlookups << " lookups in "
+		<< nlists << " lists." << endl;
+	return 0;
+}
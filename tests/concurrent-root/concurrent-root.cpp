@@ -0,0 +1,68 @@
+#undef NDEBUG // assert is part of our logic
+#include <fstream>
+#include <fileno.hpp>
+#include <dwarfpp/lib.hpp>
+#include <thread>
+#include <atomic>
+
+using std::cout;
+using std::endl;
+using namespace dwarf;
+using namespace dwarf::lib;
+using core::iterator_df;
+using core::base_type_die;
+
+int main(int argc, char **argv)
+{
+	cout << "Opening " << argv[0] << "..." << endl;
+	std::ifstream in(argv[0]);
+	assert(in);
+	core::root_die root(fileno(in));
+
+	/* Count DIEs and base types the ordinary way first. */
+	unsigned expected_dies = 0;
+	vector<Dwarf_Off> base_types;
+	for (iterator_df<> i = root.begin(); i != root.end(); ++i)
+	{
+		++expected_dies;
+		if (i.is_a<base_type_die>()) base_types.push_back(i.offset_here());
+	}
+	assert(base_types.size() > 0);
+	auto found_main = root.find_visible_grandchild_named("main");
+	assert(found_main);
+
+	/* Now let several threads share the root. Each walks the whole tree,
+	 * materialising payloads as it goes, looks up a name, and compares
+	 * base types (which fills the equality cache). */
+	root.set_concurrent();
+	assert(root.is_concurrent());
+	const unsigned nthreads = 4;
+	std::atomic<unsigned> failures(0);
+	vector<std::thread> threads;
+	for (unsigned t = 0; t < nthreads; ++t)
+	{
+		threads.emplace_back([&root, &failures, &base_types, &found_main, expected_dies, t]() {
+			unsigned count = 0;
+			for (iterator_df<> i = root.begin(); i != root.end(); ++i)
+			{
+				++count;
+				if (i.is_a<base_type_die>() && i.name_here()) (void) i->get_name();
+				if (i.depth() > 0 && i.parent().depth() + 1 != i.depth()) ++failures;
+			}
+			if (count != expected_dies) ++failures;
+			if (root.find_visible_grandchild_named("main") != found_main) ++failures;
+			for (unsigned n = t; n < base_types.size(); n += nthreads)
+			{
+				auto b1 = root.find(base_types[n]).as_a<base_type_die>();
+				auto b2 = root.find(base_types[(n + 1) % base_types.size()]).as_a<base_type_die>();
+				if (!(*b1 == *b1)) ++failures;
+				if ((*b1 == *b2) != (*b2 == *b1)) ++failures;
+			}
+		});
+	}
+	for (auto i_t = threads.begin(); i_t != threads.end(); ++i_t) i_t->join();
+	assert(failures == 0);
+	cout << nthreads << " threads each saw " << expected_dies << " DIEs." << endl;
+
+	return 0;
+}
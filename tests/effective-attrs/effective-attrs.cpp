@@ -0,0 +1,71 @@
+#undef NDEBUG // assert is part of our logic
+#include <fstream>
+#include <fileno.hpp>
+#include <dwarfpp/lib.hpp>
+
+using std::cout;
+using std::endl;
+using namespace dwarf;
+using namespace dwarf::lib;
+using core::iterator_df;
+using core::iterator_base;
+using core::root_die;
+
+int main(int argc, char **argv)
+{
+	cout << "Opening " << argv[0] << "..." << endl;
+	std::ifstream in(argv[0]);
+	assert(in);
+	root_die root(fileno(in));
+
+	/* Remember what we get the slow way. */
+	std::map<Dwarf_Off, encap::attribute_map> slow;
+	for (iterator_df<> i = root.begin(); i != root.end(); ++i)
+	{
+		if (i.is_root_position()) continue;
+		if (!i.has_attr_here(DW_AT_abstract_origin) && !i.has_attr_here(DW_AT_specification)
+			&& !i.has_attr_here(DW_AT_declaration)) continue;
+		slow.insert(make_pair(i.offset_here(), i->find_all_attrs()));
+	}
+
+	root_die::cache_policy p = root.get_cache_policy();
+	p.memoize_effective_attrs = true;
+	root.set_cache_policy(p);
+	root.build_effective_attrs_cache();
+	assert(root.get_cache_footprint().cache_entries >= slow.size());
+	/* Memoized answers, from either call, match. */
+	for (auto i_s = slow.begin(); i_s != slow.end(); ++i_s)
+	{
+		iterator_df<> i = root.pos(i_s->first);
+		assert(i->find_all_attrs() == i_s->second);
+		Dwarf_Half some_attrs[] = { DW_AT_name, DW_AT_type, DW_AT_decl_file, DW_AT_low_pc };
+		for (Dwarf_Half a : some_attrs)
+		{
+			auto found = i_s->second.find(a);
+			encap::attribute_value v = i->find_attr(a);
+			if (found == i_s->second.end()) assert(v.get_form() == encap::attribute_value::NO_ATTR);
+			else assert(v == found->second);
+		}
+	}
+
+	/* Editing an in-memory origin is seen by what refers to it. */
+	auto cu = root.get_or_create_synthetic_cu();
+	iterator_base origin = root.make_new(cu, DW_TAG_variable);
+	iterator_base concrete = root.make_new(cu, DW_TAG_variable);
+	auto& origin_attrs = dynamic_cast<core::in_memory_abstract_die&>(origin.dereference()).attrs();
+	auto& concrete_attrs = dynamic_cast<core::in_memory_abstract_die&>(concrete.dereference()).attrs();
+	origin_attrs.insert(make_pair(DW_AT_name, encap::attribute_value(std::string("before"))));
+	concrete_attrs.insert(make_pair(
+		DW_AT_abstract_origin, encap::attribute_value(encap::attribute_value::weak_ref(
+			root, origin.offset_here(), true, concrete.offset_here(), DW_AT_abstract_origin))));
+	assert(concrete->find_attr(DW_AT_name).get_string() == "before");
+	/* Edits through a reference we kept count too. */
+	origin_attrs.erase(DW_AT_name);
+	assert(concrete->find_attr(DW_AT_name).get_form() == encap::attribute_value::NO_ATTR);
+	origin_attrs.insert(make_pair(DW_AT_name, encap::attribute_value(std::string("after"))));
+	assert(concrete->find_attr(DW_AT_name).get_string() == "after");
+	assert(concrete->find_all_attrs().find(DW_AT_name)->second.get_string() == "after");
+
+	cout << "Effective attributes agreed on " << slow.size() << " DIEs." << endl;
+	return 0;
+}
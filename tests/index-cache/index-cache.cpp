@@ -0,0 +1,58 @@
+#undef NDEBUG // assert is part of our logic
+#include <fstream>
+#include <cstdio>
+#include <fileno.hpp>
+#include <dwarfpp/lib.hpp>
+#include <dwarfpp/topology.hpp>
+
+using std::cout;
+using std::endl;
+using namespace dwarf;
+using namespace dwarf::lib;
+using core::iterator_df;
+using core::topology_index;
+
+int main(int argc, char **argv)
+{
+	cout << "Opening " << argv[0] << "..." << endl;
+	std::ifstream in(argv[0]);
+	assert(in);
+	string cache_path = string(argv[0]) + ".idx";
+	std::remove(cache_path.c_str());
+	
+	vector<Dwarf_Off> seen;
+	{
+		core::root_die root(fileno(in));
+		if (!root.get_native_image())
+		{
+			cout << "No native decoder, so no index cache; skipping." << endl;
+			return 0;
+		}
+		assert(!root.load_index_cache(cache_path)); // nothing there yet
+		assert(root.save_index_cache(cache_path));
+		for (iterator_df<> i = root.begin(); i != root.end(); ++i) seen.push_back(i.offset_here());
+	}
+	
+	/* A fresh root_die should start warm, and see the same tree. */
+	core::root_die root(fileno(in));
+	assert(root.load_index_cache(cache_path));
+	const topology_index *p_idx = root.get_topology_index();
+	assert(p_idx);
+	assert(p_idx->size() + 1 == seen.size()); // the index doesn't include the root
+	assert(p_idx->footprint() == 0); // arrays are in the mapping
+	unsigned count = 0;
+	for (iterator_df<> i = root.begin(); i != root.end(); ++i, ++count)
+	{
+		assert(i.offset_here() == seen[count]);
+	}
+	assert(count == seen.size());
+	
+	/* The names came from the cache, and "main" is one of them. */
+	auto found = root.find_visible_grandchild_named("main");
+	assert(found);
+	assert(found.name_here() && *found.name_here() == "main");
+	
+	std::remove(cache_path.c_str());
+	cout << "Index cache round-tripped " << count << " DIEs." << endl;
+	return 0;
+}
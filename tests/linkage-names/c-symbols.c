@@ -0,0 +1,20 @@
+/* C definitions, whose symbols are just their names, whether global or
+ * local. */
+int c_global_counter = 1;
+static int c_static_counter = 2;
+
+int c_bump(int by)
+{
+	c_global_counter += by;
+	return c_global_counter;
+}
+
+static int c_static_helper(void)
+{
+	return ++c_static_counter;
+}
+
+int c_call_helper(void)
+{
+	return c_static_helper();
+}
@@ -0,0 +1,5 @@
+# ... because ours also links a C object, to test plain C symbols
+linkage-names: c-symbols.o
+linkage-names: LDLIBS += c-symbols.o
+# -std=c99 so that the CU's DW_AT_language is one we know is C
+c-symbols.o: CFLAGS += -g -O0 -std=c99
@@ -0,0 +1,90 @@
+#undef NDEBUG // assert is part of our logic
+#include <fstream>
+#include <algorithm>
+#include <fileno.hpp>
+#include <dwarfpp/lib.hpp>
+
+using std::cout;
+using std::endl;
+using std::vector;
+using namespace dwarf;
+using namespace dwarf::lib;
+using core::iterator_base;
+using core::iterator_df;
+using core::root_die;
+using core::subprogram_die;
+using core::variable_die;
+using core::with_static_location_die;
+
+int global_counter = 42;
+namespace ns { int namespaced_counter = 69; int bump() { return ++namespaced_counter; } }
+/* in c-symbols.c */
+extern "C" { int c_bump(int by); int c_call_helper(void); }
+
+int main(int argc, char **argv)
+{
+	cout << "Opening " << argv[0] << "..." << endl;
+	std::ifstream in(argv[0]);
+	assert(in);
+	root_die root(fileno(in));
+
+	/* Every definition with a symbol, the slow way. */
+	unsigned nsymbols = 0;
+	for (iterator_df<> i = root.begin(); i != root.end(); ++i)
+	{
+		bool is_definition;
+		if (i.is_a<subprogram_die>())
+		{
+			is_definition = !!i.as_a<subprogram_die>()->get_low_pc();
+		}
+		else if (i.is_a<variable_die>())
+		{
+			encap::attribute_value loc = i->find_attr(DW_AT_location);
+			is_definition = !i.has_attr_here(DW_AT_declaration) && loc.is_loclist()
+				&& !loc.get_loclist().empty() && !loc.get_loclist().begin()->empty()
+				&& loc.get_loclist().begin()->begin()->lr_atom == DW_OP_addr;
+		}
+		else continue;
+		if (!is_definition) continue;
+		opt<std::string> symbol = i.as_a<with_static_location_die>()->get_linkage_name();
+		if (!symbol) continue;
+		vector<iterator_base> found = root.find_by_linkage_name(*symbol);
+		assert(std::find_if(found.begin(), found.end(), [&i](const iterator_base& f) {
+			return f.offset_here() == i.offset_here();
+		}) != found.end());
+		++nsymbols;
+	}
+	assert(nsymbols > 0);
+	assert(root.get_linkage_name_index());
+	assert(root.get_cache_footprint().index_bytes >= root.get_linkage_name_index()->footprint());
+
+	/* Some symbols we know are defined here. */
+	vector<iterator_base> found = root.find_by_linkage_name("_ZN2ns17namespaced_counterE");
+	assert(found.size() == 1 && found.front().is_a<variable_die>());
+	found = root.find_by_linkage_name("_ZN2ns4bumpEv");
+	assert(found.size() == 1 && found.front().is_a<subprogram_die>());
+	/* The source name of a mangled symbol isn't a symbol. */
+	assert(root.find_by_linkage_name("namespaced_counter").empty());
+	/* Unmangled C++ names have no DW_AT_linkage_name, but are symbols. */
+	found = root.find_by_linkage_name("global_counter");
+	assert(found.size() == 1 && found.front().is_a<variable_die>());
+	found = root.find_by_linkage_name("main");
+	assert(found.size() == 1 && found.front().is_a<subprogram_die>());
+	assert(root.find_by_linkage_name("no such symbol, surely").empty());
+	/* In C, every name is its symbol, local or not. */
+	const char *c_variables[] = { "c_global_counter", "c_static_counter" };
+	for (const char *name : c_variables)
+	{
+		found = root.find_by_linkage_name(name);
+		assert(found.size() == 1 && found.front().is_a<variable_die>());
+	}
+	const char *c_subprograms[] = { "c_bump", "c_static_helper", "c_call_helper" };
+	for (const char *name : c_subprograms)
+	{
+		found = root.find_by_linkage_name(name);
+		assert(found.size() == 1 && found.front().is_a<subprogram_die>());
+	}
+
+	cout << "Linkage name index agreed on " << nsymbols << " symbols." << endl;
+	return (ns::bump() > 0 && c_bump(1) > 0 && c_call_helper() > 0) ? 0 : 1;
+}
@@ -0,0 +1,73 @@
+#undef NDEBUG // assert is part of our logic
+#include <fstream>
+#include <algorithm>
+#include <fileno.hpp>
+#include <dwarfpp/lib.hpp>
+
+using std::cout;
+using std::endl;
+using std::vector;
+using namespace dwarf;
+using namespace dwarf::lib;
+using core::iterator_base;
+using core::root_die;
+using core::accelerator_tables;
+
+/* Only declared, so the producer's tables leave it out. */
+struct accel_incomplete;
+struct accel_incomplete *accel_incomplete_ptr;
+
+int main(int argc, char **argv)
+{
+	cout << "Opening " << argv[0] << "..." << endl;
+	std::ifstream in(argv[0]);
+	assert(in);
+	root_die slow(fileno(in));
+	std::ifstream in2(argv[0]);
+	assert(in2);
+	root_die fast(fileno(in2));
+
+	const accelerator_tables *p_acc = fast.name_accelerators();
+	if (!p_acc || p_acc->get_kind() == accelerator_tables::NONE)
+	{
+		cout << "No name tables to check." << endl;
+		return 0;
+	}
+	/* We're built with -gpubnames, which lists main. */
+	vector<Dwarf_Off> found_main;
+	p_acc->find("main", found_main);
+	assert(found_main.size() > 0);
+
+	/* Every visible name, the slow way. */
+	std::map<std::string, vector<Dwarf_Off> > expected;
+	auto vg_seq = slow.visible_named_grandchildren();
+	for (auto i_g = std::move(vg_seq.first); i_g != vg_seq.second; ++i_g)
+	{
+		expected[*i_g.name_here()].push_back(i_g.offset_here());
+	}
+	unsigned nhits = 0;
+	for (auto i_e = expected.begin(); i_e != expected.end(); ++i_e)
+	{
+		/* What the tables find is right, if maybe not all there is. */
+		vector<Dwarf_Off> got;
+		p_acc->find(i_e->first, got);
+		assert(std::is_sorted(got.begin(), got.end()));
+		for (auto i_off = got.begin(); i_off != got.end(); ++i_off)
+		{
+			assert(std::find(i_e->second.begin(), i_e->second.end(), *i_off) != i_e->second.end());
+		}
+		if (!got.empty()) ++nhits;
+		/* Lookups still find everything, whether or not it's listed. */
+		iterator_base i = fast.find_visible_grandchild_named(i_e->first);
+		assert(i);
+		assert(std::find(i_e->second.begin(), i_e->second.end(), i.offset_here()) != i_e->second.end());
+		assert(fast.find_all_visible_grandchildren_named(i_e->first).size() == i_e->second.size());
+	}
+	assert(nhits > 0);
+	/* Declarations are found by walking, even where the tables list the CU. */
+	assert(expected.find("accel_incomplete") != expected.end());
+	assert(fast.find_visible_grandchild_named("accel_incomplete"));
+
+	cout << "Name tables found " << nhits << " of " << expected.size() << " names." << endl;
+	return accel_incomplete_ptr ? 1 : 0;
+}
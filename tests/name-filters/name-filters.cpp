@@ -0,0 +1,113 @@
+#undef NDEBUG // assert is part of our logic
+#include <fstream>
+#include <algorithm>
+#include <cstdio>
+#include <fileno.hpp>
+#include <dwarfpp/lib.hpp>
+
+using std::cout;
+using std::endl;
+using std::vector;
+using namespace dwarf;
+using namespace dwarf::lib;
+using core::iterator_base;
+using core::root_die;
+using core::cu_name_filters;
+
+static vector<Dwarf_Off> offsets_of(const vector<iterator_base>& found)
+{
+	vector<Dwarf_Off> offs;
+	for (auto i = found.begin(); i != found.end(); ++i) offs.push_back(i->offset_here());
+	std::sort(offs.begin(), offs.end());
+	return offs;
+}
+
+namespace nf { int filtered_counter = 1; }
+
+int main(int argc, char **argv)
+{
+	cout << "Opening " << argv[0] << "..." << endl;
+	std::ifstream in(argv[0]);
+	assert(in);
+	root_die slow(fileno(in));
+	std::ifstream in2(argv[0]);
+	assert(in2);
+	root_die fast(fileno(in2));
+	fast.build_name_filters(0);
+	const cu_name_filters *filters = fast.get_name_filters();
+	assert(filters);
+	assert(filters->cu_count() > 0);
+	assert(fast.get_cache_footprint().index_bytes >= filters->footprint());
+
+	/* No false negatives: each visible grandchild's CU is a candidate. */
+	std::set<std::string> names;
+	auto vg_seq = slow.visible_named_grandchildren();
+	for (auto i_g = std::move(vg_seq.first); i_g != vg_seq.second; ++i_g)
+	{
+		std::string name = *i_g.name_here();
+		names.insert(name);
+		vector<Dwarf_Off> cus;
+		filters->candidate_cus(name, cus);
+		assert(std::is_sorted(cus.begin(), cus.end()));
+		assert(std::find(cus.begin(), cus.end(), i_g.enclosing_cu_offset_here()) != cus.end());
+		assert(filters->may_contain(i_g.enclosing_cu_offset_here(), name));
+	}
+	assert(names.size() > 0);
+
+	/* Pruned searches find the same things as walks. */
+	for (auto i_n = names.begin(); i_n != names.end(); ++i_n)
+	{
+		assert(offsets_of(fast.find_all_visible_grandchildren_named(*i_n))
+			== offsets_of(slow.find_all_visible_grandchildren_named(*i_n)));
+	}
+	assert(!fast.find_visible_grandchild_named("no such name, surely"));
+	/* And most misses rule out most CUs. */
+	unsigned ncandidates = 0;
+	const unsigned nmisses = 100;
+	for (unsigned i = 0; i < nmisses; ++i)
+	{
+		vector<Dwarf_Off> cus;
+		filters->candidate_cus("no such name " + std::to_string(i), cus);
+		ncandidates += cus.size();
+	}
+	assert(ncandidates < nmisses * filters->cu_count() / 4 + nmisses);
+
+	/* Symbols are found without building the linkage name index. */
+	auto found = fast.find_by_linkage_name("_ZN2nf16filtered_counterE");
+	assert(found.size() == 1 && *found.front().name_here() == "filtered_counter");
+	assert(!fast.get_linkage_name_index());
+	assert(fast.find_by_linkage_name("no such symbol, surely").empty());
+
+	/* The filters go in the index cache. */
+	if (fast.get_native_image())
+	{
+		string cache_path = string(argv[0]) + ".idx";
+		std::remove(cache_path.c_str());
+		assert(fast.save_index_cache(cache_path));
+		std::ifstream in3(argv[0]);
+		root_die warm(fileno(in3));
+		assert(warm.load_index_cache(cache_path));
+		assert(warm.get_name_filters());
+		assert(warm.get_name_filters()->cu_count() == filters->cu_count());
+		assert(warm.get_name_filters()->footprint() == 0); // arrays are in the mapping
+		assert(warm.find_visible_grandchild_named("main"));
+		std::remove(cache_path.c_str());
+	}
+
+	/* The filters don't know about in-memory edits, so the edited CU is
+	 * searched as well; the others are still pruned. */
+	auto cu = fast.get_or_create_synthetic_cu();
+	iterator_base v = fast.make_new(cu, DW_TAG_variable);
+	dynamic_cast<core::in_memory_abstract_die&>(v.dereference()).attrs().insert(
+		make_pair(DW_AT_name, encap::attribute_value(std::string("made_in_memory"))));
+	assert(fast.find_all_visible_grandchildren_named("made_in_memory").size() == 1);
+	for (auto i_n = names.begin(); i_n != names.end(); ++i_n)
+	{
+		assert(offsets_of(fast.find_all_visible_grandchildren_named(*i_n))
+			== offsets_of(slow.find_all_visible_grandchildren_named(*i_n)));
+	}
+
+	cout << "Name filters agreed on " << names.size() << " names in "
+		<< filters->cu_count() << " CUs." << endl;
+	return nf::filtered_counter == 1 ? 0 : 1;
+}
@@ -0,0 +1,73 @@
+#undef NDEBUG // assert is part of our logic
+#include <fstream>
+#include <algorithm>
+#include <fileno.hpp>
+#include <dwarfpp/lib.hpp>
+
+using std::cout;
+using std::endl;
+using std::vector;
+using namespace dwarf;
+using namespace dwarf::lib;
+using core::iterator_base;
+using core::root_die;
+
+static vector<Dwarf_Off> offsets_of(const vector<iterator_base>& found)
+{
+	vector<Dwarf_Off> offs;
+	for (auto i = found.begin(); i != found.end(); ++i) offs.push_back(i->offset_here());
+	return offs;
+}
+
+int main(int argc, char **argv)
+{
+	cout << "Opening " << argv[0] << "..." << endl;
+	std::ifstream in(argv[0]);
+	assert(in);
+	root_die slow(fileno(in));
+	std::ifstream in2(argv[0]);
+	assert(in2);
+	root_die fast(fileno(in2));
+	fast.build_name_index(0);
+	assert(fast.get_name_index());
+	assert(fast.get_cache_footprint().index_bytes >= fast.get_name_index()->footprint());
+
+	/* Every visible name, the slow way. */
+	std::set<std::string> names;
+	auto vg_seq = slow.visible_named_grandchildren();
+	for (auto i_g = std::move(vg_seq.first); i_g != vg_seq.second; ++i_g)
+	{
+		names.insert(*i_g.name_here());
+	}
+	assert(names.size() > 0);
+	assert(fast.get_name_index()->size() >= names.size());
+
+	for (auto i_n = names.begin(); i_n != names.end(); ++i_n)
+	{
+		vector<Dwarf_Off> expected = offsets_of(slow.find_all_visible_grandchildren_named(*i_n));
+		vector<Dwarf_Off> got = offsets_of(fast.find_all_visible_grandchildren_named(*i_n));
+		/* The index gives them in file order. */
+		assert(std::is_sorted(got.begin(), got.end()));
+		std::sort(expected.begin(), expected.end());
+		assert(got == expected);
+		assert(fast.find_visible_grandchild_named(*i_n).offset_here() == got.front());
+	}
+	assert(!fast.find_visible_grandchild_named("no such name, surely"));
+
+	/* In-memory DIEs are still found. */
+	auto cu = fast.get_or_create_synthetic_cu();
+	iterator_base v = fast.make_new(cu, DW_TAG_variable);
+	dynamic_cast<core::in_memory_abstract_die&>(v.dereference()).attrs().insert(
+		make_pair(DW_AT_name, encap::attribute_value(std::string("made_in_memory"))));
+	auto found = fast.find_all_visible_grandchildren_named("made_in_memory");
+	assert(found.size() == 1 && found.front().offset_here() == v.offset_here());
+	std::string some_name = *names.begin();
+	iterator_base w = fast.make_new(cu, DW_TAG_variable);
+	dynamic_cast<core::in_memory_abstract_die&>(w.dereference()).attrs().insert(
+		make_pair(DW_AT_name, encap::attribute_value(some_name)));
+	assert(fast.find_all_visible_grandchildren_named(some_name).size()
+		== slow.find_all_visible_grandchildren_named(some_name).size() + 1);
+
+	cout << "Name index agreed on " << names.size() << " names." << endl;
+	return 0;
+}
@@ -0,0 +1,56 @@
+#undef NDEBUG // assert is part of our logic
+#include <fstream>
+#include <fileno.hpp>
+#include <dwarfpp/lib.hpp>
+
+using std::cout; 
+using std::endl;
+using namespace dwarf;
+using namespace dwarf::lib;
+using core::iterator_df;
+using core::string_view;
+using core::block_view;
+
+int main(int argc, char **argv)
+{
+	cout << "Opening " << argv[0] << "..." << endl;
+	std::ifstream in(argv[0]);
+	assert(in);
+	core::root_die root(fileno(in));
+
+	unsigned nnames = 0, nblocks = 0;
+	const char *first_name_data = nullptr;
+	Dwarf_Off first_named = 0;
+	for (iterator_df<> i = root.begin(); i != root.end(); ++i)
+	{
+		if (i.is_root_position()) continue;
+		/* Views agree with the copying calls. */
+		string_view name = i.name_view_here();
+		assert(!!name.data() == !!i.name_here());
+		if (name.data())
+		{
+			assert(name == *i.name_here());
+			assert(i->get_name_view() == name);
+			if (!first_name_data) { first_name_data = name.data(); first_named = i.offset_here(); }
+			++nnames;
+		}
+		encap::attribute_map m = i.copy_attrs();
+		for (auto i_attr = m.begin(); i_attr != m.end(); ++i_attr)
+		{
+			if (!i_attr->second.is_block()) continue;
+			block_view b = i.block_view_here(i_attr->first);
+			assert(b.data());
+			const std::vector<unsigned char>& copied = *i_attr->second.get_block();
+			assert(b.size() == copied.size());
+			assert(std::equal(b.begin(), b.end(), copied.begin()));
+			++nblocks;
+		}
+	}
+	assert(nnames > 0);
+	/* Views of the same DIE's name point at the same bytes, however we
+	 * got to it: they're tied to the root, not to iterators or payloads. */
+	assert(root.find(first_named).name_view_here().data() == first_name_data);
+	cout << "Name views agreed on " << nnames << " names and " << nblocks
+		<< " blocks." << endl;
+	return 0;
+}
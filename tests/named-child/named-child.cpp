@@ -0,0 +1,62 @@
+#undef NDEBUG // assert is part of our logic
+#include <fstream>
+#include <fileno.hpp>
+#include <dwarfpp/lib.hpp>
+
+using std::cout;
+using std::endl;
+using namespace dwarf;
+using namespace dwarf::lib;
+using core::iterator_df;
+using core::iterator_base;
+using core::with_named_children_die;
+
+int main(int argc, char **argv)
+{
+	cout << "Opening " << argv[0] << "..." << endl;
+	std::ifstream in(argv[0]);
+	assert(in);
+	core::root_die root(fileno(in));
+
+	unsigned nparents = 0, nlookups = 0;
+	for (iterator_df<> i = root.begin(); i != root.end(); ++i)
+	{
+		if (i.is_root_position() || !i.is_a<with_named_children_die>()) continue;
+		/* The first child with each name, the slow way. */
+		std::map<std::string, Dwarf_Off> first_named;
+		auto children = i.children_here();
+		for (auto i_child = std::move(children.first); i_child != children.second; ++i_child)
+		{
+			if (i_child.name_here()) first_named.insert(make_pair(*i_child.name_here(), i_child.offset_here()));
+		}
+		if (first_named.empty()) continue;
+		++nparents;
+		/* Twice, so that we hit the table once it's built. */
+		for (unsigned pass = 0; pass < 2; ++pass)
+		{
+			for (auto i_n = first_named.begin(); i_n != first_named.end(); ++i_n)
+			{
+				iterator_base found = i.named_child(i_n->first);
+				assert(found);
+				assert(found.offset_here() == i_n->second);
+				assert(found.depth() == i.depth() + 1);
+				++nlookups;
+			}
+			assert(!i.named_child("no such name, surely"));
+		}
+	}
+	assert(nparents > 0);
+	assert(root.get_cache_footprint().cache_entries > 0);
+
+	/* Children made in memory are found too. */
+	auto cu = root.get_or_create_synthetic_cu();
+	iterator_base v = root.make_new(cu, DW_TAG_variable);
+	assert(!cu.named_child("made_in_memory"));
+	dynamic_cast<core::in_memory_abstract_die&>(v.dereference()).attrs().insert(
+		make_pair(DW_AT_name, encap::attribute_value(std::string("made_in_memory"))));
+	assert(cu.named_child("made_in_memory").offset_here() == v.offset_here());
+
+	cout << "Named children agreed on " << nlookups << " lookups under "
+		<< nparents << " parents." << endl;
+	return 0;
+}
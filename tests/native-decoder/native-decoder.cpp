@@ -0,0 +1,65 @@
+#undef NDEBUG // assert is part of our logic
+#include <fstream>
+#include <fileno.hpp>
+#include <dwarfpp/lib.hpp>
+#include <dwarfpp/native.hpp>
+#include <tuple>
+
+using std::cout; 
+using std::endl;
+using namespace dwarf;
+using namespace dwarf::lib;
+using core::iterator_df;
+
+/* Walk the native decoder's view of the tree depth-first, in the same
+ * order as iterator_df, recording (offset, tag, depth). */
+static void walk(const core::native::image& img, Dwarf_Off off, unsigned depth,
+	vector<std::tuple<Dwarf_Off, Dwarf_Half, unsigned> >& out)
+{
+	for (; off != 0UL; off = img.next_sibling(off))
+	{
+		out.push_back(std::make_tuple(off, img.tag(off), depth));
+		walk(img, img.first_child(off), depth + 1, out);
+	}
+}
+
+int main(int argc, char **argv)
+{
+	cout << "Opening " << argv[0] << "..." << endl;
+	std::ifstream in(argv[0]);
+	assert(in);
+	core::root_die root(fileno(in));
+	
+	/* Whether or not the library was built to use it, we can
+	 * make a native image and check it agrees with the iterators. */
+	core::native::image img(fileno(in));
+	vector<std::tuple<Dwarf_Off, Dwarf_Half, unsigned> > native_seen;
+	for (auto i_u = img.get_units().begin(); i_u != img.get_units().end(); ++i_u)
+	{
+		walk(img, i_u->first_die, 1, native_seen);
+	}
+	
+	unsigned count = 0;
+	for (iterator_df<> i = root.begin(); i != root.end(); ++i)
+	{
+		if (i.is_root_position()) continue;
+		assert(count < native_seen.size());
+		assert(std::get<0>(native_seen[count]) == i.offset_here());
+		assert(std::get<1>(native_seen[count]) == i.tag_here());
+		assert(std::get<2>(native_seen[count]) == i.depth());
+		
+		const char *native_name = img.name(i.offset_here());
+		assert(!!native_name == !!i.name_here());
+		if (native_name) assert(string(native_name) == *i.name_here());
+		
+		core::native::location loc;
+		assert(img.locate(i.offset_here(), loc));
+		assert(loc.depth == i.depth());
+		assert(loc.parent == i.parent().offset_here());
+		++count;
+	}
+	assert(count == native_seen.size());
+	cout << "Native decoder agreed on " << count << " DIEs." << endl;
+	
+	return 0;
+}
@@ -0,0 +1,71 @@
+#undef NDEBUG // assert is part of our logic
+#include <fstream>
+#include <fileno.hpp>
+#include <dwarfpp/lib.hpp>
+
+using std::cout;
+using std::endl;
+using namespace dwarf;
+using namespace dwarf::core;
+
+/* This test is built with -fno-rtti, so everything below must get by
+ * on tags and the generated payload class tables. */
+int main(int argc, char **argv)
+{
+	cout << "Opening " << argv[0] << "..." << endl;
+	std::ifstream in(argv[0]);
+	assert(in);
+	root_die root(fileno(in));
+
+	unsigned nsubprograms = 0, ntypes = 0, nother = 0;
+	for (iterator_df<> i = root.begin(); i != root.end(); ++i)
+	{
+		if (i.is_root_position()) continue;
+		Dwarf_Half tag = i.tag_here();
+		// is_a agrees with the tag
+		assert(i.is_a<subprogram_die>() == (tag == DW_TAG_subprogram));
+		assert(i.is_a<compile_unit_die>() == (tag == DW_TAG_compile_unit));
+		if (tag == DW_TAG_base_type || tag == DW_TAG_pointer_type
+			|| tag == DW_TAG_structure_type || tag == DW_TAG_typedef)
+		{
+			assert(i.is_a<type_die>());
+		}
+		if (tag == DW_TAG_variable || tag == DW_TAG_subprogram) assert(!i.is_a<type_die>());
+
+		// downcasting iterators get the same payload
+		if (i.is_a<type_die>())
+		{
+			iterator_df<type_die> t = i;
+			assert(&*t == &i.dereference());
+		}
+
+		// visiting picks the most specific handler
+		int which = visit(i, overload(
+			[](subprogram_die& d) { return 1; },
+			[](type_die& d) { return 2; },
+			[](basic_die& d) { return 3; }
+		));
+		assert(which == (i.is_a<subprogram_die>() ? 1 : i.is_a<type_die>() ? 2 : 3));
+		switch (which)
+		{
+			case 1: ++nsubprograms; break;
+			case 2: ++ntypes; break;
+			default: ++nother; break;
+		}
+	}
+	assert(nsubprograms > 0);
+	assert(ntypes > 0);
+
+	// subsequences filter by tag, not by dynamic_cast
+	auto cu = root.begin().children().first;
+	auto subps = cu.children().subseq_of<subprogram_die>();
+	unsigned n = 0;
+	for (auto i = subps.first; i != subps.second; ++i, ++n)
+	{
+		assert(i.tag_here() == DW_TAG_subprogram);
+		assert(i->get_offset() == i.offset_here());
+	}
+	cout << "Visited " << nsubprograms << " subprograms, " << ntypes << " types and "
+		<< nother << " others; first CU has " << n << " subprograms." << endl;
+	return 0;
+}
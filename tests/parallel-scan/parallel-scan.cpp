@@ -0,0 +1,61 @@
+#undef NDEBUG // assert is part of our logic
+#include <fstream>
+#include <fileno.hpp>
+#include <dwarfpp/lib.hpp>
+
+using std::cout;
+using std::endl;
+using namespace dwarf;
+using namespace dwarf::lib;
+using core::iterator_df;
+using core::compile_unit_die;
+using core::subprogram_die;
+
+typedef std::vector<Dwarf_Off> offsets;
+static offsets concat(offsets o1, offsets o2)
+{
+	o1.insert(o1.end(), o2.begin(), o2.end());
+	return o1;
+}
+
+int main(int argc, char **argv)
+{
+	cout << "Opening " << argv[0] << "..." << endl;
+	std::ifstream in(argv[0]);
+	assert(in);
+	core::root_die root(fileno(in));
+
+	/* The sequential answers... */
+	offsets cus;
+	offsets subprograms;
+	for (iterator_df<> i = root.begin(); i != root.end(); ++i)
+	{
+		if (i.tag_here() == DW_TAG_compile_unit) cus.push_back(i.offset_here());
+		if (i.tag_here() == DW_TAG_subprogram && i.name_here()) subprograms.push_back(i.offset_here());
+	}
+
+	/* ... should be what the workers give us, in the same order. */
+	offsets par_cus = root.parallel_transform_reduce_cu(offsets(),
+		[](const iterator_df<compile_unit_die>& cu) { return offsets(1, cu.offset_here()); },
+		concat, 4);
+	assert(par_cus == cus);
+	offsets par_subprograms = root.parallel_transform_reduce<subprogram_die>(offsets(),
+		[](const iterator_df<subprogram_die>& i) { return (bool) i.name_here(); },
+		[](const iterator_df<subprogram_die>& i) { return offsets(1, i.offset_here()); },
+		concat, 4);
+	assert(par_subprograms == subprograms);
+
+	/* The unordered versions see everything exactly once. */
+	std::atomic<unsigned> ncus(0);
+	root.parallel_for_each_cu([&ncus](const iterator_df<compile_unit_die>& cu) { ++ncus; }, 4);
+	assert(ncus == cus.size());
+	std::atomic<unsigned> nsubprograms(0);
+	root.parallel_for_each<subprogram_die>(
+		[](const iterator_df<subprogram_die>& i) { return (bool) i.name_here(); },
+		[&nsubprograms](const iterator_df<subprogram_die>& i) { ++nsubprograms; }, 4);
+	assert(nsubprograms == subprograms.size());
+
+	cout << "Workers agreed on " << cus.size() << " CUs and "
+		<< subprograms.size() << " named subprograms." << endl;
+	return 0;
+}
@@ -0,0 +1,84 @@
+#undef NDEBUG // assert is part of our logic
+#include <fstream>
+#include <fileno.hpp>
+#include <dwarfpp/lib.hpp>
+#include <dwarfpp/native.hpp>
+
+using std::cout; 
+using std::endl;
+using namespace dwarf;
+using namespace dwarf::lib;
+using core::iterator_df;
+using core::native::raw_attr;
+
+int main(int argc, char **argv)
+{
+	cout << "Opening " << argv[0] << "..." << endl;
+	std::ifstream in(argv[0]);
+	assert(in);
+	core::root_die root(fileno(in));
+	core::native::image img(fileno(in));
+
+	/* Every attribute libdwarf gives us, we should find at the same
+	 * place by the abbrev's offsets, and decode to the same thing. */
+	unsigned nattrs = 0, nrefs = 0;
+	for (iterator_df<> i = root.begin(); i != root.end(); ++i)
+	{
+		if (i.is_root_position()) continue;
+		encap::attribute_map m = i.copy_attrs();
+		for (auto i_attr = m.begin(); i_attr != m.end(); ++i_attr)
+		{
+			raw_attr raw;
+			assert(img.fetch_attr(i.offset_here(), i_attr->first, raw));
+			assert(raw);
+			++nattrs;
+			if (i_attr->second.is_ref())
+			{
+				assert(img.ref_value(raw));
+				assert(*img.ref_value(raw) == i_attr->second.get_refoff());
+				++nrefs;
+			}
+			else if (i_attr->second.is_string())
+			{
+				assert(string(img.string_value(raw)) == i_attr->second.get_string());
+			}
+			else if (i_attr->second.is_flag())
+			{
+				assert(*img.flag_value(raw) == !!i_attr->second.get_flag());
+			}
+			else if (i_attr->second.is_address() && raw.form == DW_FORM_addr)
+			{
+				assert(*img.address_value(raw) == i_attr->second.get_address().addr);
+			}
+		}
+		raw_attr absent;
+		assert(img.fetch_attr(i.offset_here(), 0x3fff, absent)); // DW_AT_hi_user
+		assert(!absent);
+
+		/* The generated accessors agree with the slow way. */
+		if (i.is_a<core::program_element_die>())
+		{
+			auto p = i.as_a<core::program_element_die>();
+			if (i.has_attr(DW_AT_decl_line))
+			{
+				assert(p->get_decl_line());
+				assert(*p->get_decl_line() == i.attr(DW_AT_decl_line).get_unsigned());
+			}
+			else assert(!p->get_decl_line());
+		}
+		if (i.is_a<core::with_type_describing_layout_die>())
+		{
+			auto t = i.as_a<core::with_type_describing_layout_die>()->get_type();
+			if (i.has_attr(DW_AT_type))
+			{
+				assert(t);
+				assert(t.offset_here() == i.attr(DW_AT_type).get_refoff());
+			}
+			else assert(!t);
+		}
+	}
+	assert(nrefs > 0);
+	cout << "Raw fetches agreed on " << nattrs << " attributes (" << nrefs
+		<< " references)." << endl;
+	return 0;
+}
@@ -0,0 +1,93 @@
+#undef NDEBUG // assert is part of our logic
+#include <fstream>
+#include <fileno.hpp>
+#include <dwarfpp/lib.hpp>
+
+using std::cout;
+using std::endl;
+using std::vector;
+using std::string;
+using namespace dwarf;
+using namespace dwarf::lib;
+using core::iterator_df;
+using core::iterator_base;
+using core::root_die;
+using core::subprogram_die;
+
+int main(int argc, char **argv)
+{
+	cout << "Opening " << argv[0] << "..." << endl;
+	std::ifstream in(argv[0]);
+	assert(in);
+	root_die slow(fileno(in));
+	std::ifstream in2(argv[0]);
+	assert(in2);
+	root_die fast(fileno(in2));
+	root_die::cache_policy p = fast.get_cache_policy();
+	p.memoize_scoped_resolve = true;
+	fast.set_cache_policy(p);
+
+	/* Some names to look for: locals, globals and nonsense. */
+	vector<string> names = { "main", "argc", "argv", "in", "no such name, surely" };
+	auto vg_seq = slow.visible_named_grandchildren();
+	for (auto i_g = std::move(vg_seq.first); i_g != vg_seq.second && names.size() < 100; ++i_g)
+	{
+		names.push_back(*i_g.name_here());
+	}
+	/* Some scopes to look from: every subprogram. */
+	vector<Dwarf_Off> scopes;
+	for (iterator_df<> i = slow.begin(); i != slow.end() && scopes.size() < 50; ++i)
+	{
+		if (i.is_a<subprogram_die>()) scopes.push_back(i.offset_here());
+	}
+	assert(scopes.size() > 0);
+
+	unsigned nfound = 0, nqueries = 0;
+	for (auto i_s = scopes.begin(); i_s != scopes.end(); ++i_s)
+	{
+		iterator_base slow_start = slow.pos(*i_s);
+		iterator_base fast_start = fast.pos(*i_s);
+		vector<iterator_base> each = fast.scoped_resolve_each(fast_start, names);
+		assert(each.size() == names.size());
+		for (unsigned i_n = 0; i_n < names.size(); ++i_n)
+		{
+			iterator_base expected = slow.scoped_resolve(slow_start, names[i_n]);
+			/* The memo gives the same answer, the first time and after.
+			 * If it had to go to the root, where there may be several
+			 * definitions, which one we get depends on what's cached. */
+			iterator_base first_got;
+			for (unsigned pass = 0; pass < 2; ++pass)
+			{
+				iterator_base got = fast.scoped_resolve(fast_start, names[i_n]);
+				assert(!!got == !!expected);
+				if (!got) continue;
+				if (expected.depth() != 2) assert(got.offset_here() == expected.offset_here());
+				if (pass == 0) first_got = got;
+				else assert(got.offset_here() == first_got.offset_here());
+			}
+			/* Likewise the batch. */
+			assert(!!each[i_n] == !!expected);
+			if (expected)
+			{
+				assert(*each[i_n].name_here() == names[i_n]);
+				if (expected.depth() != 2) assert(each[i_n].offset_here() == expected.offset_here());
+				++nfound;
+			}
+			++nqueries;
+		}
+	}
+	assert(nfound > 0);
+	assert(fast.get_cache_footprint().cache_entries > 0);
+
+	/* A name that wasn't there, until we make it. */
+	auto cu = fast.get_or_create_synthetic_cu();
+	assert(!fast.scoped_resolve(cu, "made_in_memory"));
+	iterator_base v = fast.make_new(cu, DW_TAG_variable);
+	dynamic_cast<core::in_memory_abstract_die&>(v.dereference()).attrs().insert(
+		make_pair(DW_AT_name, encap::attribute_value(string("made_in_memory"))));
+	assert(fast.scoped_resolve(cu, "made_in_memory").offset_here() == v.offset_here());
+
+	cout << "Scoped resolution agreed on " << nqueries << " queries (" << nfound
+		<< " found)." << endl;
+	return 0;
+}
@@ -0,0 +1,98 @@
+#undef NDEBUG // assert is part of our logic
+#include <fstream>
+#include <algorithm>
+#include <functional>
+#include <fileno.hpp>
+#include <dwarfpp/lib.hpp>
+
+using std::cout;
+using std::endl;
+using std::vector;
+using namespace dwarf;
+using namespace dwarf::lib;
+using core::iterator_base;
+using core::root_die;
+using core::sorted_name_table;
+
+static vector<Dwarf_Off> offsets_of(const vector<iterator_base>& found)
+{
+	vector<Dwarf_Off> offs;
+	for (auto i = found.begin(); i != found.end(); ++i) offs.push_back(i->offset_here());
+	return offs;
+}
+
+int sorted_names_test_one = 1;
+int sorted_names_test_two = 2;
+
+int main(int argc, char **argv)
+{
+	/* The matcher itself. */
+	assert(sorted_name_table::glob_match("*_impl", "foo_impl"));
+	assert(!sorted_name_table::glob_match("*_impl", "foo_impl2"));
+	assert(sorted_name_table::glob_match("foo_*", "foo_"));
+	assert(sorted_name_table::glob_match("f?o*b*r", "fooxbar"));
+	assert(!sorted_name_table::glob_match("f?o", "fo"));
+	assert(sorted_name_table::glob_match("a\\*b", "a*b"));
+	assert(!sorted_name_table::glob_match("a\\*b", "axb"));
+	assert(sorted_name_table::glob_match("*", ""));
+	assert(sorted_name_table::glob_literal_prefix("foo_*bar") == "foo_");
+	assert(sorted_name_table::glob_literal_prefix("a\\*b?") == "a*b");
+
+	cout << "Opening " << argv[0] << "..." << endl;
+	std::ifstream in(argv[0]);
+	assert(in);
+	root_die root(fileno(in));
+
+	/* Every visible grandchild, the slow way, by offset. */
+	vector<std::pair<Dwarf_Off, std::string> > all;
+	auto vg_seq = root.visible_named_grandchildren();
+	for (auto i_g = std::move(vg_seq.first); i_g != vg_seq.second; ++i_g)
+	{
+		all.push_back(std::make_pair(i_g.offset_here(), *i_g.name_here()));
+	}
+	std::sort(all.begin(), all.end());
+	all.erase(std::unique(all.begin(), all.end()), all.end());
+	assert(all.size() > 0);
+	auto slow = [&all](std::function<bool(const std::string&)> pred) {
+		vector<Dwarf_Off> offs;
+		for (auto i_a = all.begin(); i_a != all.end(); ++i_a) if (pred(i_a->second)) offs.push_back(i_a->first);
+		return offs;
+	};
+
+	root.build_sorted_name_table(0);
+	const sorted_name_table *table = root.get_sorted_name_table();
+	assert(table);
+	assert(std::is_sorted(table->sorted_names().begin(), table->sorted_names().end()));
+	assert(table->die_count() == all.size());
+	assert(root.get_cache_footprint().index_bytes >= table->footprint());
+
+	const char *prefixes[] = { "", "m", "main", "sorted_names_test_", "_", "no such prefix" };
+	for (const char *prefix : prefixes)
+	{
+		std::string p = prefix;
+		assert(offsets_of(root.find_visible_grandchildren_with_prefix(p))
+			== slow([&p](const std::string& n) { return n.compare(0, p.size(), p) == 0; }));
+	}
+	const char *patterns[] = { "*", "m*", "*_t", "sorted_names_test_*", "*test_t?o", "?ain", "*no such*" };
+	for (const char *pattern : patterns)
+	{
+		std::string p = pattern;
+		assert(offsets_of(root.find_visible_grandchildren_matching(p))
+			== slow([&p](const std::string& n) { return sorted_name_table::glob_match(p, n); }));
+	}
+	assert(root.find_visible_grandchildren_with_prefix("sorted_names_test_").size() == 2);
+	assert(root.find_visible_grandchildren_matching("*test_t?o").size() == 1);
+
+	/* Naming an in-memory DIE puts it in the cache, so it's found (last). */
+	auto cu = root.get_or_create_synthetic_cu();
+	iterator_base v = root.make_new(cu, DW_TAG_variable);
+	dynamic_cast<core::in_memory_abstract_die&>(v.dereference()).attrs().insert(
+		make_pair(DW_AT_name, encap::attribute_value(std::string("sorted_names_test_made"))));
+	auto found = root.find_visible_grandchildren_with_prefix("sorted_names_test_");
+	assert(found.size() == 3 && found.back().offset_here() == v.offset_here());
+	assert(root.find_visible_grandchildren_matching("*_made").size() == 1);
+
+	cout << "Sorted name table agreed on " << all.size() << " DIEs with "
+		<< table->size() << " distinct names." << endl;
+	return sorted_names_test_one + sorted_names_test_two == 3 ? 0 : 1;
+}
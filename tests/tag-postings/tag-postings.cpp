@@ -0,0 +1,76 @@
+#undef NDEBUG // assert is part of our logic
+#include <fstream>
+#include <fileno.hpp>
+#include <dwarfpp/lib.hpp>
+
+using std::cout;
+using std::endl;
+using namespace dwarf;
+using namespace dwarf::lib;
+using core::iterator_df;
+using core::compile_unit_die;
+using core::subprogram_die;
+using core::variable_die;
+using core::type_die;
+
+int main(int argc, char **argv)
+{
+	cout << "Opening " << argv[0] << "..." << endl;
+	std::ifstream in(argv[0]);
+	assert(in);
+	core::root_die root(fileno(in));
+
+	/* The filtering way... */
+	std::vector<Dwarf_Off> variables, types, subprogram_children;
+	unsigned ndies = 0;
+	for (iterator_df<> i = root.begin(); i != root.end(); ++i)
+	{
+		if (i.is_root_position()) continue;
+		++ndies;
+		if (i.is_a<variable_die>()) variables.push_back(i.offset_here());
+		if (i.is_a<type_die>()) types.push_back(i.offset_here());
+		if (i.tag_here() == DW_TAG_compile_unit)
+		{
+			auto subps = i.children().subseq_of<subprogram_die>();
+			for (auto i_s = subps.first; i_s != subps.second; ++i_s)
+			{
+				subprogram_children.push_back(i_s.base().base().offset_here());
+			}
+		}
+	}
+
+	/* ... should agree with the posting lists. */
+	auto check_all = [&root](std::vector<Dwarf_Off>& expected, auto seq) {
+		unsigned n = 0;
+		for (auto i = seq.first; i != seq.second; ++i, ++n)
+		{
+			assert(n < expected.size());
+			assert(i.offset_here() == expected[n]);
+		}
+		assert(n == expected.size());
+	};
+	check_all(variables, root.all_of<variable_die>());
+	check_all(types, root.all_of<type_die>());
+	std::vector<Dwarf_Off> from_postings;
+	auto cus = root.begin().children_subseq_of<compile_unit_die>();
+	for (auto i_cu = cus.first; i_cu != cus.second; ++i_cu)
+	{
+		assert(i_cu.depth() == 1);
+		auto subps = i_cu.children_subseq_of<subprogram_die>();
+		for (auto i_s = subps.first; i_s != subps.second; ++i_s)
+		{
+			assert(i_s.parent() == i_cu.base());
+			from_postings.push_back(i_s.offset_here());
+		}
+	}
+	assert(from_postings == subprogram_children);
+	unsigned nall = 0;
+	auto all = root.all_of<core::basic_die>();
+	for (auto i = all.first; i != all.second; ++i) ++nall;
+	assert(nall == ndies);
+
+	cout << "Posting lists agreed on " << variables.size() << " variables, "
+		<< types.size() << " types and " << subprogram_children.size()
+		<< " top-level subprograms." << endl;
+	return 0;
+}
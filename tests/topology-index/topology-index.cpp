@@ -0,0 +1,78 @@
+#undef NDEBUG // assert is part of our logic
+#include <fstream>
+#include <fileno.hpp>
+#include <dwarfpp/lib.hpp>
+#include <dwarfpp/topology.hpp>
+#include <tuple>
+
+using std::cout;
+using std::endl;
+using namespace dwarf;
+using namespace dwarf::lib;
+using core::iterator_df;
+using core::topology_index;
+
+int main(int argc, char **argv)
+{
+	cout << "Opening " << argv[0] << "..." << endl;
+	std::ifstream in(argv[0]);
+	assert(in);
+	core::root_die root(fileno(in));
+
+	/* Record what the hash-table caches give us... */
+	vector<std::tuple<Dwarf_Off, Dwarf_Half, unsigned> > seen;
+	for (iterator_df<> i = root.begin(); i != root.end(); ++i)
+	{
+		if (i.is_root_position()) continue;
+		seen.push_back(std::make_tuple(i.offset_here(), i.tag_here(), i.depth()));
+	}
+
+	/* ... then build the index and check it agrees. */
+	root.build_topology_index();
+	const topology_index *p_idx = root.get_topology_index();
+	assert(p_idx);
+	assert(p_idx->size() == seen.size());
+	for (topology_index::ordinal o = 0; o < p_idx->size(); ++o)
+	{
+		assert(p_idx->offset(o) == std::get<0>(seen[o]));
+		assert(p_idx->tag(o) == std::get<1>(seen[o]));
+		assert(p_idx->depth(o) == std::get<2>(seen[o]));
+		assert(p_idx->ordinal_of(p_idx->offset(o)) == o);
+		// subtree sizes agree with depths
+		auto next = p_idx->skip_subtree(o);
+		for (auto c = o + 1; c != (next == topology_index::NONE ? p_idx->size() : next); ++c)
+		{
+			assert(p_idx->depth(c) > p_idx->depth(o));
+		}
+		assert(next == topology_index::NONE || p_idx->depth(next) <= p_idx->depth(o));
+	}
+
+	/* Navigating now goes via the index; we should see the same tree. */
+	unsigned count = 0;
+	for (iterator_df<> i = root.begin(); i != root.end(); ++i)
+	{
+		if (i.is_root_position()) continue;
+		assert(i.offset_here() == std::get<0>(seen[count]));
+		assert(i.depth() == std::get<2>(seen[count]));
+		auto o = p_idx->ordinal_of(i.offset_here());
+		assert(i.parent().offset_here() == p_idx->parent_offset(o));
+		// find() should know the depth without walking
+		assert(root.find(i.offset_here()).depth() == i.depth());
+		++count;
+	}
+	assert(count == seen.size());
+
+	/* Skipping subtrees visits exactly the CUs. */
+	unsigned ncus = 0;
+	iterator_df<> i = root.begin(); ++i;
+	for (; i != root.end(); i.increment_skipping_subtree())
+	{
+		assert(i.depth() == 1);
+		++ncus;
+	}
+	assert(ncus > 0);
+	cout << "Topology index agreed on " << count << " DIEs in " << ncus << " CUs ("
+		<< p_idx->footprint() << " bytes)." << endl;
+
+	return 0;
+}